@@ -0,0 +1,765 @@
+/**
+ * @file bench.c
+ * @brief 喝水提醒终端应用 - 性能基准测试
+ * @author zcg
+ * @date 2024
+ * @description 为数据和统计路径生成 1千到1千万条的合成历史记录，
+ *              测量加载、保存、添加记录、各持久性级别的日志写入、今日统计、周/月/连续天数统计、
+ *              列式区间聚合、基于汇总层的按月/按小时区间查询、整屏渲染（含三年热力图）
+ *              以及从启动到显示首页的耗时；
+ *              另外在10万个提醒上测量调度器的调度、取消和触发，并检查它们在实际时钟下按秒准时发出；
+ *              结果以制表符分隔输出，可与保存的基线对比并标记性能回退
+ */
+
+#include "water_reminder.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/timerfd.h>
+
+#define BENCH_MAX_SIZES 16             // 最多测试的数据规模个数
+#define BENCH_MAX_BASELINE 256         // 基线文件最多条目数
+#define BENCH_MAX_ITERATIONS (1L << 24) // 单个测试的最大迭代次数
+#define BENCH_DEFAULT_MIN_TIME 200     // 单个测试的最短计时（毫秒）
+#define BENCH_DEFAULT_THRESHOLD 25.0   // 判定为回退的变慢比例（百分比）
+#define BENCH_RECORDS_PER_DAY 8        // 合成数据每天的最少记录数
+#define BENCH_MAX_DAYS (3 * 365)       // 合成数据最多覆盖的天数
+#define BENCH_SCHEDULES 100000         // 调度器测试中同时待触发的提醒数
+#define BENCH_SCHEDULE_SPREAD 3        // 实时触发测试中提醒分布的秒数
+
+/**
+ * @brief 一个基准测试项
+ */
+typedef struct {
+    const char *name;                  // 测试名（输出和基线中的标识）
+    void (*run)(AppState *app);        // 执行一次被测操作
+} BenchCase;
+
+/**
+ * @brief 基线中的一条结果
+ */
+typedef struct {
+    char name[32];
+    long records;
+    double ns_per_op;
+} BaselineEntry;
+
+static BaselineEntry g_baseline[BENCH_MAX_BASELINE];
+static int g_baseline_count = 0;
+static FILE *g_results = NULL;         // 结果输出（标准输出被重定向到 /dev/null）
+
+static ReminderScheduler g_scheduler;  // 调度器测试的调度器
+static ReminderTimer *g_timers = NULL; // 调度器测试的提醒
+static unsigned int g_random = 1;      // 调度器测试的伪随机数状态
+
+/**
+ * @brief 事件模块引用的信号处理函数，基准测试不安装信号处理
+ */
+void signal_handler(int sig) {
+    (void)sig;
+}
+
+/**
+ * @brief 获取单调时钟的当前纳秒数
+ */
+static double monotonic_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec * 1e9 + (double)now.tv_nsec;
+}
+
+/* ==================== 被测操作 ==================== */
+
+static void bench_load_records(AppState *app) {
+    load_records(app);
+}
+
+static void bench_save_records(AppState *app) {
+    save_records(app);
+}
+
+static void bench_today_stats(AppState *app) {
+    calculate_today_stats(app);
+}
+
+static void bench_weekly_average(AppState *app) {
+    volatile float average = calculate_daily_average(app, 7);
+    (void)average;
+}
+
+static void bench_monthly_average(AppState *app) {
+    volatile float average = calculate_daily_average(app, 30);
+    (void)average;
+}
+
+static void bench_streak_days(AppState *app) {
+    volatile int streak = get_streak_days(app);
+    (void)streak;
+}
+
+/**
+ * @brief 用列式历史聚合最近 days 天的记录
+ */
+static void bench_range(AppState *app, int days) {
+    time_t now = time(NULL);
+    RangeAggregate range;
+    range_aggregate(app, now - (time_t)days * 86400, now + 1, &range);
+    volatile long long sum = range.sum;
+    (void)sum;
+}
+
+static void bench_range_month(AppState *app) {
+    bench_range(app, 30);
+}
+
+static void bench_range_year(AppState *app) {
+    bench_range(app, 365);
+}
+
+/**
+ * @brief 逐条遍历记录结构体聚合最近一年（列式聚合的对照）
+ */
+static void bench_range_year_rows(AppState *app) {
+    uint32_t from = (uint32_t)(time(NULL) - 365 * 86400);
+    long long sum = 0;
+    for (int i = 0; i < app->records.count; i++) {
+        const WaterRecord *record = record_store_at(&app->records, i);
+        if (record->timestamp >= from) {
+            sum += record->amount;
+        }
+    }
+    volatile long long result = sum;
+    (void)result;
+}
+
+/**
+ * @brief 按月分桶查询最近一年（读汇总层的月层）
+ */
+static void bench_query_year_months(AppState *app) {
+    QueryBucket buckets[16];
+    RangeQuery query;
+    query.to = time(NULL) + 1;
+    query.from = query.to - 365 * 86400;
+    query.bucket = BUCKET_MONTH;
+    query.flags = 0;
+    volatile int count = range_query(app, &query, buckets, 16, NULL);
+    (void)count;
+}
+
+/**
+ * @brief 按小时分桶查询最近一周（读汇总层的小时层）
+ */
+static void bench_query_week_hours(AppState *app) {
+    QueryBucket buckets[7 * 24 + 8];
+    RangeQuery query;
+    query.to = time(NULL) + 1;
+    query.from = query.to - 7 * 86400;
+    query.bucket = BUCKET_HOUR;
+    query.flags = 0;
+    volatile int count = range_query(app, &query, buckets, 7 * 24 + 8, NULL);
+    (void)count;
+}
+
+static void bench_render_weekly(AppState *app) {
+    clear_screen();
+    show_weekly_stats(app);
+    render_present();
+}
+
+static void bench_render_monthly(AppState *app) {
+    clear_screen();
+    show_monthly_stats(app);
+    render_present();
+}
+
+static void bench_render_heatmap(AppState *app) {
+    clear_screen();
+    show_intake_heatmap(app, BENCH_MAX_DAYS + 1);
+    render_present();
+}
+
+static void bench_render_dashboard(AppState *app) {
+    clear_screen();
+    show_banner();
+    show_stats_dashboard(app);
+    show_main_menu();
+    render_present();
+}
+
+/**
+ * @brief 从加载配置和记录到显示首页，不计退出时的保存
+ * @param day_index_path 每日聚合快照路径，NULL表示使用上次退出时保存的快照
+ */
+static void bench_startup_with(const char *day_index_path) {
+    AppState app;
+    app_state_init(&app, NULL);
+    app.headless = 1;
+    if (day_index_path) {
+        snprintf(app.day_index_path, sizeof(app.day_index_path), "%s", day_index_path);
+    }
+    if (app_state_load(&app) == 0) {
+        bench_render_dashboard(&app);
+    }
+
+    record_store_free(&app.records);
+    day_index_free(&app.day_index);
+    record_columns_free(&app.columns);
+    rollup_free(&app.rollup);
+}
+
+static void bench_startup(AppState *app) {
+    (void)app;
+    bench_startup_with(NULL);
+}
+
+static void bench_startup_cold(AppState *app) {
+    (void)app;
+    bench_startup_with("data/missing.dat");
+}
+
+static void bench_add_record(AppState *app) {
+    add_water_record(app, 250);
+}
+
+/**
+ * @brief 以指定持久性级别向数据日志追加一条记录
+ */
+static void bench_journal_append(AppState *app, int durability) {
+    WaterRecord record;
+    record.timestamp = (uint32_t)time(NULL);
+    record.amount = 250;
+
+    int saved = app->config.durability;
+    app->config.durability = durability;
+    journal_append(app, &record, 1);
+    app->config.durability = saved;
+}
+
+static void bench_journal_none(AppState *app) {
+    bench_journal_append(app, DURABILITY_NONE);
+}
+
+static void bench_journal_batched(AppState *app) {
+    bench_journal_append(app, DURABILITY_BATCHED);
+}
+
+static void bench_journal_record(AppState *app) {
+    bench_journal_append(app, DURABILITY_RECORD);
+}
+
+/* ==================== 调度器测试项 ==================== */
+
+/**
+ * @brief 伪随机数（线性同余），保证每次运行的操作序列相同
+ */
+static unsigned int bench_random(void) {
+    g_random = g_random * 1103515245u + 12345u;
+    return g_random >> 8;
+}
+
+/**
+ * @brief 随机一个提醒的到期时间（一天之内）
+ */
+static time_t bench_random_due(void) {
+    return (time_t)1700000000 + (time_t)(bench_random() % 86400);
+}
+
+/**
+ * @brief 将一个随机提醒改到新的时间（用户修改提醒间隔）
+ */
+static void bench_scheduler_reschedule(AppState *app) {
+    (void)app;
+    ReminderTimer *timer = &g_timers[bench_random() % BENCH_SCHEDULES];
+    scheduler_schedule(&g_scheduler, timer, bench_random_due());
+}
+
+/**
+ * @brief 取消一个随机提醒再重新加入（用户暂停后恢复）
+ */
+static void bench_scheduler_cancel_insert(AppState *app) {
+    (void)app;
+    ReminderTimer *timer = &g_timers[bench_random() % BENCH_SCHEDULES];
+    scheduler_cancel(&g_scheduler, timer);
+    scheduler_schedule(&g_scheduler, timer, bench_random_due());
+}
+
+/**
+ * @brief 触发最早的提醒并按提醒间隔排下一次
+ */
+static void bench_scheduler_fire(AppState *app) {
+    (void)app;
+    ReminderTimer *timer = scheduler_pop_due(&g_scheduler, scheduler_peek(&g_scheduler)->due);
+    scheduler_schedule(&g_scheduler, timer, timer->due + DEFAULT_REMINDER_INTERVAL * 60);
+}
+
+/**
+ * @brief 调度器测试项列表，在 BENCH_SCHEDULES 个待触发的提醒上运行一次
+ */
+static const BenchCase g_scheduler_cases[] = {
+    { "scheduler_reschedule",    bench_scheduler_reschedule },
+    { "scheduler_cancel_insert", bench_scheduler_cancel_insert },
+    { "scheduler_fire",          bench_scheduler_fire },
+};
+
+/**
+ * @brief 测试项列表，修改数据的添加记录放在最后
+ */
+static const BenchCase g_cases[] = {
+    { "load_records",     bench_load_records },
+    { "save_records",     bench_save_records },
+    { "today_stats",      bench_today_stats },
+    { "weekly_average",   bench_weekly_average },
+    { "monthly_average",  bench_monthly_average },
+    { "streak_days",      bench_streak_days },
+    { "range_month",      bench_range_month },
+    { "range_year",       bench_range_year },
+    { "range_year_rows",  bench_range_year_rows },
+    { "query_year_months", bench_query_year_months },
+    { "query_week_hours", bench_query_week_hours },
+    { "render_weekly",    bench_render_weekly },
+    { "render_monthly",   bench_render_monthly },
+    { "render_heatmap",   bench_render_heatmap },
+    { "render_dashboard", bench_render_dashboard },
+    { "startup",          bench_startup },
+    { "startup_cold",     bench_startup_cold },
+    { "add_water_record", bench_add_record },
+    { "journal_none",     bench_journal_none },
+    { "journal_batched",  bench_journal_batched },
+    { "journal_record",   bench_journal_record },
+};
+
+/* ==================== 数据生成 ==================== */
+
+/**
+ * @brief 生成合成历史记录并写入数据文件
+ * @description 今天零点到现在之间放 BENCH_RECORDS_PER_DAY 条记录，其余记录按时间顺序
+ *              均匀分布在之前的若干天内；每条250~350ml，每天都能达到默认目标，
+ *              连续天数统计会走完最长的检查范围
+ */
+static int generate_records(const char *path, long count) {
+    long today_count = count < BENCH_RECORDS_PER_DAY ? count : BENCH_RECORDS_PER_DAY;
+    long past_count = count - today_count;
+    long days = past_count / BENCH_RECORDS_PER_DAY;
+    if (days < 1) days = 1;
+    if (days > BENCH_MAX_DAYS) days = BENCH_MAX_DAYS;
+
+    time_t now = time(NULL);
+    struct tm midnight_tm;
+    localtime_r(&now, &midnight_tm);
+    midnight_tm.tm_hour = midnight_tm.tm_min = midnight_tm.tm_sec = 0;
+    midnight_tm.tm_isdst = -1;
+    time_t midnight = mktime(&midnight_tm);
+
+    double past_start = (double)(midnight - (time_t)days * 86400);
+    double past_step = past_count > 0 ? (double)days * 86400 / (double)past_count : 0;
+    double today_step = (double)(now - midnight) / (double)(today_count + 1);
+
+    WaterRecord *batch = malloc(TRANSFER_BATCH_SIZE * sizeof(WaterRecord));
+    if (!batch) return -1;
+
+    // 上一个规模留下的汇总层和每日聚合快照与新数据不对应
+    remove(path);
+    remove(ROLLUP_FILE);
+    remove(DAY_INDEX_FILE);
+    uint32_t seed = 2463534242u;
+    int batch_count = 0;
+    int ret = 0;
+
+    for (long i = 0; i < count && ret == 0; i++) {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+
+        double timestamp = i < past_count ? past_start + past_step * (double)i
+                                          : (double)midnight + today_step * (double)(i - past_count + 1);
+        batch[batch_count].timestamp = (uint32_t)timestamp;
+        batch[batch_count].amount = 250 + 50 * (int32_t)(seed % 3);
+        if (++batch_count == TRANSFER_BATCH_SIZE || i == count - 1) {
+            ret = append_records(path, batch, batch_count);
+            batch_count = 0;
+        }
+    }
+
+    free(batch);
+    return ret;
+}
+
+/* ==================== 计时和基线 ==================== */
+
+/**
+ * @brief 重复执行被测操作直到累计时间达到下限
+ * @return 每次操作的平均纳秒数
+ */
+static double bench_measure(const BenchCase *bench, AppState *app, double min_time_ns,
+                            long *iterations) {
+    long n = 1;
+    double elapsed;
+
+    // 预热一次，使页面缓存和各类缓冲区处于稳定状态
+    bench->run(app);
+
+    for (;;) {
+        double start = monotonic_ns();
+        for (long i = 0; i < n; i++) {
+            bench->run(app);
+        }
+        elapsed = monotonic_ns() - start;
+        if (elapsed >= min_time_ns || n >= BENCH_MAX_ITERATIONS) break;
+
+        // 按本轮的速度估算达到下限所需的次数，每轮最多放大100倍
+        long next = elapsed > 0 ? (long)(min_time_ns * 1.2 / elapsed * (double)n) : n * 100;
+        if (next < n * 2) next = n * 2;
+        if (next > n * 100) next = n * 100;
+        if (next > BENCH_MAX_ITERATIONS) next = BENCH_MAX_ITERATIONS;
+        n = next;
+    }
+
+    *iterations = n;
+    return elapsed / (double)n;
+}
+
+/**
+ * @brief 读取基线文件
+ * @description 每行为 测试名\t记录数\t纳秒每次[\t其他列]，# 开头的行为注释
+ */
+static int load_baseline(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "无法读取基线文件 %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    char line[256];
+    while (fgets(line, sizeof(line), file) && g_baseline_count < BENCH_MAX_BASELINE) {
+        if (line[0] == '#' || line[0] == '\n') continue;
+
+        BaselineEntry *entry = &g_baseline[g_baseline_count];
+        if (sscanf(line, "%31s %ld %lf", entry->name, &entry->records, &entry->ns_per_op) == 3 &&
+            entry->ns_per_op > 0) {
+            g_baseline_count++;
+        }
+    }
+
+    fclose(file);
+    return 0;
+}
+
+/**
+ * @brief 查找基线中的对应结果
+ */
+static const BaselineEntry *find_baseline(const char *name, long records) {
+    for (int i = 0; i < g_baseline_count; i++) {
+        if (g_baseline[i].records == records && strcmp(g_baseline[i].name, name) == 0) {
+            return &g_baseline[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief 输出一项结果，有基线时对比并判定是否回退
+ * @return 判定为回退时返回1
+ */
+static int report_result(const char *name, long records, double ns_per_op, long iterations,
+                         int has_baseline, double threshold) {
+    const BaselineEntry *base = find_baseline(name, records);
+    if (!base) {
+        fprintf(g_results, "%s\t%ld\t%.1f\t%ld\t-\t-\t%s\n", name, records,
+                ns_per_op, iterations, has_baseline ? "new" : "-");
+        fflush(g_results);
+        return 0;
+    }
+
+    double change = (ns_per_op / base->ns_per_op - 1.0) * 100.0;
+    const char *status = change > threshold ? "REGRESSION" :
+                         change < -threshold ? "improved" : "ok";
+    fprintf(g_results, "%s\t%ld\t%.1f\t%ld\t%.1f\t%+.1f%%\t%s\n", name, records,
+            ns_per_op, iterations, base->ns_per_op, change, status);
+    fflush(g_results);
+    return change > threshold;
+}
+
+/**
+ * @brief 按真实时钟触发 BENCH_SCHEDULES 个提醒，检查每个提醒都在到期的那一秒内发出
+ * @description 提醒均匀分布在接下来的 BENCH_SCHEDULE_SPREAD 秒，事件循环与守护进程相同：
+ *              timerfd 设到堆顶的到期时间，唤醒后弹出所有已到期的提醒
+ * @return 有提醒提前或晚于一秒发出时返回1
+ */
+static int bench_scheduler_realtime(void) {
+    int timer_fd = timerfd_create(CLOCK_REALTIME, TFD_CLOEXEC);
+    if (timer_fd < 0) {
+        perror("创建timerfd失败");
+        return 1;
+    }
+
+    time_t start = time(NULL) + 1;
+    for (long i = 0; i < BENCH_SCHEDULES; i++) {
+        scheduler_schedule(&g_scheduler, &g_timers[i], start + (time_t)(i % BENCH_SCHEDULE_SPREAD));
+    }
+
+    long fired = 0, early = 0;
+    double max_lag = 0;
+    ReminderTimer *next;
+    while ((next = scheduler_peek(&g_scheduler)) != NULL) {
+        struct itimerspec spec;
+        memset(&spec, 0, sizeof(spec));
+        spec.it_value.tv_sec = next->due;
+        uint64_t expirations;
+        if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &spec, NULL) != 0 ||
+            read(timer_fd, &expirations, sizeof(expirations)) < 0) {
+            perror("等待提醒定时器失败");
+            break;
+        }
+
+        ReminderTimer *timer;
+        while ((timer = scheduler_pop_due(&g_scheduler, time(NULL))) != NULL) {
+            struct timespec now;
+            clock_gettime(CLOCK_REALTIME, &now);
+            double lag = (double)(now.tv_sec - timer->due) * 1e9 + (double)now.tv_nsec;
+            if (lag < 0) early++;
+            if (lag > max_lag) max_lag = lag;
+            fired++;
+        }
+    }
+    close(timer_fd);
+
+    int late = max_lag >= 1e9;
+    fprintf(g_results, "scheduler_max_lag\t%d\t%.1f\t%ld\t-\t-\t%s\n", BENCH_SCHEDULES,
+            max_lag, fired, early > 0 ? "EARLY" : late ? "LATE" : "ok");
+    fflush(g_results);
+    if (early > 0 || fired != BENCH_SCHEDULES) {
+        fprintf(stderr, "调度器实时测试: %ld 个提醒提前发出，共发出 %ld/%d 个\n",
+                early, fired, BENCH_SCHEDULES);
+    }
+    return early > 0 || late || fired != BENCH_SCHEDULES;
+}
+
+/**
+ * @brief 运行调度器测试
+ * @param failed 准时性检查失败或无法运行时置1（与机器快慢无关，不按性能回退处理）
+ * @return 性能回退的项数
+ */
+static int bench_scheduler(double min_time_ns, int has_baseline, double threshold, int *failed) {
+    g_timers = malloc(sizeof(ReminderTimer) * BENCH_SCHEDULES);
+    if (!g_timers) {
+        *failed = 1;
+        return 0;
+    }
+
+    fprintf(stderr, "调度 %d 个提醒...\n", BENCH_SCHEDULES);
+    scheduler_init(&g_scheduler);
+    for (long i = 0; i < BENCH_SCHEDULES; i++) {
+        reminder_timer_init(&g_timers[i], NULL);
+        scheduler_schedule(&g_scheduler, &g_timers[i], bench_random_due());
+    }
+
+    int regressions = 0;
+    for (size_t c = 0; c < sizeof(g_scheduler_cases) / sizeof(g_scheduler_cases[0]); c++) {
+        const BenchCase *bench = &g_scheduler_cases[c];
+        long iterations = 0;
+        double ns_per_op = bench_measure(bench, NULL, min_time_ns, &iterations);
+        regressions += report_result(bench->name, BENCH_SCHEDULES, ns_per_op, iterations,
+                                  has_baseline, threshold);
+    }
+
+    scheduler_free(&g_scheduler);
+    fprintf(stderr, "按实际时钟触发 %d 个提醒...\n", BENCH_SCHEDULES);
+    if (bench_scheduler_realtime() != 0) {
+        *failed = 1;
+    }
+
+    scheduler_free(&g_scheduler);
+    free(g_timers);
+    g_timers = NULL;
+    return regressions;
+}
+
+/**
+ * @brief 解析数据规模，支持 k/M 后缀
+ */
+static long parse_size(const char *text) {
+    char *end;
+    errno = 0;
+    long value = strtol(text, &end, 10);
+    if (end == text || errno != 0 || value <= 0) return -1;
+
+    if (*end == 'k' || *end == 'K') {
+        value *= 1000;
+        end++;
+    } else if (*end == 'm' || *end == 'M') {
+        value *= 1000000;
+        end++;
+    }
+    return *end == '\0' && value <= INT32_MAX / 2 ? value : -1;
+}
+
+/**
+ * @brief 解析逗号分隔的数据规模列表
+ */
+static int parse_sizes(char *list, long *sizes) {
+    int count = 0;
+    for (char *token = strtok(list, ","); token; token = strtok(NULL, ",")) {
+        long size = parse_size(token);
+        if (size < 0 || count >= BENCH_MAX_SIZES) return -1;
+        sizes[count++] = size;
+    }
+    return count;
+}
+
+/**
+ * @brief 删除基准测试产生的文件和目录
+ */
+static void remove_workspace(const char *dir) {
+    char path[APP_PATH_MAX + 8];
+    const char *files[] = { DATA_FILE, CONFIG_FILE, ROLLUP_FILE, DAY_INDEX_FILE, LOG_FILE, LOG_FILE ".1" };
+
+    for (size_t i = 0; i < sizeof(files) / sizeof(files[0]); i++) {
+        remove(files[i]);
+        snprintf(path, sizeof(path), "%s.tmp", files[i]);
+        remove(path);
+    }
+    rmdir("config");
+    rmdir("data");
+    rmdir("logs");
+
+    if (chdir("/") == 0) {
+        rmdir(dir);
+    }
+}
+
+/**
+ * @brief 显示命令行用法
+ */
+static void print_usage(const char *program) {
+    fprintf(stderr, "用法: %s [选项]\n", program);
+    fprintf(stderr, "\n");
+    fprintf(stderr, "  --sizes <列表>       数据规模，逗号分隔，支持 k/M 后缀（默认 1k,10k,100k,1M,10M）\n");
+    fprintf(stderr, "  --baseline <文件>    与基线对比，变慢超过阈值的项标记为 REGRESSION\n");
+    fprintf(stderr, "  --threshold <百分比> 回退阈值（默认 %.0f）\n", BENCH_DEFAULT_THRESHOLD);
+    fprintf(stderr, "  --min-time <毫秒>    每项测试的最短计时（默认 %d）\n", BENCH_DEFAULT_MIN_TIME);
+    fprintf(stderr, "  --dir <目录>         在该目录下创建临时工作目录（默认 /tmp，测量刷盘时应指向实际磁盘）\n");
+    fprintf(stderr, "  --kernel <名称>      区间聚合内核 avx2、sse2 或 scalar（默认按 CPU 自动选择）\n");
+    fprintf(stderr, "  -h, --help           显示此帮助信息\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "结果以制表符分隔输出到标准输出，进度输出到标准错误。\n");
+    fprintf(stderr, "退出状态: 0 正常，1 存在性能回退，2 参数错误、测试无法运行或提醒未按时发出。\n");
+}
+
+/**
+ * @brief 基准测试入口
+ * @return 存在性能回退时返回1，测试无法运行或提醒未按时发出时返回2
+ */
+int main(int argc, char *argv[]) {
+    long sizes[BENCH_MAX_SIZES] = { 1000, 10000, 100000, 1000000, 10000000 };
+    int size_count = 5;
+    const char *baseline_path = NULL;
+    double threshold = BENCH_DEFAULT_THRESHOLD;
+    double min_time_ms = BENCH_DEFAULT_MIN_TIME;
+    const char *parent_dir = "/tmp";
+
+    for (int i = 1; i < argc; i++) {
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+            print_usage(argv[0]);
+            return 0;
+        } else if (strcmp(argv[i], "--sizes") == 0 && value) {
+            size_count = parse_sizes(argv[++i], sizes);
+        } else if (strcmp(argv[i], "--baseline") == 0 && value) {
+            baseline_path = argv[++i];
+        } else if (strcmp(argv[i], "--threshold") == 0 && value) {
+            threshold = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--min-time") == 0 && value) {
+            min_time_ms = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--dir") == 0 && value) {
+            parent_dir = argv[++i];
+        } else if (strcmp(argv[i], "--kernel") == 0 && value) {
+            if (range_kernel_select(argv[++i]) != 0) {
+                fprintf(stderr, "不支持的区间聚合内核: %s\n", argv[i]);
+                return 2;
+            }
+        } else {
+            print_usage(argv[0]);
+            return 2;
+        }
+    }
+    if (size_count <= 0 || threshold <= 0 || min_time_ms <= 0) {
+        print_usage(argv[0]);
+        return 2;
+    }
+
+    // 基线路径相对于启动目录，切换工作目录之前读取
+    if (baseline_path && load_baseline(baseline_path) != 0) {
+        return 2;
+    }
+
+    // 结果写到原标准输出，渲染输出丢弃到 /dev/null
+    int results_fd = dup(STDOUT_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY);
+    if (results_fd < 0 || null_fd < 0 || dup2(null_fd, STDOUT_FILENO) < 0) {
+        perror("重定向标准输出失败");
+        return 2;
+    }
+    close(null_fd);
+    g_results = fdopen(results_fd, "w");
+    if (!g_results) return 2;
+
+    // 在临时目录中运行，不影响当前目录下的配置和数据
+    char workspace[APP_PATH_MAX * 2];
+    snprintf(workspace, sizeof(workspace), "%s/water_bench.XXXXXX", parent_dir);
+    if (!mkdtemp(workspace) || chdir(workspace) != 0 ||
+        create_directories() != 0 || logger_init() != 0) {
+        perror("创建基准测试目录失败");
+        return 2;
+    }
+
+    fprintf(stderr, "区间聚合内核: %s\n", range_kernel_name());
+    fprintf(g_results, "# benchmark\trecords\tns_per_op\titerations\tbaseline_ns\tchange\tstatus\n");
+    fflush(g_results);
+
+    int regressions = 0;
+    double min_time_ns = min_time_ms * 1e6;
+
+    for (int s = 0; s < size_count; s++) {
+        long records = sizes[s];
+        fprintf(stderr, "生成 %ld 条合成记录...\n", records);
+
+        AppState app;
+        app_state_init(&app, NULL);
+        app.headless = 1;
+        if (generate_records(app.data_path, records) != 0 || app_state_load(&app) != 0) {
+            fprintf(stderr, "生成测试数据失败\n");
+            app_state_free(&app);
+            regressions = -1;
+            break;
+        }
+
+        // 相当于上次正常退出时保存的快照，之后的加载和启动都从快照开始
+        rollup_save(&app.rollup, app.rollup_path, &app.records);
+        save_day_index(&app);
+
+        for (size_t c = 0; c < sizeof(g_cases) / sizeof(g_cases[0]); c++) {
+            const BenchCase *bench = &g_cases[c];
+            long iterations = 0;
+            double ns_per_op = bench_measure(bench, &app, min_time_ns, &iterations);
+            regressions += report_result(bench->name, records, ns_per_op, iterations,
+                                         baseline_path != NULL, threshold);
+        }
+
+        app_state_free(&app);
+    }
+
+    int failed = regressions < 0;
+    if (!failed) {
+        regressions += bench_scheduler(min_time_ns, baseline_path != NULL, threshold, &failed);
+    }
+
+    journal_shutdown();
+    logger_shutdown();
+    calendar_shutdown();
+    remove_workspace(workspace);
+
+    if (regressions > 0) {
+        fprintf(stderr, "发现 %d 项性能回退（变慢超过 %.0f%%）\n", regressions, threshold);
+    }
+    fclose(g_results);
+    return failed ? 2 : regressions > 0 ? 1 : 0;
+}
@@ -0,0 +1,143 @@
+/**
+ * @file animation.c
+ * @brief 喝水提醒终端应用 - 动画调度模块
+ * @author zcg
+ * @date 2024
+ * @description 基于时间片的非阻塞动画：启动动画时只记录帧序列和下一帧的到期时间，
+ *              由主线程事件循环在等待输入期间按时逐帧输出，
+ *              动画播放期间仍然可以响应按键、提醒和退出信号
+ */
+
+#include "water_reminder.h"
+#include <limits.h>
+
+/**
+ * @brief 一个正在播放的动画
+ */
+typedef struct {
+    int active;                    // 是否正在播放
+    const char *const *frames;     // 行动画的帧序列（NULL表示铃声动画）
+    int frame_count;               // 总帧数
+    int next_frame;                // 下一帧的下标
+    int interval_ms;               // 帧间隔（毫秒）
+    int row;                       // 行动画所在的屏幕行号
+    unsigned int generation;       // 启动时的整屏画面计数
+    long long next_tick;           // 下一帧的到期时间（单调时钟毫秒）
+} Animation;
+
+static Animation g_animations[ANIMATION_MAX];
+
+/**
+ * @brief 获取单调时钟的当前毫秒数
+ */
+static long long monotonic_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/**
+ * @brief 分配一个空闲的动画槽位
+ * @return 槽位已满时返回NULL
+ */
+static Animation *animation_alloc(void) {
+    for (int i = 0; i < ANIMATION_MAX; i++) {
+        if (!g_animations[i].active) {
+            memset(&g_animations[i], 0, sizeof(Animation));
+            return &g_animations[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief 在当前光标所在行播放逐帧替换的行动画
+ * @description 立即输出第一帧并换行，之后的帧原地重写该行；最后一帧为结束画面。
+ *              终端不支持原地重写（例如输出被重定向）时直接输出最后一帧
+ */
+void animation_play_line(const char *const *frames, int frame_count, int interval_ms) {
+    if (!frames || frame_count <= 0) return;
+
+    int row = render_cursor_row();
+    Animation *anim = frame_count > 1 && row > 0 ? animation_alloc() : NULL;
+    if (!anim) {
+        ui_printf("%s\n", frames[frame_count - 1]);
+        return;
+    }
+
+    ui_printf("%s\n", frames[0]);
+
+    anim->active = 1;
+    anim->frames = frames;
+    anim->frame_count = frame_count;
+    anim->next_frame = 1;
+    anim->interval_ms = interval_ms;
+    anim->row = row;
+    anim->generation = render_generation();
+    anim->next_tick = monotonic_ms() + interval_ms;
+}
+
+/**
+ * @brief 按固定间隔响若干次终端铃声
+ * @description 第一次铃声在事件循环下一次等待时响起，位于当前帧输出之后
+ */
+void animation_play_bell(int count, int interval_ms) {
+    if (count <= 0) return;
+
+    Animation *anim = animation_alloc();
+    if (!anim) return;
+
+    anim->active = 1;
+    anim->frame_count = count;
+    anim->interval_ms = interval_ms;
+    anim->next_tick = monotonic_ms();
+}
+
+/**
+ * @brief 计算距离下一帧到期的毫秒数，用作事件循环的等待超时
+ * @return 没有正在播放的动画时返回-1（无限等待）
+ */
+int animation_next_timeout(void) {
+    long long nearest = -1;
+    for (int i = 0; i < ANIMATION_MAX; i++) {
+        if (g_animations[i].active &&
+            (nearest < 0 || g_animations[i].next_tick < nearest)) {
+            nearest = g_animations[i].next_tick;
+        }
+    }
+    if (nearest < 0) return -1;
+
+    long long wait = nearest - monotonic_ms();
+    if (wait < 0) return 0;
+    return wait > INT_MAX ? INT_MAX : (int)wait;
+}
+
+/**
+ * @brief 输出所有已到期的动画帧
+ * @description 行动画所在的画面已被新画面替换或已滚出屏幕时，动画直接结束
+ */
+void animation_tick(void) {
+    long long now = monotonic_ms();
+
+    for (int i = 0; i < ANIMATION_MAX; i++) {
+        Animation *anim = &g_animations[i];
+        if (!anim->active || anim->next_tick > now) continue;
+
+        if (anim->frames) {
+            if (anim->generation != render_generation() ||
+                render_update_line(anim->row, anim->frames[anim->next_frame]) != 0) {
+                anim->active = 0;
+                continue;
+            }
+        } else {
+            render_bell();
+        }
+
+        anim->next_frame++;
+        if (anim->next_frame >= anim->frame_count) {
+            anim->active = 0;
+        } else {
+            anim->next_tick = now + anim->interval_ms;
+        }
+    }
+}
@@ -0,0 +1,296 @@
+/**
+ * @file audio.c
+ * @brief 喝水提醒终端应用 - 音效播放模块
+ * @author zcg
+ * @date 2024
+ * @description 常驻的后台音效线程：提示音只在首次使用时载入内存一次，
+ *              播放请求进入队列后立即返回，由后台线程通过常驻的 pacat 进程播放；
+ *              没有可用的声音后端时退化为终端铃声
+ */
+
+#include "water_reminder.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <spawn.h>
+#include <sys/wait.h>
+
+extern char **environ;
+
+/**
+ * @brief 音效模块状态
+ */
+static struct {
+    char *pcm;                     // 提示音PCM数据
+    size_t pcm_size;               // PCM数据字节数
+    int channels;                  // 声道数
+    int sample_rate;               // 采样率
+    int backend_failed;            // 声音后端不可用，使用终端铃声
+    pid_t player_pid;              // 常驻播放进程
+    int player_fd;                 // 播放进程的标准输入
+    int pending;                   // 队列中等待播放的请求数
+    int running;                   // 后台线程是否运行
+    int started;                   // 后台线程是否已启动
+    pthread_t thread;              // 后台播放线程
+    pthread_mutex_t lock;          // 保护队列和状态
+    pthread_cond_t wake;           // 唤醒后台线程
+} g_audio = {
+    .player_pid = -1,
+    .player_fd = -1,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER
+};
+
+/**
+ * @brief 读取小端序整数
+ */
+static uint32_t read_le(const unsigned char *p, int bytes) {
+    uint32_t value = 0;
+    for (int i = bytes - 1; i >= 0; i--) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+/**
+ * @brief 载入提示音WAV文件（仅支持16位PCM）
+ */
+static int load_sound_sample(void) {
+    FILE *file = fopen(SOUND_SAMPLE_FILE, "rb");
+    if (!file) return -1;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size < 44 || size > SOUND_SAMPLE_MAX) {
+        fclose(file);
+        return -1;
+    }
+
+    unsigned char *data = malloc((size_t)size);
+    if (!data || fread(data, 1, (size_t)size, file) != (size_t)size) {
+        free(data);
+        fclose(file);
+        return -1;
+    }
+    fclose(file);
+
+    if (memcmp(data, "RIFF", 4) != 0 || memcmp(data + 8, "WAVE", 4) != 0) {
+        free(data);
+        return -1;
+    }
+
+    // 遍历RIFF块，找到格式块和数据块
+    int format_ok = 0;
+    size_t pos = 12;
+    while (pos + 8 <= (size_t)size) {
+        uint32_t chunk_size = read_le(data + pos + 4, 4);
+        const unsigned char *body = data + pos + 8;
+        if (chunk_size > (size_t)size - pos - 8) {
+            chunk_size = (uint32_t)((size_t)size - pos - 8);
+        }
+
+        if (memcmp(data + pos, "fmt ", 4) == 0 && chunk_size >= 16) {
+            g_audio.channels = (int)read_le(body + 2, 2);
+            g_audio.sample_rate = (int)read_le(body + 4, 4);
+            format_ok = read_le(body, 2) == 1 && read_le(body + 14, 2) == 16;
+        } else if (memcmp(data + pos, "data", 4) == 0 && format_ok) {
+            g_audio.pcm = malloc(chunk_size);
+            if (!g_audio.pcm) break;
+            memcpy(g_audio.pcm, body, chunk_size);
+            g_audio.pcm_size = chunk_size;
+            break;
+        }
+
+        pos += 8 + chunk_size + (chunk_size & 1);
+    }
+
+    free(data);
+    return g_audio.pcm ? 0 : -1;
+}
+
+/**
+ * @brief 启动常驻播放进程（不经过shell）
+ */
+static int start_player(void) {
+    int fds[2];
+    if (pipe(fds) != 0) return -1;
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+
+    char rate_arg[32], channels_arg[32];
+    snprintf(rate_arg, sizeof(rate_arg), "--rate=%d", g_audio.sample_rate);
+    snprintf(channels_arg, sizeof(channels_arg), "--channels=%d", g_audio.channels);
+    char *argv[] = { "pacat", "--playback", "--raw", "--format=s16le",
+                     rate_arg, channels_arg, NULL };
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, fds[0], STDIN_FILENO);
+    posix_spawn_file_actions_addclose(&actions, fds[0]);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+    posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+
+    // 子进程恢复默认的信号屏蔽字
+    posix_spawnattr_t attr;
+    sigset_t empty;
+    sigemptyset(&empty);
+    posix_spawnattr_init(&attr);
+    posix_spawnattr_setsigmask(&attr, &empty);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK);
+
+    int ret = posix_spawnp(&g_audio.player_pid, "pacat", &actions, &attr, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+    close(fds[0]);
+
+    if (ret != 0) {
+        close(fds[1]);
+        g_audio.player_pid = -1;
+        return -1;
+    }
+
+    g_audio.player_fd = fds[1];
+    return 0;
+}
+
+/**
+ * @brief 结束播放进程
+ */
+static void stop_player(void) {
+    if (g_audio.player_fd >= 0) {
+        close(g_audio.player_fd);
+        g_audio.player_fd = -1;
+    }
+    if (g_audio.player_pid > 0) {
+        waitpid(g_audio.player_pid, NULL, 0);
+        g_audio.player_pid = -1;
+    }
+}
+
+/**
+ * @brief 播放一次提示音
+ * @return 声音后端不可用时返回-1
+ */
+static int play_sample(void) {
+    if (g_audio.player_fd < 0 && start_player() != 0) {
+        return -1;
+    }
+
+    const char *data = g_audio.pcm;
+    size_t remaining = g_audio.pcm_size;
+    while (remaining > 0) {
+        ssize_t n = write(g_audio.player_fd, data, remaining);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            // 播放进程已退出（EPIPE），视为后端不可用
+            stop_player();
+            return -1;
+        }
+        data += n;
+        remaining -= (size_t)n;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief 后台播放线程
+ */
+static void *audio_thread_main(void *arg) {
+    (void)arg;
+
+    if (load_sound_sample() != 0) {
+        g_audio.backend_failed = 1;
+    }
+
+    pthread_mutex_lock(&g_audio.lock);
+    while (g_audio.running) {
+        if (g_audio.pending == 0) {
+            pthread_cond_wait(&g_audio.wake, &g_audio.lock);
+            continue;
+        }
+
+        g_audio.pending--;
+        pthread_mutex_unlock(&g_audio.lock);
+
+        if (g_audio.backend_failed || play_sample() != 0) {
+            g_audio.backend_failed = 1;
+            if (write(STDOUT_FILENO, "\a", 1) < 0) {
+                // 终端不可写时静默忽略
+            }
+        }
+
+        pthread_mutex_lock(&g_audio.lock);
+    }
+    pthread_mutex_unlock(&g_audio.lock);
+
+    stop_player();
+    return NULL;
+}
+
+/**
+ * @brief 启动后台播放线程
+ */
+static int audio_start(void) {
+    g_audio.running = 1;
+
+    // 后台线程屏蔽所有信号；管道断开时 write 返回 EPIPE 而不会终止进程
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    int ret = pthread_create(&g_audio.thread, NULL, audio_thread_main, NULL);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    if (ret != 0) {
+        g_audio.running = 0;
+        return -1;
+    }
+
+    g_audio.started = 1;
+    return 0;
+}
+
+/**
+ * @brief 播放音效
+ * @description 只把请求放入队列，立即返回；后台线程在首次请求时启动
+ */
+void play_sound_effect(void) {
+    pthread_mutex_lock(&g_audio.lock);
+
+    if (!g_audio.started && audio_start() != 0) {
+        pthread_mutex_unlock(&g_audio.lock);
+        if (write(STDOUT_FILENO, "\a", 1) < 0) {
+            // 终端不可写时静默忽略
+        }
+        return;
+    }
+
+    // 短时间内的多次请求合并，队列满时丢弃
+    if (g_audio.pending < SOUND_QUEUE_MAX) {
+        g_audio.pending++;
+        pthread_cond_signal(&g_audio.wake);
+    }
+
+    pthread_mutex_unlock(&g_audio.lock);
+}
+
+/**
+ * @brief 停止后台播放线程并释放资源
+ */
+void audio_shutdown(void) {
+    pthread_mutex_lock(&g_audio.lock);
+    if (!g_audio.started) {
+        pthread_mutex_unlock(&g_audio.lock);
+        return;
+    }
+    g_audio.running = 0;
+    pthread_cond_signal(&g_audio.wake);
+    pthread_mutex_unlock(&g_audio.lock);
+
+    pthread_join(g_audio.thread, NULL);
+
+    free(g_audio.pcm);
+    g_audio.pcm = NULL;
+    g_audio.pcm_size = 0;
+    g_audio.started = 0;
+}
@@ -0,0 +1,208 @@
+/**
+ * @file calendar.c
+ * @brief 喝水提醒终端应用 - 日历缓存模块
+ * @author zcg
+ * @date 2024
+ * @description 时间戳与本地日期天号之间的换算：缓存一段连续日期的本地零点时间戳，
+ *              查询时按一天的秒数估算位置，再与相邻零点比较修正，夏令时切换日同样准确；
+ *              缓存表发布后不再修改，扩展时整体替换，查询无需加锁，任意线程都可调用
+ */
+
+#include "water_reminder.h"
+#include <pthread.h>
+
+/**
+ * @brief 本地零点缓存表（发布后只读）
+ */
+typedef struct CalendarTable {
+    int first_day;                 // 第一天的天号
+    int day_count;                 // 覆盖的天数
+    struct CalendarTable *retired; // 被替换下来的旧表（关闭时统一释放）
+    time_t starts[];               // starts[i] 为第 first_day+i 天的本地零点，共 day_count+1 项
+} CalendarTable;
+
+/**
+ * @brief 日历缓存状态
+ */
+static struct {
+    CalendarTable *table;          // 当前缓存表（原子读写）
+    pthread_mutex_t lock;          // 串行化缓存表的扩展
+} g_calendar = {
+    .lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+/* ==================== 日期换算函数 ==================== */
+
+/**
+ * @brief 公历日期转换为天号（1970-01-01 为第0天）
+ */
+static int days_from_civil(int year, int month, int day) {
+    year -= month <= 2;
+    int era = (year >= 0 ? year : year - 399) / 400;
+    int yoe = year - era * 400;
+    int doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+/**
+ * @brief 不经缓存计算时间戳所在的本地天号
+ */
+static int localtime_day(time_t timestamp) {
+    struct tm tm_info;
+    localtime_r(&timestamp, &tm_info);
+    return days_from_civil(tm_info.tm_year + 1900, tm_info.tm_mon + 1, tm_info.tm_mday);
+}
+
+/**
+ * @brief 不经缓存计算某一天的本地零点
+ * @description 由 mktime 按当天的时区规则换算；零点因夏令时不存在时得到当天最早的时刻
+ */
+static time_t mktime_day_start(int day) {
+    struct tm tm_info;
+    day_number_to_tm(day, &tm_info);
+    return mktime(&tm_info);
+}
+
+/**
+ * @brief 天号转换为日期结构（填充年月日和星期，用于格式化显示）
+ */
+void day_number_to_tm(int day, struct tm *out) {
+    if (!out) return;
+
+    int z = day + 719468;
+    int era = (z >= 0 ? z : z - 146096) / 146097;
+    int doe = z - era * 146097;
+    int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int mp = (5 * doy + 2) / 153;
+    int mday = doy - (153 * mp + 2) / 5 + 1;
+    int month = mp < 10 ? mp + 3 : mp - 9;
+    int year = yoe + era * 400 + (month <= 2);
+
+    memset(out, 0, sizeof(struct tm));
+    out->tm_year = year - 1900;
+    out->tm_mon = month - 1;
+    out->tm_mday = mday;
+    out->tm_wday = ((day % 7) + 11) % 7; // 1970-01-01 是星期四
+    out->tm_isdst = -1;
+}
+
+/* ==================== 缓存表函数 ==================== */
+
+/**
+ * @brief 在缓存表中查找时间戳所在的天
+ * @description 先按每天 86400 秒估算，夏令时只会让估算偏差一天，与相邻零点比较即可修正
+ * @return 超出缓存范围时返回-1
+ */
+static int table_find(const CalendarTable *table, time_t timestamp) {
+    if (timestamp < table->starts[0] || timestamp >= table->starts[table->day_count]) {
+        return -1;
+    }
+
+    long long offset = (long long)(timestamp - table->starts[0]) / 86400;
+    int i = offset < table->day_count ? (int)offset : table->day_count - 1;
+    while (timestamp < table->starts[i]) i--;
+    while (timestamp >= table->starts[i + 1]) i++;
+    return i;
+}
+
+/**
+ * @brief 扩展缓存表使其覆盖指定天号
+ * @description 每次至少向外扩展 CALENDAR_GROW_DAYS 天并复用已有的零点；
+ *              新表写完后才发布，正在使用旧表的线程不受影响
+ * @return 超出 CALENDAR_MAX_DAYS 或内存不足时返回NULL
+ */
+static const CalendarTable *calendar_cover(int day) {
+    pthread_mutex_lock(&g_calendar.lock);
+
+    CalendarTable *old = g_calendar.table;
+    if (old && day >= old->first_day && day < old->first_day + old->day_count) {
+        pthread_mutex_unlock(&g_calendar.lock);
+        return old;
+    }
+
+    int first = day - CALENDAR_GROW_DAYS;
+    int last = day + CALENDAR_GROW_DAYS;
+    if (old) {
+        if (old->first_day < first) first = old->first_day;
+        if (old->first_day + old->day_count - 1 > last) last = old->first_day + old->day_count - 1;
+    }
+
+    int count = last - first + 1;
+    CalendarTable *table = NULL;
+    if (count <= CALENDAR_MAX_DAYS) {
+        table = malloc(sizeof(CalendarTable) + (size_t)(count + 1) * sizeof(time_t));
+    }
+    if (!table) {
+        pthread_mutex_unlock(&g_calendar.lock);
+        return NULL;
+    }
+
+    table->first_day = first;
+    table->day_count = count;
+    table->retired = old;
+    for (int i = 0; i <= count; i++) {
+        int offset = first + i - (old ? old->first_day : 0);
+        table->starts[i] = old && offset >= 0 && offset <= old->day_count ?
+            old->starts[offset] : mktime_day_start(first + i);
+    }
+
+    __atomic_store_n(&g_calendar.table, table, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&g_calendar.lock);
+    return table;
+}
+
+/**
+ * @brief 释放日历缓存
+ * @description 只能在不再有其他线程查询时调用
+ */
+void calendar_shutdown(void) {
+    pthread_mutex_lock(&g_calendar.lock);
+    CalendarTable *table = g_calendar.table;
+    __atomic_store_n(&g_calendar.table, NULL, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&g_calendar.lock);
+
+    while (table) {
+        CalendarTable *retired = table->retired;
+        free(table);
+        table = retired;
+    }
+}
+
+/* ==================== 天号查询函数 ==================== */
+
+/**
+ * @brief 时间戳转换为本地日期的天号
+ */
+int timestamp_to_day(time_t timestamp) {
+    const CalendarTable *table = __atomic_load_n(&g_calendar.table, __ATOMIC_ACQUIRE);
+    int i = table ? table_find(table, timestamp) : -1;
+    if (i >= 0) {
+        return table->first_day + i;
+    }
+
+    // 未缓存的日期先按本地时间换算，再把这一天加入缓存
+    int day = localtime_day(timestamp);
+    calendar_cover(day);
+    return day;
+}
+
+/**
+ * @brief 获取今天的天号
+ */
+int today_day_number(void) {
+    return timestamp_to_day(time(NULL));
+}
+
+/**
+ * @brief 获取某一天本地零点的时间戳
+ */
+time_t day_start_time(int day) {
+    const CalendarTable *table = __atomic_load_n(&g_calendar.table, __ATOMIC_ACQUIRE);
+    if (!table || day < table->first_day || day > table->first_day + table->day_count) {
+        table = calendar_cover(day);
+        if (!table) return mktime_day_start(day);
+    }
+    return table->starts[day - table->first_day];
+}
@@ -0,0 +1,210 @@
+/**
+ * @file client.c
+ * @brief 喝水提醒终端应用 - 守护进程客户端
+ * @author zcg
+ * @date 2024
+ * @description 连接守护进程的轻量命令行客户端：带参数时发送一条请求并打印响应，
+ *              不带参数时把标准输入的每一行作为请求发送，适合脚本批量调用
+ */
+
+#include "water_reminder.h"
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/**
+ * @brief 显示命令行用法
+ */
+static void print_usage(const char *program) {
+    printf("用法: %s [-s 套接字] [-u 用户] [请求...]\n", program);
+    printf("\n");
+    printf("  -s <路径>    守护进程套接字（默认 %s）\n", DAEMON_SOCKET_FILE);
+    printf("  -u <用户>    操作指定用户的数据（默认用户不需要指定）\n");
+    printf("  -h, --help   显示此帮助信息\n");
+    printf("\n");
+    printf("请求示例: ADD 250 | TODAY | STATS | DAYS 7 | GET goal | SET goal 8 | PAUSE | RESUME\n");
+    printf("不带请求时从标准输入逐行读取请求。\n");
+}
+
+/**
+ * @brief 连接守护进程
+ */
+static int connect_daemon(const char *path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "套接字路径过长: %s\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        fprintf(stderr, "无法连接守护进程 %s: %s\n", path, strerror(errno));
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * @brief 完整写出数据
+ */
+static int send_all(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t n = send(fd, data, length, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += n;
+        length -= (size_t)n;
+    }
+    return 0;
+}
+
+/**
+ * @brief 读取一行响应
+ * @return 读到的字节数（不含结尾空字符），连接关闭时返回0
+ */
+static size_t read_response(int fd, char *response, size_t size) {
+    size_t received = 0;
+    while (received < size - 1) {
+        ssize_t n = read(fd, response + received, 1);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        received++;
+        if (response[received - 1] == '\n') break;
+    }
+    response[received] = '\0';
+    return received;
+}
+
+/**
+ * @brief 选择要操作的用户
+ * @return 守护进程接受时返回0
+ */
+static int select_user(int fd, const char *user) {
+    char request[DAEMON_LINE_MAX];
+    char response[DAEMON_LINE_MAX];
+
+    int length = snprintf(request, sizeof(request), "USER %s\n", user);
+    if (length < 0 || (size_t)length >= sizeof(request) ||
+        send_all(fd, request, (size_t)length) != 0 ||
+        read_response(fd, response, sizeof(response)) == 0) {
+        fprintf(stderr, "选择用户失败\n");
+        return -1;
+    }
+    if (strncmp(response, "OK", 2) != 0) {
+        fputs(response, stderr);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 发送一条请求并打印一行响应
+ * @return 响应为 OK 时返回0
+ */
+static int run_single(int fd, int argc, char *argv[]) {
+    char request[DAEMON_LINE_MAX];
+    size_t length = 0;
+
+    for (int i = 0; i < argc; i++) {
+        int n = snprintf(request + length, sizeof(request) - length, "%s%s",
+                         i > 0 ? " " : "", argv[i]);
+        if (n < 0 || (size_t)n >= sizeof(request) - length - 1) {
+            fprintf(stderr, "请求过长\n");
+            return 1;
+        }
+        length += (size_t)n;
+    }
+    request[length++] = '\n';
+
+    if (send_all(fd, request, length) != 0) {
+        perror("发送请求失败");
+        return 1;
+    }
+
+    char response[DAEMON_LINE_MAX * 16];
+    read_response(fd, response, sizeof(response));
+
+    fputs(response, stdout);
+    return strncmp(response, "OK", 2) == 0 ? 0 : 1;
+}
+
+/**
+ * @brief 把标准输入转发给守护进程并打印全部响应
+ * @description 请求与响应同时收发，避免双方缓冲区都写满时互相等待
+ */
+static int run_stream(int fd) {
+    char buffer[8192];
+    int input_open = 1;
+
+    for (;;) {
+        struct pollfd fds[2];
+        fds[0].fd = fd;
+        fds[0].events = POLLIN;
+        fds[1].fd = input_open ? STDIN_FILENO : -1;
+        fds[1].events = POLLIN;
+
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            return 1;
+        }
+
+        if (fds[1].revents & (POLLIN | POLLHUP | POLLERR)) {
+            ssize_t n = read(STDIN_FILENO, buffer, sizeof(buffer));
+            if (n > 0) {
+                if (send_all(fd, buffer, (size_t)n) != 0) return 1;
+            } else if (n == 0 || errno != EINTR) {
+                // 输入结束，通知守护进程发送完剩余响应后断开
+                input_open = 0;
+                shutdown(fd, SHUT_WR);
+            }
+        }
+
+        if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+            ssize_t n = read(fd, buffer, sizeof(buffer));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return 0;
+            if (fwrite(buffer, 1, (size_t)n, stdout) != (size_t)n) return 1;
+        }
+    }
+}
+
+/**
+ * @brief 客户端入口
+ */
+int main(int argc, char *argv[]) {
+    const char *path = DAEMON_SOCKET_FILE;
+    const char *user = NULL;
+    int first = 1;
+
+    if (argc > 1 && (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0)) {
+        print_usage(argv[0]);
+        return 0;
+    }
+    while (first + 1 < argc && argv[first][0] == '-') {
+        if (strcmp(argv[first], "-s") == 0) {
+            path = argv[first + 1];
+        } else if (strcmp(argv[first], "-u") == 0) {
+            user = argv[first + 1];
+        } else {
+            break;
+        }
+        first += 2;
+    }
+
+    int fd = connect_daemon(path);
+    if (fd < 0) return 2;
+    if (user && select_user(fd, user) != 0) {
+        close(fd);
+        return 1;
+    }
+
+    int ret = first < argc ? run_single(fd, argc - first, argv + first) : run_stream(fd);
+    close(fd);
+    return ret;
+}
@@ -0,0 +1,399 @@
+/**
+ * @file columns.c
+ * @brief 喝水提醒终端应用 - 列式历史模块
+ * @author zcg
+ * @date 2024
+ * @description 供长时间范围统计使用的列式历史：时间戳和喝水量分两列连续存放，
+ *              首次区间查询时从记录存储构建，之后只追加新记录。
+ *              区间的总量、次数和最值由向量化内核一次扫描得出，
+ *              运行时按 CPU 支持选择 AVX2、SSE2 或标量实现
+ */
+
+#include "water_reminder.h"
+#include <limits.h>
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define COLUMNS_X86 1
+#endif
+
+/**
+ * @brief 区间扫描的累加状态
+ */
+typedef struct {
+    long long sum;                 // 总量
+    long long count;               // 次数
+    int32_t min;                   // 最小值
+    int32_t max;                   // 最大值
+} RangeAccumulator;
+
+/**
+ * @brief 区间聚合内核：累加时间戳位于 [from, to) 的记录
+ */
+typedef void (*RangeKernel)(const uint32_t *timestamps, const int32_t *amounts, int n,
+                            uint32_t from, uint32_t to, RangeAccumulator *acc);
+
+/* ==================== 区间聚合内核 ==================== */
+
+/**
+ * @brief 标量内核（所有平台可用，也用于处理向量内核剩余的尾部）
+ */
+static void range_kernel_scalar(const uint32_t *timestamps, const int32_t *amounts, int n,
+                                uint32_t from, uint32_t to, RangeAccumulator *acc) {
+    for (int i = 0; i < n; i++) {
+        if (timestamps[i] < from || timestamps[i] >= to) continue;
+
+        int32_t amount = amounts[i];
+        acc->sum += amount;
+        acc->count++;
+        if (amount < acc->min) acc->min = amount;
+        if (amount > acc->max) acc->max = amount;
+    }
+}
+
+#ifdef COLUMNS_X86
+
+/**
+ * @brief SSE2 内核：每次处理4条记录
+ * @description SSE2 没有无符号比较和32位最值指令，时间戳翻转符号位后做有符号比较，
+ *              最值用比较结果做按位选择；总量按符号扩展为64位后累加，不会溢出
+ */
+__attribute__((target("sse2")))
+static void range_kernel_sse2(const uint32_t *timestamps, const int32_t *amounts, int n,
+                              uint32_t from, uint32_t to, RangeAccumulator *acc) {
+    const __m128i bias = _mm_set1_epi32(INT32_MIN);
+    const __m128i lo = _mm_set1_epi32((int32_t)(from ^ 0x80000000u));
+    const __m128i hi = _mm_set1_epi32((int32_t)(to ^ 0x80000000u));
+    const __m128i int_max = _mm_set1_epi32(INT32_MAX);
+    const __m128i int_min = _mm_set1_epi32(INT32_MIN);
+    __m128i sum = _mm_setzero_si128();
+    __m128i count = _mm_setzero_si128();
+    __m128i vmin = int_max;
+    __m128i vmax = int_min;
+
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i t = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(timestamps + i)), bias);
+        __m128i a = _mm_loadu_si128((const __m128i *)(amounts + i));
+        __m128i mask = _mm_andnot_si128(_mm_cmpgt_epi32(lo, t), _mm_cmpgt_epi32(hi, t));
+
+        count = _mm_sub_epi32(count, mask);
+
+        __m128i masked = _mm_and_si128(a, mask);
+        __m128i sign = _mm_srai_epi32(masked, 31);
+        sum = _mm_add_epi64(sum, _mm_unpacklo_epi32(masked, sign));
+        sum = _mm_add_epi64(sum, _mm_unpackhi_epi32(masked, sign));
+
+        __m128i low = _mm_or_si128(masked, _mm_andnot_si128(mask, int_max));
+        __m128i less = _mm_cmpgt_epi32(vmin, low);
+        vmin = _mm_or_si128(_mm_and_si128(less, low), _mm_andnot_si128(less, vmin));
+
+        __m128i high = _mm_or_si128(masked, _mm_andnot_si128(mask, int_min));
+        __m128i greater = _mm_cmpgt_epi32(high, vmax);
+        vmax = _mm_or_si128(_mm_and_si128(greater, high), _mm_andnot_si128(greater, vmax));
+    }
+
+    long long sums[2];
+    int32_t counts[4], mins[4], maxs[4];
+    _mm_storeu_si128((__m128i *)sums, sum);
+    _mm_storeu_si128((__m128i *)counts, count);
+    _mm_storeu_si128((__m128i *)mins, vmin);
+    _mm_storeu_si128((__m128i *)maxs, vmax);
+
+    acc->sum += sums[0] + sums[1];
+    for (int lane = 0; lane < 4; lane++) {
+        acc->count += counts[lane];
+        if (mins[lane] < acc->min) acc->min = mins[lane];
+        if (maxs[lane] > acc->max) acc->max = maxs[lane];
+    }
+
+    range_kernel_scalar(timestamps + i, amounts + i, n - i, from, to, acc);
+}
+
+/**
+ * @brief AVX2 内核：每次处理8条记录
+ */
+__attribute__((target("avx2")))
+static void range_kernel_avx2(const uint32_t *timestamps, const int32_t *amounts, int n,
+                              uint32_t from, uint32_t to, RangeAccumulator *acc) {
+    const __m256i bias = _mm256_set1_epi32(INT32_MIN);
+    const __m256i lo = _mm256_set1_epi32((int32_t)(from ^ 0x80000000u));
+    const __m256i hi = _mm256_set1_epi32((int32_t)(to ^ 0x80000000u));
+    const __m256i int_max = _mm256_set1_epi32(INT32_MAX);
+    const __m256i int_min = _mm256_set1_epi32(INT32_MIN);
+    __m256i sum = _mm256_setzero_si256();
+    __m256i count = _mm256_setzero_si256();
+    __m256i vmin = int_max;
+    __m256i vmax = int_min;
+
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i t = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(timestamps + i)), bias);
+        __m256i a = _mm256_loadu_si256((const __m256i *)(amounts + i));
+        __m256i mask = _mm256_andnot_si256(_mm256_cmpgt_epi32(lo, t), _mm256_cmpgt_epi32(hi, t));
+
+        count = _mm256_sub_epi32(count, mask);
+
+        __m256i masked = _mm256_and_si256(a, mask);
+        sum = _mm256_add_epi64(sum, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(masked)));
+        sum = _mm256_add_epi64(sum, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(masked, 1)));
+
+        vmin = _mm256_min_epi32(vmin, _mm256_blendv_epi8(int_max, a, mask));
+        vmax = _mm256_max_epi32(vmax, _mm256_blendv_epi8(int_min, a, mask));
+    }
+
+    long long sums[4];
+    int32_t counts[8], mins[8], maxs[8];
+    _mm256_storeu_si256((__m256i *)sums, sum);
+    _mm256_storeu_si256((__m256i *)counts, count);
+    _mm256_storeu_si256((__m256i *)mins, vmin);
+    _mm256_storeu_si256((__m256i *)maxs, vmax);
+
+    acc->sum += sums[0] + sums[1] + sums[2] + sums[3];
+    for (int lane = 0; lane < 8; lane++) {
+        acc->count += counts[lane];
+        if (mins[lane] < acc->min) acc->min = mins[lane];
+        if (maxs[lane] > acc->max) acc->max = maxs[lane];
+    }
+
+    range_kernel_scalar(timestamps + i, amounts + i, n - i, from, to, acc);
+}
+
+static int cpu_has_avx2(void) {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+static int cpu_has_sse2(void) {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+}
+
+#endif /* COLUMNS_X86 */
+
+static int cpu_has_baseline(void) {
+    return 1;
+}
+
+/**
+ * @brief 可用的内核，按优先顺序排列
+ */
+static const struct {
+    const char *name;
+    RangeKernel kernel;
+    int (*supported)(void);
+} g_kernels[] = {
+#ifdef COLUMNS_X86
+    { "avx2",   range_kernel_avx2,   cpu_has_avx2 },
+    { "sse2",   range_kernel_sse2,   cpu_has_sse2 },
+#endif
+    { "scalar", range_kernel_scalar, cpu_has_baseline }
+};
+
+#define KERNEL_COUNT ((int)(sizeof(g_kernels) / sizeof(g_kernels[0])))
+
+static int g_kernel = -1;
+static pthread_once_t g_kernel_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief 选择当前 CPU 支持的最快内核
+ */
+static void range_kernel_detect(void) {
+    for (int i = 0; i < KERNEL_COUNT; i++) {
+        if (g_kernels[i].supported()) {
+            g_kernel = i;
+            return;
+        }
+    }
+}
+
+/**
+ * @brief 获取当前使用的区间聚合内核名称
+ */
+const char *range_kernel_name(void) {
+    pthread_once(&g_kernel_once, range_kernel_detect);
+    return g_kernels[g_kernel].name;
+}
+
+/**
+ * @brief 指定区间聚合内核（基准测试对比用），NULL 表示自动选择
+ * @return 名称未知或 CPU 不支持时返回-1，当前内核不变
+ */
+int range_kernel_select(const char *name) {
+    pthread_once(&g_kernel_once, range_kernel_detect);
+    if (!name) {
+        range_kernel_detect();
+        return 0;
+    }
+
+    for (int i = 0; i < KERNEL_COUNT; i++) {
+        if (strcmp(g_kernels[i].name, name) == 0 && g_kernels[i].supported()) {
+            g_kernel = i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/* ==================== 列式历史函数 ==================== */
+
+/**
+ * @brief 初始化列式历史（不分配内存）
+ */
+void record_columns_init(RecordColumns *columns) {
+    if (!columns) return;
+
+    columns->timestamps = NULL;
+    columns->amounts = NULL;
+    columns->count = 0;
+    columns->capacity = 0;
+    columns->sorted = 1;
+}
+
+/**
+ * @brief 释放列式历史
+ */
+void record_columns_free(RecordColumns *columns) {
+    if (!columns) return;
+
+    free(columns->timestamps);
+    free(columns->amounts);
+    record_columns_init(columns);
+}
+
+/**
+ * @brief 清空列式历史但保留已分配的内存（记录存储被重新加载时调用）
+ */
+void record_columns_clear(RecordColumns *columns) {
+    if (!columns) return;
+
+    columns->count = 0;
+    columns->sorted = 1;
+}
+
+/**
+ * @brief 将记录存储中尚未同步的记录追加到列中
+ */
+int record_columns_sync(RecordColumns *columns, const RecordStore *store) {
+    if (!columns || !store) return -1;
+
+    if (columns->count > store->count) {
+        record_columns_clear(columns);
+    }
+
+    if (store->count > columns->capacity) {
+        int new_capacity = columns->capacity > 0 ? columns->capacity : RECORD_CHUNK_SIZE;
+        while (new_capacity < store->count) {
+            new_capacity = new_capacity > INT_MAX / 2 ? store->count : new_capacity * 2;
+        }
+
+        uint32_t *timestamps = realloc(columns->timestamps, (size_t)new_capacity * sizeof(uint32_t));
+        if (!timestamps) return -1;
+        columns->timestamps = timestamps;
+
+        int32_t *amounts = realloc(columns->amounts, (size_t)new_capacity * sizeof(int32_t));
+        if (!amounts) return -1;
+        columns->amounts = amounts;
+        columns->capacity = new_capacity;
+    }
+
+    uint32_t last = columns->count > 0 ? columns->timestamps[columns->count - 1] : 0;
+    for (int i = columns->count; i < store->count; i++) {
+        const WaterRecord *record = record_store_at(store, i);
+        columns->timestamps[i] = record->timestamp;
+        columns->amounts[i] = record->amount;
+        if (record->timestamp < last) {
+            columns->sorted = 0;
+        }
+        last = record->timestamp;
+    }
+    columns->count = store->count;
+    return 0;
+}
+
+/**
+ * @brief 查找第一个时间戳不小于 value 的位置（要求时间戳有序）
+ */
+static int lower_bound(const uint32_t *timestamps, int count, uint32_t value) {
+    int lo = 0, hi = count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (timestamps[mid] < value) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+/**
+ * @brief 聚合时间戳位于 [from, to) 的记录
+ * @description 时间戳有序时先二分查找区间的起止位置，只扫描区间内的记录；
+ *              存在倒序记录时扫描全部记录，由内核逐条判断是否在区间内
+ */
+void record_columns_aggregate(const RecordColumns *columns, time_t from, time_t to,
+                              RangeAggregate *out) {
+    if (!out) return;
+    memset(out, 0, sizeof(RangeAggregate));
+    if (!columns || columns->count == 0) return;
+
+    // 时间戳列为32位无符号数，区间截断到可表示的范围
+    if (from < 0) from = 0;
+    if (to > (time_t)UINT32_MAX) to = (time_t)UINT32_MAX;
+    if (from >= to) return;
+
+    int begin = 0, end = columns->count;
+    if (columns->sorted) {
+        begin = lower_bound(columns->timestamps, columns->count, (uint32_t)from);
+        end = lower_bound(columns->timestamps, columns->count, (uint32_t)to);
+    }
+
+    pthread_once(&g_kernel_once, range_kernel_detect);
+    RangeAccumulator acc = { 0, 0, INT32_MAX, INT32_MIN };
+    g_kernels[g_kernel].kernel(columns->timestamps + begin, columns->amounts + begin,
+                               end - begin, (uint32_t)from, (uint32_t)to, &acc);
+
+    out->sum = acc.sum;
+    out->count = (int)acc.count;
+    if (acc.count > 0) {
+        out->min = acc.min;
+        out->max = acc.max;
+    }
+}
+
+/**
+ * @brief 聚合用户在 [from, to) 时间段内的记录，列式历史按需构建和追加
+ * @description 超出保留期的记录已折叠进汇总层，折叠界限之前的部分由小时层聚合，
+ *              之后的部分仍由列式历史聚合
+ * @return 内存不足时返回-1；区间起止落在已折叠、有记录的小时中间时返回-2
+ */
+int range_aggregate(AppState *app, time_t from, time_t to, RangeAggregate *out) {
+    if (!app || !out) return -1;
+
+    memset(out, 0, sizeof(RangeAggregate));
+    if (record_columns_sync(&app->columns, &app->records) != 0) {
+        return -1;
+    }
+
+    time_t horizon = rollup_fold_horizon(&app->rollup, &app->records);
+    if (horizon > 0 && from < horizon) {
+        if (rollup_sync(&app->rollup, &app->records) != 0 ||
+            !rollup_ready(&app->rollup, &app->records)) {
+            return -1;
+        }
+        time_t split = to < horizon ? to : horizon;
+        if (rollup_aggregate(&app->rollup, from, split, out) != 0) {
+            return -2;
+        }
+        from = split;
+    }
+
+    RangeAggregate tail;
+    record_columns_aggregate(&app->columns, from, to, &tail);
+    if (tail.count > 0) {
+        if (out->count == 0 || tail.min < out->min) out->min = tail.min;
+        if (out->count == 0 || tail.max > out->max) out->max = tail.max;
+        out->sum += tail.sum;
+        out->count += tail.count;
+    }
+    return 0;
+}
@@ -7,9 +7,9 @@
  */
 
 #include "water_reminder.h"
-
-/* 全局变量声明（在main.c中定义） */
-extern AppState g_app;
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
 
 /* ==================== 初始化和清理函数 ==================== */
 
@@ -48,8 +48,10 @@ int create_directories(void) {
 
 /**
  * @brief 初始化应用状态
+ * @param user 用户名，NULL或空字符串表示默认用户
+ * @param headless 守护进程模式，缺少配置时直接使用默认配置而不进入设置向导
  */
-int init_app(AppState *app) {
+int init_app(AppState *app, const char *user, int headless) {
     if (!app) return -1;
     
     // 创建目录结构
@@ -57,44 +59,173 @@ int init_app(AppState *app) {
         return -1;
     }
     
+    // 启动日志模块，失败时日志退化为逐条直接写入
+    logger_init();
+    
+    // 启动性能指标文件的定期写出
+    metrics_init();
+    
     // 初始化应用状态
+    if (app_state_init(app, user) != 0) {
+        fprintf(stderr, "%s❌ 无效的用户名: %s%s\n", COLOR_RED, user, COLOR_RESET);
+        return -1;
+    }
+    app->headless = headless;
+    
+    // 加载配置和历史记录
+    if (app_state_load(app) != 0) {
+        return -1;
+    }
+    
+    log_message("应用初始化完成");
+    return 0;
+}
+
+/**
+ * @brief 清理应用资源
+ */
+void cleanup_app(AppState *app) {
+    if (!app) return;
+    
+    app_state_free(app);
+    
+    audio_shutdown();
+    
+    journal_shutdown();
+    
+    log_message("应用正常退出");
+    metrics_shutdown();
+    logger_shutdown();
+    calendar_shutdown();
+}
+
+/* ==================== 用户状态函数 ==================== */
+
+/**
+ * @brief 检查用户名是否合法（只允许字母、数字、下划线和连字符）
+ */
+int user_name_valid(const char *user) {
+    if (!user) return 0;
+    
+    size_t length = strlen(user);
+    if (length == 0 || length >= USER_NAME_MAX) return 0;
+    
+    for (size_t i = 0; i < length; i++) {
+        char c = user[i];
+        if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+              (c >= '0' && c <= '9') || c == '_' || c == '-')) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief 初始化一个用户的应用状态（不读取任何文件）
+ * @description 默认用户沿用 CONFIG_FILE 和 DATA_FILE，
+ *              其他用户的文件位于 USER_DATA_DIR/<用户名>/ 目录下
+ */
+int app_state_init(AppState *app, const char *user) {
+    if (!app) return -1;
+    
+    int is_default = !user || user[0] == '\0';
+    if (!is_default && !user_name_valid(user)) {
+        return -1;
+    }
+    
     memset(app, 0, sizeof(AppState));
+    record_store_init(&app->records);
+    day_index_init(&app->day_index);
+    record_columns_init(&app->columns);
+    rollup_init(&app->rollup);
+    journal_init(&app->journal);
     app->is_running = 1;
-    app->paused = 0;
-    app->record_count = 0;
-    app->today_count = 0;
-    app->today_amount = 0;
-    app->last_reminder = 0;
+    
+    if (is_default) {
+        snprintf(app->config_path, sizeof(app->config_path), "%s", CONFIG_FILE);
+        snprintf(app->data_path, sizeof(app->data_path), "%s", DATA_FILE);
+        snprintf(app->rollup_path, sizeof(app->rollup_path), "%s", ROLLUP_FILE);
+        snprintf(app->day_index_path, sizeof(app->day_index_path), "%s", DAY_INDEX_FILE);
+    } else {
+        snprintf(app->user, sizeof(app->user), "%s", user);
+        snprintf(app->config_path, sizeof(app->config_path), "%s/%s/user_config.dat",
+                 USER_DATA_DIR, user);
+        snprintf(app->data_path, sizeof(app->data_path), "%s/%s/water_records.dat",
+                 USER_DATA_DIR, user);
+        snprintf(app->rollup_path, sizeof(app->rollup_path), "%s/%s/rollup.dat",
+                 USER_DATA_DIR, user);
+        snprintf(app->day_index_path, sizeof(app->day_index_path), "%s/%s/day_index.dat",
+                 USER_DATA_DIR, user);
+    }
+    
+    return 0;
+}
+
+/**
+ * @brief 创建用户数据目录
+ */
+static int create_user_directory(const AppState *app) {
+    char path[APP_PATH_MAX];
+    
+    if (app->user[0] == '\0') return 0;
+    
+    if (mkdir(USER_DATA_DIR, 0700) != 0 && errno != EEXIST) {
+        perror("创建用户数据目录失败");
+        return -1;
+    }
+    
+    snprintf(path, sizeof(path), "%s/%s", USER_DATA_DIR, app->user);
+    if (mkdir(path, 0700) != 0 && errno != EEXIST) {
+        perror("创建用户数据目录失败");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 加载用户的配置和历史记录
+ * @description 缺少配置时交互模式进入设置向导，守护进程直接保存默认配置
+ */
+int app_state_load(AppState *app) {
+    if (!app || create_user_directory(app) != 0) return -1;
     
     // 加载或创建配置
-    if (load_config(&app->config) != 0) {
-        printf("%s⚠️  未找到配置文件，开始初始化设置...%s\n", 
-               COLOR_YELLOW, COLOR_RESET);
-        setup_user_config(&app->config);
-        save_config(&app->config);
+    if (load_config(&app->config, app->config_path) != 0) {
+        if (!app->headless) {
+            ui_printf("%s⚠️  未找到配置文件，开始初始化设置...%s\n", 
+                   COLOR_YELLOW, COLOR_RESET);
+            setup_user_config(&app->config);
+        }
+        save_config(&app->config, app->config_path);
     }
     
-    // 加载历史记录
-    load_records(app);
+    // 加载历史记录，超出保留期的旧记录折叠进汇总层
+    if (load_records(app) != 0) {
+        return -1;
+    }
+    fold_records(app);
     
     // 计算今日统计
     calculate_today_stats(app);
-    
-    log_message("应用初始化完成");
     return 0;
 }
 
 /**
- * @brief 清理应用资源
+ * @brief 保存并释放一个用户的应用状态
  */
-void cleanup_app(AppState *app) {
+void app_state_free(AppState *app) {
     if (!app) return;
     
-    // 保存配置和数据
-    save_config(&app->config);
-    save_records(app);
-    
-    log_message("应用正常退出");
+    // 保存配置，记录已实时追加到日志，这里只做压缩，汇总层和每日聚合保存后下次启动无需重建
+    save_config(&app->config, app->config_path);
+    compact_records(app);
+    journal_close(&app->journal);
+    rollup_save(&app->rollup, app->rollup_path, &app->records);
+    save_day_index(app);
+    record_store_free(&app->records);
+    day_index_free(&app->day_index);
+    record_columns_free(&app->columns);
+    rollup_free(&app->rollup);
 }
 
 /* ==================== 配置管理函数 ==================== */
@@ -111,6 +242,11 @@ void set_default_config(UserConfig *config) {
     config->cup_size = DEFAULT_CUP_SIZE;
     config->sound_enabled = 1;
     config->notification_style = 0;
+    config->animations_enabled = 1;
+    config->durability = DURABILITY_BATCHED;
+    config->commit_window_ms = JOURNAL_DEFAULT_WINDOW;
+    config->retention_days = 0;
+    config->last_reminder = 0;
 }
 
 /**
@@ -122,66 +258,96 @@ void setup_user_config(UserConfig *config) {
     clear_screen();
     show_banner();
     
-    printf("%s╭─────────────────────────────────────╮%s\n", COLOR_GREEN, COLOR_RESET);
-    printf("%s│             初始化设置              │%s\n", COLOR_GREEN, COLOR_RESET);
-    printf("%s╰─────────────────────────────────────╯%s\n", COLOR_GREEN, COLOR_RESET);
-    printf("\n");
+    ui_printf("%s╭─────────────────────────────────────╮%s\n", COLOR_GREEN, COLOR_RESET);
+    ui_printf("%s│             初始化设置              │%s\n", COLOR_GREEN, COLOR_RESET);
+    ui_printf("%s╰─────────────────────────────────────╯%s\n", COLOR_GREEN, COLOR_RESET);
+    ui_printf("\n");
     
     // 设置用户名
-    printf("%s请输入您的姓名: %s", COLOR_CYAN, COLOR_RESET);
-    fgets(config->name, MAX_NAME_LEN, stdin);
-    config->name[strcspn(config->name, "\n")] = 0; // 移除换行符
+    ui_printf("%s请输入您的姓名: %s", COLOR_CYAN, COLOR_RESET);
+    read_input_line(config->name, MAX_NAME_LEN);
     
     if (strlen(config->name) == 0) {
         strcpy(config->name, "用户");
     }
     
     // 设置提醒间隔
-    printf("%s请输入提醒间隔(分钟，默认60): %s", COLOR_CYAN, COLOR_RESET);
-    char input[10];
-    fgets(input, sizeof(input), stdin);
+    ui_printf("%s请输入提醒间隔(分钟，默认60): %s", COLOR_CYAN, COLOR_RESET);
+    char input[10] = "";
+    read_input_line(input, sizeof(input));
     int interval = atoi(input);
     config->reminder_interval = (interval > 0 && interval <= 300) ? interval : DEFAULT_REMINDER_INTERVAL;
     
     // 设置每日目标
-    printf("%s请输入每日喝水目标(杯，默认8): %s", COLOR_CYAN, COLOR_RESET);
-    fgets(input, sizeof(input), stdin);
+    ui_printf("%s请输入每日喝水目标(杯，默认8): %s", COLOR_CYAN, COLOR_RESET);
+    read_input_line(input, sizeof(input));
     int goal = atoi(input);
     config->daily_goal = (goal > 0 && goal <= 20) ? goal : DEFAULT_DAILY_GOAL;
     
     // 设置杯子容量
-    printf("%s请输入杯子容量(ml，默认250): %s", COLOR_CYAN, COLOR_RESET);
-    fgets(input, sizeof(input), stdin);
+    ui_printf("%s请输入杯子容量(ml，默认250): %s", COLOR_CYAN, COLOR_RESET);
+    read_input_line(input, sizeof(input));
     int size = atoi(input);
     config->cup_size = (size > 0 && size <= 1000) ? size : DEFAULT_CUP_SIZE;
     
     // 设置声音提醒
-    printf("%s是否启用声音提醒？(y/n，默认y): %s", COLOR_CYAN, COLOR_RESET);
-    fgets(input, sizeof(input), stdin);
+    ui_printf("%s是否启用声音提醒？(y/n，默认y): %s", COLOR_CYAN, COLOR_RESET);
+    read_input_line(input, sizeof(input));
     config->sound_enabled = (input[0] == 'n' || input[0] == 'N') ? 0 : 1;
     
     config->notification_style = 0;
     
-    printf("\n%s✅ 配置完成！%s\n", COLOR_GREEN, COLOR_RESET);
-    sleep(2);
+    ui_printf("\n%s✅ 配置完成！%s\n", COLOR_GREEN, COLOR_RESET);
+    ui_sleep(2);
 }
 
 /**
  * @brief 加载配置文件
  */
-int load_config(UserConfig *config) {
-    if (!config) return -1;
-    
-    FILE *file = fopen(CONFIG_FILE, "rb");
-    if (!file) {
+int load_config(UserConfig *config, const char *path) {
+    if (!config || !path) return -1;
+    
+    uint32_t loaded = 0;
+    int ret = snapshot_load(path, CONFIG_FILE_MAGIC, NULL, config, sizeof(UserConfig), &loaded);
+    size_t read_size = loaded;
+    
+    // 没有快照头的旧版本配置文件是结构体的直接转储
+    if (ret == SNAPSHOT_FOREIGN) {
+        FILE *file = fopen(path, "rb");
+        if (file) {
+            read_size = fread(config, 1, sizeof(UserConfig), file);
+            fclose(file);
+            ret = 0;
+        }
+    }
+    if (ret != 0) {
+        if (ret == SNAPSHOT_CORRUPT) {
+            log_message("配置文件校验失败，使用默认配置");
+        }
         set_default_config(config);
         return -1;
     }
     
-    size_t read_size = fread(config, sizeof(UserConfig), 1, file);
-    fclose(file);
-    
-    if (read_size != 1) {
+    // 旧版本的配置文件缺少后来增加的字段，缺少的字段使用默认值
+    UserConfig defaults;
+    set_default_config(&defaults);
+    if (read_size == offsetof(UserConfig, animations_enabled)) {
+        config->animations_enabled = defaults.animations_enabled;
+        read_size = offsetof(UserConfig, durability);
+    }
+    if (read_size == offsetof(UserConfig, durability)) {
+        config->durability = defaults.durability;
+        config->commit_window_ms = defaults.commit_window_ms;
+        read_size = offsetof(UserConfig, retention_days);
+    }
+    if (read_size == offsetof(UserConfig, retention_days)) {
+        config->retention_days = defaults.retention_days;
+        read_size = offsetof(UserConfig, retention_days) + sizeof(config->retention_days);
+    }
+    // last_reminder 按8字节对齐，前面可能有填充，旧文件的长度以 retention_days 的末尾为准
+    if (read_size == offsetof(UserConfig, retention_days) + sizeof(config->retention_days)) {
+        config->last_reminder = defaults.last_reminder;
+    } else if (read_size != sizeof(UserConfig)) {
         set_default_config(config);
         return -1;
     }
@@ -191,208 +357,560 @@ int load_config(UserConfig *config) {
 
 /**
  * @brief 保存配置文件
+ * @description 以带校验头的快照原子替换，写入过程中崩溃或收到信号不会留下不完整的文件；
+ *              内容与已保存的配置相同时不写入
  */
-int save_config(const UserConfig *config) {
-    if (!config) return -1;
+int save_config(const UserConfig *config, const char *path) {
+    if (!config || !path) return -1;
     
-    FILE *file = fopen(CONFIG_FILE, "wb");
-    if (!file) {
-        perror("保存配置文件失败");
-        return -1;
+    return snapshot_save(path, CONFIG_FILE_MAGIC, CONFIG_FILE_VERSION,
+                         config, sizeof(UserConfig));
+}
+
+/* ==================== 数据管理函数 ==================== */
+
+/**
+ * @brief 旧版本（无文件头）的喝水记录结构体，仅用于格式迁移
+ */
+typedef struct {
+    time_t timestamp;
+    int amount;
+    char date_str[11];
+} LegacyWaterRecord;
+
+/**
+ * @brief 16位字节序翻转
+ */
+static uint16_t swap16(uint16_t value) {
+    return (uint16_t)((value >> 8) | (value << 8));
+}
+
+/**
+ * @brief 32位字节序翻转
+ */
+static uint32_t swap32(uint32_t value) {
+    return (value >> 24) | ((value >> 8) & 0x0000FF00u) |
+           ((value << 8) & 0x00FF0000u) | (value << 24);
+}
+
+/**
+ * @brief 填充本机字节序的数据文件头
+ */
+void record_header_init(RecordFileHeader *header, uint32_t flags) {
+    memset(header, 0, sizeof(RecordFileHeader));
+    memcpy(header->magic, DATA_FILE_MAGIC, sizeof(header->magic));
+    header->version = DATA_FILE_VERSION;
+    header->record_size = sizeof(WaterRecord);
+    header->endian_tag = DATA_FILE_ENDIAN_TAG;
+    header->flags = flags;
+}
+
+/**
+ * @brief 写入数据文件头
+ */
+static int write_record_header(FILE *file, uint32_t flags) {
+    RecordFileHeader header;
+    
+    record_header_init(&header, flags);
+    return fwrite(&header, sizeof(header), 1, file) == 1 ? 0 : -1;
+}
+
+/**
+ * @brief 从旧格式数据文件迁移记录
+ * @description 旧文件是 LegacyWaterRecord 的直接转储，读入后以新格式重写，
+ *              原文件以硬链接保留为数据文件名加 ".v0" 的备份
+ */
+static int migrate_legacy_records(AppState *app, FILE *file) {
+    LegacyWaterRecord legacy;
+    int skipped = 0;
+    
+    fseek(file, 0, SEEK_SET);
+    while (fread(&legacy, sizeof(legacy), 1, file) == 1) {
+        if (legacy.timestamp < 0 || (unsigned long long)legacy.timestamp > UINT32_MAX ||
+            legacy.amount <= 0) {
+            skipped++;
+            continue;
+        }
+        
+        WaterRecord *record = record_store_append(&app->records);
+        if (!record) return -1;
+        record->timestamp = (uint32_t)legacy.timestamp;
+        record->amount = legacy.amount;
+        
+        if (app->records.count > 1 &&
+            record->timestamp < record_store_at(&app->records, app->records.count - 2)->timestamp) {
+            app->records.sorted = 0;
+        }
     }
     
-    size_t write_size = fwrite(config, sizeof(UserConfig), 1, file);
-    fclose(file);
+    char backup_path[APP_PATH_MAX + 8];
+    snprintf(backup_path, sizeof(backup_path), "%s.v0", app->data_path);
+    remove(backup_path);
+    if (link(app->data_path, backup_path) != 0) {
+        perror("备份旧数据文件失败");
+        return -1;
+    }
     
-    if (write_size != 1) {
+    if (save_records(app) != 0) {
         return -1;
     }
     
+    char log_msg[100];
+    snprintf(log_msg, sizeof(log_msg), "旧格式数据已迁移: %d条记录，跳过%d条无效记录",
+             app->records.count, skipped);
+    log_message(log_msg);
     return 0;
 }
 
-/* ==================== 数据管理函数 ==================== */
-
 /**
  * @brief 加载喝水记录
+ * @description 数据文件是带文件头的只追加记录日志，这里按顺序重放整个日志；
+ *              无文件头的旧格式和其他字节序写入的文件会自动转换
  */
-int load_records(AppState *app) {
+static int replay_record_log(AppState *app) {
     if (!app) return -1;
     
-    FILE *file = fopen(DATA_FILE, "rb");
+    // 重新加载后数据文件可能被替换，之后的追加重新打开
+    journal_close(&app->journal);
+    record_store_clear(&app->records);
+    day_index_clear(&app->day_index);
+    record_columns_clear(&app->columns);
+    app->log_count = 0;
+    
+    // 只读打开：日志不可写时也必须加载全部记录，否则退出时会用空记录覆盖它
+    FILE *file = fopen(app->data_path, "rb");
     if (!file) {
-        app->record_count = 0;
-        return 0; // 文件不存在是正常的
+        if (errno == ENOENT) {
+            return 0; // 文件不存在是正常的
+        }
+        perror("打开数据文件失败");
+        return -1;
+    }
+    
+    fseek(file, 0, SEEK_END);
+    long file_size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    
+    if (file_size == 0) {
+        fclose(file);
+        return 0;
     }
     
-    app->record_count = fread(app->records, sizeof(WaterRecord), MAX_RECORDS, file);
+    RecordFileHeader header;
+    if (file_size < (long)sizeof(header) ||
+        fread(&header, sizeof(header), 1, file) != 1 ||
+        memcmp(header.magic, DATA_FILE_MAGIC, sizeof(header.magic)) != 0) {
+        int ret = migrate_legacy_records(app, file);
+        fclose(file);
+        if (ret != 0) return -1;
+        app->log_count = app->records.count;
+        return day_index_build(&app->day_index, &app->records);
+    }
+    
+    int swapped = header.endian_tag != DATA_FILE_ENDIAN_TAG;
+    if (swapped) {
+        header.version = swap16(header.version);
+        header.record_size = swap16(header.record_size);
+        header.endian_tag = swap32(header.endian_tag);
+        header.flags = swap32(header.flags);
+    }
+    
+    if (header.endian_tag != DATA_FILE_ENDIAN_TAG ||
+        header.version != DATA_FILE_VERSION ||
+        header.record_size != sizeof(WaterRecord)) {
+        fprintf(stderr, "%s❌ 数据文件版本不受支持 (版本 %u)%s\n",
+                COLOR_RED, (unsigned)header.version, COLOR_RESET);
+        fclose(file);
+        return -1;
+    }
+    
+    long payload = file_size - (long)sizeof(header);
+    int total = (int)(payload / (long)sizeof(WaterRecord));
+    
+    // 上次追加时崩溃可能留下半条记录，截断到完整记录边界，
+    // 否则之后追加的记录会全部错位
+    if (payload % (long)sizeof(WaterRecord) != 0) {
+        int fd = open(app->data_path, O_WRONLY | O_CLOEXEC);
+        if (fd < 0 || ftruncate(fd, (off_t)sizeof(header) + (off_t)total * sizeof(WaterRecord)) != 0) {
+            perror("截断数据文件失败");
+        } else {
+            log_message("数据文件末尾存在不完整记录，已截断");
+        }
+        if (fd >= 0) close(fd);
+    }
+    
+    // 本机字节序的文件直接映射记录区，不复制也不预读任何记录
+    if (swapped || total == 0 ||
+        record_store_map(&app->records, fileno(file), sizeof(header), total) != 0) {
+        fseek(file, (long)sizeof(header), SEEK_SET);
+        record_store_read(&app->records, file, total);
+    }
+    app->log_count = app->records.count;
+    app->records.sorted = (header.flags & DATA_FLAG_UNSORTED) == 0;
     fclose(file);
     
-    return 0;
+    // 其他字节序的机器写入的文件，转换后以本机字节序重写
+    if (swapped) {
+        for (int i = 0; i < app->records.count; i++) {
+            WaterRecord *record = (WaterRecord *)record_store_at(&app->records, i);
+            record->timestamp = swap32(record->timestamp);
+            record->amount = (int32_t)swap32((uint32_t)record->amount);
+        }
+        if (save_records(app) == 0) {
+            log_message("数据文件字节序已转换");
+        }
+    }
+    
+    // 只索引最近一段时间的记录，更早的页面在需要时才会被访问；
+    // 上次保存的每日聚合快照有效时只需补上之后追加的记录
+    if (day_index_load(&app->day_index, app->day_index_path, &app->records) != 0) {
+        day_index_reset(&app->day_index, &app->records);
+    }
+    return day_index_ensure(&app->day_index, &app->records,
+                            today_day_number() - DAY_INDEX_WARM_DAYS);
 }
 
 /**
- * @brief 保存喝水记录
+ * @brief 使汇总层与重新加载的记录对应
+ * @description 首次加载时读取汇总层快照并补上之后追加的记录；
+ *              再次加载（例如导入之后）时内存中的汇总层只需补上新增的记录
  */
-int save_records(const AppState *app) {
+static int attach_rollup(AppState *app) {
+    if (!app->rollup.loaded) {
+        return rollup_load(&app->rollup, app->rollup_path, &app->records);
+    }
+    
+    if (app->rollup.covered > app->records.count) {
+        log_message("数据日志记录数少于汇总层，由记录重建汇总层");
+        rollup_clear(&app->rollup);
+    }
+    return rollup_sync(&app->rollup, &app->records);
+}
+
+/**
+ * @brief 保存启动时所需的最近一段时间的每日聚合
+ */
+int save_day_index(const AppState *app) {
     if (!app) return -1;
+    return day_index_save(&app->day_index, app->day_index_path, &app->records,
+                          today_day_number() - DAY_INDEX_WARM_DAYS);
+}
+
+/**
+ * @brief 加载喝水记录并记录耗时
+ */
+int load_records(AppState *app) {
+    METRIC_START(start);
+    int ret = replay_record_log(app);
+    if (ret == 0) {
+        ret = attach_rollup(app);
+    }
+    METRIC_END(METRIC_LOAD_RECORDS, start);
+    return ret;
+}
+
+/**
+ * @brief 写入完整的数据日志（文件头和全部记录）
+ */
+static int write_record_log(FILE *file, const void *ctx) {
+    const AppState *app = ctx;
     
-    FILE *file = fopen(DATA_FILE, "wb");
-    if (!file) {
-        perror("保存数据文件失败");
+    if (write_record_header(file, app->records.sorted ? 0 : DATA_FLAG_UNSORTED) != 0) {
         return -1;
     }
+    return record_store_write(&app->records, file) == app->records.count ? 0 : -1;
+}
+
+/**
+ * @brief 保存喝水记录
+ * @description 用内存中的记录整体重写数据文件，经原子快照写入：
+ *              重写过程中崩溃或收到信号，原有日志保持完整
+ */
+static int rewrite_record_log(const AppState *app) {
+    if (!app) return -1;
     
-    size_t write_size = fwrite(app->records, sizeof(WaterRecord), app->record_count, file);
-    fclose(file);
-    
-    if (write_size != app->record_count) {
+    if (snapshot_replace(app->data_path, write_record_log, app) != 0) {
+        fprintf(stderr, "%s❌ 保存数据文件失败%s\n", COLOR_RED, COLOR_RESET);
         return -1;
     }
-    
     return 0;
 }
 
 /**
- * @brief 添加喝水记录
+ * @brief 保存喝水记录并记录耗时
  */
-void add_water_record(AppState *app, int amount) {
-    if (!app || amount <= 0) return;
+int save_records(const AppState *app) {
+    METRIC_START(start);
+    int ret = rewrite_record_log(app);
+    METRIC_END(METRIC_SAVE_RECORDS, start);
+    return ret;
+}
+
+/**
+ * @brief 批量追加喝水记录到数据日志
+ * @description 一次打开文件、一次写入整批记录；空文件会先写入文件头
+ */
+int append_records(const char *path, const WaterRecord *records, int count) {
+    if (!path || !records || count <= 0) return -1;
     
-    // 检查记录数组是否已满
-    if (app->record_count >= MAX_RECORDS) {
-        // 移除最旧的记录为新记录腾出空间
-        memmove(&app->records[0], &app->records[1], 
-                (MAX_RECORDS - 1) * sizeof(WaterRecord));
-        app->record_count = MAX_RECORDS - 1;
+    FILE *file = fopen(path, "ab");
+    if (!file) {
+        perror("追加数据文件失败");
+        return -1;
     }
     
-    // 添加新记录
-    WaterRecord *record = &app->records[app->record_count];
-    record->timestamp = time(NULL);
-    record->amount = amount;
-    get_current_date_str(record->date_str);
+    // 整批记录直接交给一次 write，不经过 stdio 缓冲区
+    setvbuf(file, NULL, _IONBF, 0);
     
-    app->record_count++;
-    
-    // 更新今日统计
-    calculate_today_stats(app);
+    fseek(file, 0, SEEK_END);
+    if (ftell(file) == 0 && write_record_header(file, 0) != 0) {
+        fclose(file);
+        return -1;
+    }
     
-    // 保存数据
-    save_records(app);
+    size_t write_size = fwrite(records, sizeof(WaterRecord), (size_t)count, file);
+    if (fclose(file) != 0 || write_size != (size_t)count) {
+        return -1;
+    }
     
-    // 记录日志
-    char log_msg[100];
-    snprintf(log_msg, sizeof(log_msg), "添加喝水记录: %dml", amount);
-    log_message(log_msg);
+    return 0;
 }
 
 /**
- * @brief 计算今日统计数据
+ * @brief 追加一条喝水记录到数据日志
+ * @description 只写入新记录本身，耗时与历史记录数量无关
  */
-void calculate_today_stats(AppState *app) {
-    if (!app) return;
+int append_record(const char *path, const WaterRecord *record) {
+    return append_records(path, record, 1);
+}
+
+/**
+ * @brief 在数据文件头中标记日志存在倒序记录
+ */
+int mark_records_unsorted(const char *path) {
+    if (!path) return -1;
+    
+    FILE *file = fopen(path, "rb+");
+    if (!file) return -1;
+    
+    RecordFileHeader header;
+    int ret = -1;
+    if (fread(&header, sizeof(header), 1, file) == 1) {
+        header.flags |= DATA_FLAG_UNSORTED;
+        fseek(file, 0, SEEK_SET);
+        ret = fwrite(&header, sizeof(header), 1, file) == 1 ? 0 : -1;
+    }
     
-    char today[11];
-    get_current_date_str(today);
+    if (fclose(file) != 0) ret = -1;
+    return ret;
+}
+
+/**
+ * @brief 压缩数据日志
+ * @description 日志与内存中的记录不一致时（例如追加失败）用内存记录重写日志，
+ *              一致时不做任何写入
+ */
+int compact_records(AppState *app) {
+    if (!app) return -1;
     
-    app->today_count = 0;
-    app->today_amount = 0;
+    if (app->log_count == app->records.count) {
+        return 0;
+    }
     
-    for (int i = 0; i < app->record_count; i++) {
-        if (is_same_date(app->records[i].date_str, today)) {
-            app->today_count++;
-            app->today_amount += app->records[i].amount;
-        }
+    // 重写会替换数据文件，先提交并关闭指向旧文件的日志
+    journal_close(&app->journal);
+    if (save_records(app) != 0) {
+        return -1;
     }
+    
+    app->log_count = app->records.count;
+    log_message("数据日志压缩完成");
+    return 0;
 }
 
-/* ==================== 提醒系统函数 ==================== */
-
 /**
- * @brief 设置提醒定时器
+ * @brief 折叠后保留的日志内容
  */
-void setup_reminder_timer(AppState *app) {
-    if (!app) return;
-    
-    // 设置定时器，每分钟检查一次
-    alarm(60);
-}
+typedef struct {
+    const AppState *app;
+    int first;                     // 保留的第一条记录
+} RecordLogTail;
 
 /**
- * @brief 提醒信号处理函数
+ * @brief 写入删除开头若干条记录后的数据日志
  */
-void reminder_handler(int sig) {
-    if (sig == SIGALRM) {
-        // 检查是否需要提醒
-        if (should_remind(&g_app)) {
-            show_reminder_notification(&g_app);
-            g_app.last_reminder = time(NULL);
+static int write_record_tail(FILE *file, const void *ctx) {
+    const RecordLogTail *tail = ctx;
+    const RecordStore *store = &tail->app->records;
+    
+    if (write_record_header(file, 0) != 0) {
+        return -1;
+    }
+    for (int i = tail->first; i < store->count; i++) {
+        if (fwrite(record_store_at(store, i), sizeof(WaterRecord), 1, file) != 1) {
+            return -1;
         }
-        
-        // 重新设置定时器
-        alarm(60);
     }
+    return 0;
 }
 
 /**
- * @brief 判断是否应该提醒
+ * @brief 将超出保留期的旧记录折叠进汇总层
+ * @description 配置了原始记录保留天数时，最早的记录超出保留期 ROLLUP_FOLD_BATCH_DAYS 天后
+ *              一次性从数据日志中删除超出保留期的记录，它们只以小时/日/月汇总的形式保留。
+ *              先保存记下待删除条数的汇总层快照再重写日志，任何时刻崩溃，
+ *              下次加载时都能按日志的实际状态完成或撤销这次折叠
+ * @return 折叠的记录数，失败时返回-1
  */
-int should_remind(const AppState *app) {
-    if (!app || app->paused) return 0;
+int fold_records(AppState *app) {
+    if (!app || app->config.retention_days <= 0) return 0;
     
-    time_t now = time(NULL);
-    time_t interval_seconds = app->config.reminder_interval * 60;
+    // 存在倒序记录时无法按时间切分日志
+    if (!app->records.sorted || !rollup_ready(&app->rollup, &app->records) ||
+        app->records.count == 0) {
+        return 0;
+    }
     
-    // 如果从未提醒过，或者距离上次提醒已超过间隔时间
-    return (app->last_reminder == 0) || 
-           (now - app->last_reminder >= interval_seconds);
+    int retention = app->config.retention_days;
+    if (retention < ROLLUP_RETENTION_MIN) retention = ROLLUP_RETENTION_MIN;
+    int cutoff_day = today_day_number() - retention + 1;
+    time_t oldest = (time_t)record_store_at(&app->records, 0)->timestamp;
+    if (oldest >= day_start_time(cutoff_day - ROLLUP_FOLD_BATCH_DAYS)) {
+        return 0;
+    }
+    int fold = record_store_lower_bound(&app->records, day_start_time(cutoff_day));
+    
+    app->rollup.pending = fold;
+    app->rollup.folded += fold;
+    app->rollup.dirty = 1;
+    if (rollup_save(&app->rollup, app->rollup_path, &app->records) != 0) {
+        app->rollup.pending = 0;
+        app->rollup.folded -= fold;
+        return -1;
+    }
+    
+    // 重写会替换数据文件，先提交并关闭指向旧文件的日志
+    journal_close(&app->journal);
+    RecordLogTail tail = { app, fold };
+    if (snapshot_replace(app->data_path, write_record_tail, &tail) != 0) {
+        app->rollup.pending = 0;
+        app->rollup.folded -= fold;
+        app->rollup.dirty = 1;
+        rollup_save(&app->rollup, app->rollup_path, &app->records);
+        return -1;
+    }
+    
+    // 汇总层不变，只是计入的记录少了已删除的部分；重新映射缩短后的日志
+    app->rollup.covered -= fold;
+    app->rollup.pending = 0;
+    app->rollup.dirty = 1;
+    if (load_records(app) != 0) {
+        return -1;
+    }
+    rollup_save(&app->rollup, app->rollup_path, &app->records);
+    
+    char log_msg[128];
+    snprintf(log_msg, sizeof(log_msg), "已将 %d 条超过 %d 天的记录折叠进汇总层", fold, retention);
+    log_message(log_msg);
+    return fold;
 }
 
-/* ==================== 工具函数 ==================== */
-
 /**
- * @brief 获取当前日期字符串
+ * @brief 检查单次喝水量是否有效（界面、守护进程和导入共用同一规则）
  */
-void get_current_date_str(char *date_str) {
-    if (!date_str) return;
-    
-    time_t now = time(NULL);
-    struct tm *tm_info = localtime(&now);
-    strftime(date_str, 11, "%Y-%m-%d", tm_info);
+int water_amount_valid(int amount) {
+    return amount > 0 && amount <= WATER_AMOUNT_MAX;
 }
 
 /**
- * @brief 比较两个日期字符串是否相同
+ * @brief 添加喝水记录
  */
-int is_same_date(const char *date1, const char *date2) {
-    if (!date1 || !date2) return 0;
-    return strcmp(date1, date2) == 0;
+void add_water_record(AppState *app, int amount) {
+    if (!app || amount <= 0) return;
+    
+    // 添加新记录
+    WaterRecord *record = record_store_append(&app->records);
+    if (!record) {
+        log_message("内存不足，喝水记录添加失败");
+        return;
+    }
+    record->timestamp = (uint32_t)time(NULL);
+    record->amount = amount;
+    
+    // 系统时间被回拨时新记录会早于上一条，之后的加载不能再只扫描日志末尾
+    int unsorted = app->records.sorted && app->records.count > 1 &&
+        record->timestamp < record_store_at(&app->records, app->records.count - 2)->timestamp;
+    int day = timestamp_to_day(record->timestamp);
+    day_index_add(&app->day_index, day, amount, record->timestamp);
+    rollup_sync(&app->rollup, &app->records);
+    
+    // 更新今日统计：同一天内直接累加，日期与统计不符（系统时间被修改）时重新计算
+    if (day == app->today_day) {
+        app->today_count++;
+        app->today_amount += amount;
+    } else {
+        calculate_today_stats(app);
+    }
+    
+    // 追加到数据日志
+    if (journal_append(app, record, 1) == 0) {
+        app->log_count++;
+    }
+    if (unsorted) {
+        app->records.sorted = 0;
+        mark_records_unsorted(app->data_path);
+    }
+    
+    // 记录日志
+    char log_msg[100];
+    if (app->user[0] != '\0') {
+        snprintf(log_msg, sizeof(log_msg), "[%s] 添加喝水记录: %dml", app->user, amount);
+    } else {
+        snprintf(log_msg, sizeof(log_msg), "添加喝水记录: %dml", amount);
+    }
+    log_message(log_msg);
 }
 
 /**
- * @brief 记录日志消息
+ * @brief 计算今日统计数据
  */
-void log_message(const char *message) {
-    if (!message) return;
+void calculate_today_stats(AppState *app) {
+    if (!app) return;
     
-    FILE *log_file = fopen(LOG_FILE, "a");
-    if (!log_file) return;
+    METRIC_START(start);
+    app->today_day = today_day_number();
+    const DayAggregate *today = day_index_get(&app->day_index, app->today_day);
     
-    time_t now = time(NULL);
-    char time_str[64];
-    struct tm *tm_info = localtime(&now);
-    strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", tm_info);
+    app->today_count = today ? today->count : 0;
+    app->today_amount = today ? today->total_ml : 0;
+    METRIC_END(METRIC_TODAY_STATS, start);
+}
+
+/**
+ * @brief 跨过零点时切换今日统计
+ * @param today 当前的天号
+ * @description 由事件循环的零点定时器调用，没有新记录时今日统计也会按时归零；
+ *              同时保存每日聚合快照，长时间运行后异常退出，下次启动也只需补上一天内的记录
+ */
+void today_stats_rollover(AppState *app, int today) {
+    if (!app || app->today_day == today) return;
     
-    fprintf(log_file, "[%s] %s\n", time_str, message);
-    fclose(log_file);
+    calculate_today_stats(app);
+    save_day_index(app);
 }
 
+/* ==================== 提醒系统函数 ==================== */
+
 /**
- * @brief 播放音效
+ * @brief 判断是否应该提醒
  */
-void play_sound_effect(void) {
-    // 在Linux系统上播放系统提示音
-    system("pactl upload-sample /usr/share/sounds/alsa/Front_Left.wav bell");
-    system("pactl play-sample bell");
-} 
\ No newline at end of file
+int should_remind(const AppState *app) {
+    if (!app || app->paused) return 0;
+    
+    time_t now = time(NULL);
+    time_t interval_seconds = app->config.reminder_interval * 60;
+    
+    // 如果从未提醒过，或者距离上次提醒已超过间隔时间
+    return (app->last_reminder == 0) || 
+           (now - app->last_reminder >= interval_seconds);
+}
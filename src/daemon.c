@@ -0,0 +1,543 @@
+/**
+ * @file daemon.c
+ * @brief 喝水提醒终端应用 - 守护进程模块
+ * @author zcg
+ * @date 2024
+ * @description 无界面的守护进程模式：持有应用状态并运行提醒定时器，
+ *              通过本地 Unix 套接字提供记录、查询和配置接口。
+ *              协议为逐行文本，每行一条请求、一行响应（"OK ..." 或 "ERR ..."），
+ *              同一连接上可以连续发送多条请求，响应按请求顺序返回；
+ *              每个连接通过 USER 请求选择要操作的用户分片
+ */
+
+#include "water_reminder.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/**
+ * @brief 客户端连接
+ */
+typedef struct {
+    int fd;                        // 连接描述符
+    char user[USER_NAME_MAX];      // 当前选择的用户（空字符串表示默认用户）
+    char input[DAEMON_LINE_MAX];   // 尚未处理完的请求数据
+    size_t input_length;           // 请求数据长度
+    char *output;                  // 待发送的响应
+    size_t output_length;          // 响应数据长度
+    size_t output_sent;            // 已发送的响应字节数
+    size_t output_capacity;        // 响应缓冲区容量
+    int closing;                   // 对端已关闭写入，响应发送完后断开
+} DaemonClient;
+
+/**
+ * @brief 守护进程状态
+ */
+static struct {
+    int listen_fd;                 // 监听套接字
+    DaemonClient clients[DAEMON_MAX_CLIENTS];
+    int client_count;              // 当前连接数
+} g_daemon = { .listen_fd = -1 };
+
+/* ==================== 套接字管理函数 ==================== */
+
+/**
+ * @brief 设置描述符为非阻塞
+ */
+static int set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags < 0 ? -1 : fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+/**
+ * @brief 创建并监听本地套接字
+ * @description 套接字文件已存在时先尝试连接，无人监听则视为上次异常退出留下的文件
+ */
+static int daemon_listen(void) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, DAEMON_SOCKET_FILE, sizeof(addr.sun_path) - 1);
+
+    int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (probe >= 0) {
+        int in_use = connect(probe, (struct sockaddr *)&addr, sizeof(addr)) == 0;
+        close(probe);
+        if (in_use) {
+            fprintf(stderr, "%s❌ 守护进程已在运行: %s%s\n",
+                    COLOR_RED, DAEMON_SOCKET_FILE, COLOR_RESET);
+            return -1;
+        }
+    }
+    unlink(DAEMON_SOCKET_FILE);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        perror("创建套接字失败");
+        return -1;
+    }
+
+    // 套接字只允许当前用户访问
+    mode_t old_mask = umask(0077);
+    int ret = bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+    umask(old_mask);
+
+    if (ret != 0 || listen(fd, SOMAXCONN) != 0) {
+        perror("监听套接字失败");
+        close(fd);
+        return -1;
+    }
+
+    g_daemon.listen_fd = fd;
+    return 0;
+}
+
+/**
+ * @brief 关闭一个客户端连接（用最后一个连接填补空位）
+ */
+static void client_close(int index) {
+    DaemonClient *client = &g_daemon.clients[index];
+    close(client->fd);
+    free(client->output);
+
+    g_daemon.client_count--;
+    if (index != g_daemon.client_count) {
+        *client = g_daemon.clients[g_daemon.client_count];
+    }
+}
+
+/**
+ * @brief 接受所有等待中的连接
+ */
+static void accept_clients(void) {
+    while (g_daemon.client_count < DAEMON_MAX_CLIENTS) {
+        int fd = accept(g_daemon.listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+
+        if (set_nonblocking(fd) != 0) {
+            close(fd);
+            continue;
+        }
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+        DaemonClient *client = &g_daemon.clients[g_daemon.client_count++];
+        memset(client, 0, sizeof(DaemonClient));
+        client->fd = fd;
+    }
+}
+
+/**
+ * @brief 关闭守护进程的所有连接、卸载用户分片并删除套接字文件
+ */
+void daemon_shutdown(void) {
+    while (g_daemon.client_count > 0) {
+        client_close(g_daemon.client_count - 1);
+    }
+
+    if (g_daemon.listen_fd >= 0) {
+        close(g_daemon.listen_fd);
+        g_daemon.listen_fd = -1;
+        unlink(DAEMON_SOCKET_FILE);
+    }
+
+    shard_shutdown();
+}
+
+/* ==================== 请求处理函数 ==================== */
+
+/**
+ * @brief 向客户端追加一行格式化响应
+ */
+static void client_reply(DaemonClient *client, const char *format, ...) {
+    va_list args, copy;
+    va_start(args, format);
+    va_copy(copy, args);
+    int length = vsnprintf(NULL, 0, format, copy);
+    va_end(copy);
+
+    // 预留换行符和结尾的空字符
+    size_t needed = client->output_length + (size_t)length + 2;
+    if (length >= 0 && needed > client->output_capacity) {
+        size_t capacity = client->output_capacity > 0 ? client->output_capacity : 1024;
+        while (capacity < needed) {
+            capacity *= 2;
+        }
+        char *output = realloc(client->output, capacity);
+        if (output) {
+            client->output = output;
+            client->output_capacity = capacity;
+        } else {
+            length = -1;
+        }
+    }
+
+    if (length >= 0) {
+        vsnprintf(client->output + client->output_length, (size_t)length + 1, format, args);
+        client->output_length += (size_t)length;
+        client->output[client->output_length++] = '\n';
+    }
+    va_end(args);
+}
+
+/**
+ * @brief 解析整数参数（不允许多余字符）
+ */
+static int parse_int(const char *text, int *value) {
+    if (!text || *text == '\0') return -1;
+
+    char *end;
+    long number = strtol(text, &end, 10);
+    if (*end != '\0' || number < -1000000 || number > 1000000) return -1;
+
+    *value = (int)number;
+    return 0;
+}
+
+/**
+ * @brief 解析时间戳参数（Unix秒）
+ */
+static int parse_time(const char *text, time_t *value) {
+    if (!text || *text == '\0') return -1;
+
+    char *end;
+    errno = 0;
+    long long number = strtoll(text, &end, 10);
+    if (*end != '\0' || errno != 0 || number < 0 || number > UINT32_MAX) return -1;
+
+    *value = (time_t)number;
+    return 0;
+}
+
+/**
+ * @brief 处理 GET 请求
+ */
+static void handle_get(AppState *app, DaemonClient *client, const char *key) {
+    const UserConfig *config = &app->config;
+
+    if (!key) {
+        client_reply(client, "ERR missing key");
+    } else if (strcmp(key, "name") == 0) {
+        client_reply(client, "OK %s", config->name);
+    } else if (strcmp(key, "interval") == 0) {
+        client_reply(client, "OK %d", config->reminder_interval);
+    } else if (strcmp(key, "goal") == 0) {
+        client_reply(client, "OK %d", config->daily_goal);
+    } else if (strcmp(key, "cup") == 0) {
+        client_reply(client, "OK %d", config->cup_size);
+    } else if (strcmp(key, "sound") == 0) {
+        client_reply(client, "OK %d", config->sound_enabled);
+    } else if (strcmp(key, "animations") == 0) {
+        client_reply(client, "OK %d", config->animations_enabled);
+    } else if (strcmp(key, "durability") == 0) {
+        client_reply(client, "OK %s", durability_name(config->durability));
+    } else if (strcmp(key, "window") == 0) {
+        client_reply(client, "OK %d", config->commit_window_ms);
+    } else if (strcmp(key, "retention") == 0) {
+        client_reply(client, "OK %d", config->retention_days);
+    } else {
+        client_reply(client, "ERR unknown key");
+    }
+}
+
+/**
+ * @brief 处理 SET 请求，取值范围与设置菜单一致
+ */
+static void handle_set(AppState *app, DaemonClient *client, const char *key, const char *value) {
+    UserConfig *config = &app->config;
+    int number = 0;
+
+    if (!key || !value) {
+        client_reply(client, "ERR usage: SET <key> <value>");
+        return;
+    }
+
+    if (strcmp(key, "name") == 0) {
+        if (strlen(value) >= MAX_NAME_LEN) {
+            client_reply(client, "ERR name too long");
+            return;
+        }
+        strcpy(config->name, value);
+    } else if (strcmp(key, "durability") == 0) {
+        int level = durability_parse(value);
+        if (level < 0) {
+            client_reply(client, "ERR durability must be none, batched or record");
+            return;
+        }
+        config->durability = level;
+    } else if (parse_int(value, &number) != 0) {
+        client_reply(client, "ERR invalid value");
+        return;
+    } else if (strcmp(key, "interval") == 0 && number >= 5 && number <= 300) {
+        config->reminder_interval = number;
+    } else if (strcmp(key, "goal") == 0 && number >= 1 && number <= 20) {
+        config->daily_goal = number;
+    } else if (strcmp(key, "cup") == 0 && number >= 50 && number <= 1000) {
+        config->cup_size = number;
+    } else if (strcmp(key, "sound") == 0 && (number == 0 || number == 1)) {
+        config->sound_enabled = number;
+    } else if (strcmp(key, "animations") == 0 && (number == 0 || number == 1)) {
+        config->animations_enabled = number;
+    } else if (strcmp(key, "window") == 0 && number >= 0 && number <= JOURNAL_WINDOW_MAX) {
+        config->commit_window_ms = number;
+    } else if (strcmp(key, "retention") == 0 &&
+               (number == 0 || (number >= ROLLUP_RETENTION_MIN && number <= ROLLUP_RETENTION_MAX))) {
+        config->retention_days = number;
+    } else {
+        client_reply(client, "ERR unknown key or value out of range");
+        return;
+    }
+
+    save_config(config, app->config_path);
+    client_reply(client, "OK");
+}
+
+/**
+ * @brief 处理一条请求
+ * @description 支持的请求：
+ *              PING                      -> OK
+ *              ADD <ml>                  -> OK <今日总量> <今日次数>
+ *              TODAY                     -> OK <今日总量> <今日次数> <目标毫升>
+ *              STATS                     -> OK <今日总量> <今日次数> <目标毫升> <连续天数> <7日平均>
+ *              DAYS <n>                  -> OK <今天> <昨天> ...（共n天，1-366）
+ *              RANGE <from> <to>         -> OK <总量> <次数> <最小> <最大>（Unix秒，[from, to)）
+ *              GET <key> / SET <key> <v> -> key: name interval goal cup sound animations
+ *                                           durability window retention
+ *              PAUSE / RESUME            -> OK
+ *              USER [name]               -> OK（切换用户，不带参数时切换回默认用户）
+ */
+static void handle_request(DaemonClient *client, char *line) {
+    char *save = NULL;
+    char *command = strtok_r(line, " \t\r", &save);
+    char *arg = strtok_r(NULL, " \t\r", &save);
+    int number = 0;
+
+    if (!command) {
+        client_reply(client, "ERR empty request");
+        return;
+    }
+    if (strcmp(command, "PING") == 0) {
+        client_reply(client, "OK");
+        return;
+    }
+    if (strcmp(command, "USER") == 0) {
+        // 切换时即加载分片，用户名无效或数据损坏时立即报错
+        if (!shard_get(arg ? arg : "")) {
+            client_reply(client, "ERR invalid user");
+            return;
+        }
+        snprintf(client->user, sizeof(client->user), "%s", arg ? arg : "");
+        client_reply(client, "OK");
+        return;
+    }
+
+    AppState *app = shard_get(client->user);
+    if (!app) {
+        client_reply(client, "ERR user unavailable");
+        return;
+    }
+    int goal_ml = app->config.daily_goal * app->config.cup_size;
+
+    if (strcmp(command, "ADD") == 0) {
+        if (parse_int(arg, &number) != 0 || !water_amount_valid(number)) {
+            client_reply(client, "ERR amount must be 1-%d", WATER_AMOUNT_MAX);
+            return;
+        }
+        add_water_record(app, number);
+        client_reply(client, "OK %d %d", app->today_amount, app->today_count);
+    } else if (strcmp(command, "TODAY") == 0) {
+        client_reply(client, "OK %d %d %d", app->today_amount, app->today_count, goal_ml);
+    } else if (strcmp(command, "STATS") == 0) {
+        client_reply(client, "OK %d %d %d %d %.0f", app->today_amount, app->today_count,
+                     goal_ml, get_streak_days(app), calculate_daily_average(app, 7));
+    } else if (strcmp(command, "DAYS") == 0) {
+        if (parse_int(arg, &number) != 0 || number < 1 || number > DAY_INDEX_WARM_DAYS) {
+            client_reply(client, "ERR days must be 1-%d", DAY_INDEX_WARM_DAYS);
+            return;
+        }
+        // 按日查询最近 n 天（汇总层中包含已折叠的记录），从今天开始倒序输出
+        QueryBucket days[DAY_INDEX_WARM_DAYS];
+        if (range_query_recent_days(app, number, 0, days, number, NULL) != number) {
+            client_reply(client, "ERR out of memory");
+            return;
+        }
+        char buffer[DAY_INDEX_WARM_DAYS * 8 + 8] = "OK";
+        size_t length = 2;
+        for (int day = number - 1; day >= 0 && length < sizeof(buffer); day--) {
+            length += snprintf(buffer + length, sizeof(buffer) - length, " %lld", days[day].sum);
+        }
+        client_reply(client, "%s", buffer);
+    } else if (strcmp(command, "RANGE") == 0) {
+        time_t from, to;
+        if (parse_time(arg, &from) != 0 || parse_time(strtok_r(NULL, " \t\r", &save), &to) != 0) {
+            client_reply(client, "ERR usage: RANGE <from> <to>");
+            return;
+        }
+        // 已折叠的记录只按小时汇总，区间不能切开其中有记录的小时
+        RangeAggregate range;
+        int result = range_aggregate(app, from, to, &range);
+        if (result != 0) {
+            client_reply(client, result == -2 ? "ERR range splits a folded hour" : "ERR out of memory");
+            return;
+        }
+        client_reply(client, "OK %lld %d %d %d", range.sum, range.count, range.min, range.max);
+    } else if (strcmp(command, "GET") == 0) {
+        handle_get(app, client, arg);
+    } else if (strcmp(command, "SET") == 0) {
+        // 值取行内剩余部分，允许姓名中包含空格
+        char *value = save ? save + strspn(save, " \t") : NULL;
+        if (value && *value == '\0') value = NULL;
+        if (value) value[strcspn(value, "\r")] = '\0';
+        handle_set(app, client, arg, value);
+    } else if (strcmp(command, "PAUSE") == 0 || strcmp(command, "RESUME") == 0) {
+        app->paused = command[0] == 'P';
+        client_reply(client, "OK");
+    } else {
+        client_reply(client, "ERR unknown command");
+    }
+}
+
+/* ==================== 连接读写函数 ==================== */
+
+/**
+ * @brief 尽可能多地发送待发送的响应
+ * @return 连接出错时返回-1
+ */
+static int client_flush(DaemonClient *client) {
+    while (client->output_sent < client->output_length) {
+        ssize_t n = send(client->fd, client->output + client->output_sent,
+                         client->output_length - client->output_sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+        }
+        client->output_sent += (size_t)n;
+    }
+
+    client->output_length = 0;
+    client->output_sent = 0;
+    return 0;
+}
+
+/**
+ * @brief 读取请求并逐行处理
+ * @description 待发送的响应超过上限时暂停读取，由对端的接收速度限流
+ * @return 连接出错或请求过长时返回-1
+ */
+static int client_read(DaemonClient *client) {
+    while (!client->closing && client->output_length - client->output_sent < DAEMON_OUTPUT_MAX) {
+        ssize_t n = read(client->fd, client->input + client->input_length,
+                         sizeof(client->input) - client->input_length);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+        }
+        if (n == 0) {
+            client->closing = 1;
+            break;
+        }
+        client->input_length += (size_t)n;
+
+        // 处理缓冲区中所有完整的行
+        size_t start = 0;
+        char *newline;
+        while ((newline = memchr(client->input + start, '\n',
+                                 client->input_length - start)) != NULL) {
+            *newline = '\0';
+            handle_request(client, client->input + start);
+            start = (size_t)(newline - client->input) + 1;
+        }
+
+        memmove(client->input, client->input + start, client->input_length - start);
+        client->input_length -= start;
+        if (client->input_length == sizeof(client->input)) {
+            client_reply(client, "ERR request too long");
+            client_flush(client);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* ==================== 守护进程主循环 ==================== */
+
+/**
+ * @brief 以守护进程方式运行，直到收到退出信号
+ * @param app 默认用户的状态，作为常驻分片；其他用户在首次访问时加载
+ */
+int daemon_run(AppState *app) {
+    if (!app || daemon_listen() != 0) {
+        return -1;
+    }
+    if (shard_init(app) != 0) {
+        daemon_shutdown();
+        return -1;
+    }
+
+    log_message("守护进程已启动");
+    printf("守护进程已启动，监听 %s\n", DAEMON_SOCKET_FILE);
+    fflush(stdout);
+
+    struct pollfd fds[EVENT_POLL_FDS + 2 + DAEMON_MAX_CLIENTS];
+
+    while (app->is_running) {
+        int base = event_poll_prepare(fds);
+        int shard_slot = base;
+        base += shard_poll_prepare(&fds[shard_slot]);
+
+        fds[base].fd = g_daemon.client_count < DAEMON_MAX_CLIENTS ? g_daemon.listen_fd : -1;
+        fds[base].events = POLLIN;
+        fds[base].revents = 0;
+
+        int count = g_daemon.client_count;
+        for (int i = 0; i < count; i++) {
+            DaemonClient *client = &g_daemon.clients[i];
+            size_t pending = client->output_length - client->output_sent;
+            struct pollfd *pfd = &fds[base + 1 + i];
+
+            pfd->fd = client->fd;
+            pfd->events = 0;
+            pfd->revents = 0;
+            if (!client->closing && pending < DAEMON_OUTPUT_MAX) pfd->events |= POLLIN;
+            if (pending > 0) pfd->events |= POLLOUT;
+        }
+
+        if (poll(fds, base + 1 + count, -1) < 0) {
+            if (errno == EINTR) continue;
+            perror("poll失败");
+            break;
+        }
+
+        event_poll_dispatch(fds);
+        shard_poll_dispatch(&fds[shard_slot]);
+
+        // 从后往前处理，关闭连接时的移动不影响尚未处理的下标
+        for (int i = count - 1; i >= 0; i--) {
+            DaemonClient *client = &g_daemon.clients[i];
+            short revents = fds[base + 1 + i].revents;
+            int failed = 0;
+
+            if (revents & (POLLIN | POLLHUP | POLLERR)) {
+                failed = client_read(client) != 0;
+            }
+            if (!failed) {
+                failed = client_flush(client) != 0;
+            }
+            if (failed || (client->closing && client->output_length == 0)) {
+                client_close(i);
+            }
+        }
+
+        if (fds[base].revents & POLLIN) {
+            accept_clients();
+        }
+    }
+
+    daemon_shutdown();
+    return 0;
+}
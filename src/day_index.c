@@ -0,0 +1,339 @@
+/**
+ * @file day_index.c
+ * @brief 喝水提醒终端应用 - 每日聚合索引模块
+ * @author zcg
+ * @date 2024
+ * @description 按天号索引的每日聚合数据（总量、次数、首末记录时间），
+ *              加载时从日志末尾向前只构建所需的最近天数，添加记录时增量更新，
+ *              统计视图按天直接查表。退出时保存最近一段时间的聚合和对应的日志位置，
+ *              下次启动只需补上之后追加的记录，启动耗时与历史记录数量无关
+ */
+
+#include "water_reminder.h"
+#include <limits.h>
+
+/**
+ * @brief 每日聚合快照的数据头，之后是 day_count 天的聚合数组
+ * @description 用数据日志中最后一条已计入记录的内容校验快照与日志是否对应，
+ *              用起始天的零点时间校验时区是否变化
+ */
+typedef struct {
+    int32_t covered;               // 已计入的数据日志记录数
+    uint32_t last_timestamp;       // 第 covered 条记录的时间戳
+    int32_t last_amount;           // 第 covered 条记录的喝水量
+    int32_t from_day;              // 快照完整覆盖的起始天号
+    int64_t from_time;             // 起始天的零点时间
+    int32_t base_day;              // 聚合数组的起始天号
+    int32_t day_count;             // 聚合数组的天数
+} DayIndexFileHeader;
+
+/* ==================== 每日聚合索引函数 ==================== */
+
+/**
+ * @brief 初始化每日聚合索引
+ */
+void day_index_init(DayIndex *index) {
+    if (!index) return;
+
+    index->days = NULL;
+    index->base_day = 0;
+    index->day_count = 0;
+    index->capacity = 0;
+    index->indexed_from = 0;
+}
+
+/**
+ * @brief 释放每日聚合索引
+ */
+void day_index_free(DayIndex *index) {
+    if (!index) return;
+
+    free(index->days);
+    day_index_init(index);
+}
+
+/**
+ * @brief 清空索引但保留已分配的内存
+ */
+void day_index_clear(DayIndex *index) {
+    if (!index) return;
+    index->day_count = 0;
+    index->indexed_from = 0;
+}
+
+/**
+ * @brief 清空索引并将存储中的全部记录标记为待索引
+ */
+void day_index_reset(DayIndex *index, const RecordStore *store) {
+    if (!index || !store) return;
+
+    day_index_clear(index);
+    index->indexed_from = store->count;
+}
+
+/**
+ * @brief 扩展索引使其覆盖指定天号
+ */
+static int day_index_cover(DayIndex *index, int day) {
+    if (index->day_count == 0) {
+        index->base_day = day;
+    }
+
+    // 早于当前起始日的记录很少见（例如系统时间被回拨），整体后移即可
+    int prepend = day < index->base_day ? index->base_day - day : 0;
+    int needed = index->day_count + prepend;
+    if (day - index->base_day + 1 > needed) {
+        needed = day - index->base_day + 1;
+    }
+
+    if (needed > index->capacity) {
+        int new_capacity = index->capacity > 0 ? index->capacity : 64;
+        while (new_capacity < needed) {
+            new_capacity *= 2;
+        }
+
+        DayAggregate *days = realloc(index->days, new_capacity * sizeof(DayAggregate));
+        if (!days) return -1;
+        index->days = days;
+        index->capacity = new_capacity;
+    }
+
+    if (prepend > 0) {
+        memmove(&index->days[prepend], &index->days[0],
+                index->day_count * sizeof(DayAggregate));
+        memset(&index->days[0], 0, prepend * sizeof(DayAggregate));
+        index->base_day = day;
+        index->day_count += prepend;
+    }
+
+    if (needed > index->day_count) {
+        memset(&index->days[index->day_count], 0,
+               (needed - index->day_count) * sizeof(DayAggregate));
+        index->day_count = needed;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief 将一条记录计入索引
+ */
+int day_index_add(DayIndex *index, int day, int amount, time_t timestamp) {
+    if (!index) return -1;
+
+    if (day_index_cover(index, day) != 0) {
+        return -1;
+    }
+
+    DayAggregate *agg = &index->days[day - index->base_day];
+    if (agg->count == 0 || timestamp < agg->first_time) {
+        agg->first_time = timestamp;
+    }
+    if (agg->count == 0 || timestamp > agg->last_time) {
+        agg->last_time = timestamp;
+    }
+    if (agg->count == 0 || amount < agg->min_ml) {
+        agg->min_ml = amount;
+    }
+    if (agg->count == 0 || amount > agg->max_ml) {
+        agg->max_ml = amount;
+    }
+    agg->total_ml += amount;
+    agg->count++;
+
+    return 0;
+}
+
+/**
+ * @brief 查询某一天的聚合数据
+ * @return 当天没有记录时返回NULL
+ */
+const DayAggregate *day_index_get(const DayIndex *index, int day) {
+    if (!index || index->day_count == 0) return NULL;
+
+    int offset = day - index->base_day;
+    if (offset < 0 || offset >= index->day_count) {
+        return NULL;
+    }
+
+    const DayAggregate *agg = &index->days[offset];
+    return agg->count > 0 ? agg : NULL;
+}
+
+/**
+ * @brief 查询某一天的喝水总量
+ */
+int day_index_amount(const DayIndex *index, int day) {
+    const DayAggregate *agg = day_index_get(index, day);
+    return agg ? agg->total_ml : 0;
+}
+
+/**
+ * @brief 判断索引是否已包含从指定天号开始的全部记录
+ * @description 尚未索引的记录都早于最后一条未索引记录所在的天（有序日志中该天已被跳过），
+ *              之后的天均已完整索引
+ */
+int day_index_covers(const DayIndex *index, const RecordStore *store, int day) {
+    if (!index || !store) return 0;
+    if (index->indexed_from == 0) return 1;
+    if (!store->sorted) return 0;
+
+    const WaterRecord *record = record_store_at(store, index->indexed_from - 1);
+    return day > timestamp_to_day(record->timestamp);
+}
+
+/**
+ * @brief 确保索引覆盖从指定天号开始的全部记录
+ * @description 从尚未索引的最新记录向前扫描，遇到早于 from_day 的记录即停止，
+ *              只会访问所需范围内的记录页面；日志中存在倒序记录时退化为全量扫描
+ */
+int day_index_ensure(DayIndex *index, const RecordStore *store, int from_day) {
+    if (!index || !store) return -1;
+
+    if (!store->sorted) {
+        from_day = INT_MIN;
+    }
+
+    while (index->indexed_from > 0) {
+        const WaterRecord *record = record_store_at(store, index->indexed_from - 1);
+        int day = timestamp_to_day(record->timestamp);
+        if (day < from_day) {
+            break;
+        }
+
+        if (day_index_add(index, day, record->amount, record->timestamp) != 0) {
+            return -1;
+        }
+        index->indexed_from--;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief 根据记录存储重建完整索引
+ */
+int day_index_build(DayIndex *index, const RecordStore *store) {
+    if (!index || !store) return -1;
+
+    day_index_reset(index, store);
+    return day_index_ensure(index, store, INT_MIN);
+}
+
+/* ==================== 持久化函数 ==================== */
+
+/**
+ * @brief 加载每日聚合快照并补上快照之后追加的记录
+ * @description 快照之前的记录视为尚未索引，需要更早的天数时由 day_index_ensure 继续向前扫描
+ * @return 快照缺失、损坏或与数据日志不对应时返回-1，此时索引为空
+ */
+int day_index_load(DayIndex *index, const char *path, const RecordStore *store) {
+    if (!index || !path || !store) return -1;
+
+    day_index_clear(index);
+
+    // 存在倒序记录时无法按时间定位快照的起点
+    struct stat st;
+    if (!store->sorted || stat(path, &st) != 0 || st.st_size <= (off_t)sizeof(SnapshotHeader) ||
+        st.st_size - (off_t)sizeof(SnapshotHeader) > UINT32_MAX) {
+        return -1;
+    }
+
+    uint32_t capacity = (uint32_t)(st.st_size - (off_t)sizeof(SnapshotHeader));
+    unsigned char *payload = malloc(capacity);
+    uint16_t version = 0;
+    uint32_t loaded = 0;
+    if (!payload || snapshot_load(path, DAY_INDEX_FILE_MAGIC, &version, payload, capacity, &loaded) != 0 ||
+        version != DAY_INDEX_FILE_VERSION || loaded < sizeof(DayIndexFileHeader)) {
+        free(payload);
+        return -1;
+    }
+
+    DayIndexFileHeader header;
+    memcpy(&header, payload, sizeof(header));
+    int valid = header.covered >= 0 && header.covered <= store->count && header.day_count >= 0 &&
+                loaded - sizeof(header) == (size_t)header.day_count * sizeof(DayAggregate) &&
+                (time_t)header.from_time == day_start_time(header.from_day);
+    if (valid && header.covered > 0) {
+        const WaterRecord *last = record_store_at(store, header.covered - 1);
+        valid = last->timestamp == header.last_timestamp && last->amount == header.last_amount;
+    }
+    if (valid && header.day_count > index->capacity) {
+        DayAggregate *days = realloc(index->days, (size_t)header.day_count * sizeof(DayAggregate));
+        valid = days != NULL;
+        if (days) {
+            index->days = days;
+            index->capacity = header.day_count;
+        }
+    }
+    if (!valid) {
+        free(payload);
+        return -1;
+    }
+
+    if (header.day_count > 0) {
+        memcpy(index->days, payload + sizeof(header), (size_t)header.day_count * sizeof(DayAggregate));
+    }
+    index->base_day = header.base_day;
+    index->day_count = header.day_count;
+    free(payload);
+
+    // 起始天之前的记录尚未索引；日志停在起始天之前时（长期没有记录）从快照末尾开始
+    int first = record_store_lower_bound(store, (time_t)header.from_time);
+    index->indexed_from = first < header.covered ? first : header.covered;
+
+    for (int i = header.covered; i < store->count; i++) {
+        const WaterRecord *record = record_store_at(store, i);
+        if (day_index_add(index, timestamp_to_day(record->timestamp), record->amount,
+                          record->timestamp) != 0) {
+            day_index_clear(index);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief 保存从指定天号开始的每日聚合快照
+ * @description 只保存已完整索引的天；内容自上次保存后没有变化时不写入
+ */
+int day_index_save(const DayIndex *index, const char *path, const RecordStore *store, int from_day) {
+    if (!index || !path || !store) return -1;
+    if (!store->sorted) return 0;
+
+    if (index->indexed_from > 0) {
+        const WaterRecord *record = record_store_at(store, index->indexed_from - 1);
+        int partial = timestamp_to_day(record->timestamp);
+        if (from_day <= partial) from_day = partial + 1;
+    }
+
+    DayIndexFileHeader header;
+    memset(&header, 0, sizeof(header));
+    header.covered = store->count;
+    if (store->count > 0) {
+        const WaterRecord *last = record_store_at(store, store->count - 1);
+        header.last_timestamp = last->timestamp;
+        header.last_amount = last->amount;
+    }
+    header.from_day = from_day;
+    header.from_time = (int64_t)day_start_time(from_day);
+
+    int first = index->base_day > from_day ? index->base_day : from_day;
+    int end = index->base_day + index->day_count;
+    header.base_day = first;
+    header.day_count = index->day_count > 0 && end > first ? end - first : 0;
+
+    size_t size = sizeof(header) + (size_t)header.day_count * sizeof(DayAggregate);
+    unsigned char *payload = malloc(size);
+    if (!payload) return -1;
+
+    memcpy(payload, &header, sizeof(header));
+    if (header.day_count > 0) {
+        memcpy(payload + sizeof(header), &index->days[first - index->base_day],
+               (size_t)header.day_count * sizeof(DayAggregate));
+    }
+
+    int ret = snapshot_save(path, DAY_INDEX_FILE_MAGIC, DAY_INDEX_FILE_VERSION, payload, (uint32_t)size);
+    free(payload);
+    return ret;
+}
@@ -0,0 +1,280 @@
+/**
+ * @file event.c
+ * @brief 喝水提醒终端应用 - 事件循环模块
+ * @author zcg
+ * @date 2024
+ * @description 基于 timerfd、signalfd 和 poll 的主线程事件循环：
+ *              提醒定时器直接睡到下一次到期时刻，零点定时器在本地零点切换今日统计，
+ *              退出信号、提醒和动画帧都在主线程中处理
+ */
+
+#include "water_reminder.h"
+#include <errno.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+
+/**
+ * @brief 事件循环状态
+ */
+static struct {
+    AppState *app;                 // 事件循环所服务的应用状态
+    int timer_fd;                  // 提醒定时器
+    int signal_fd;                 // 退出信号
+    int day_fd;                    // 零点定时器
+    time_t first_check;            // 从未提醒过时的首次检查时间
+    time_t armed_at;               // 定时器当前设置的到期时间（0表示未设置）
+    int armed_day;                 // 零点定时器对应的今日天号（0表示未设置）
+} g_event = { NULL, -1, -1, -1, 0, 0, 0 };
+
+/**
+ * @brief 初始化事件循环
+ * @description 屏蔽 SIGINT/SIGTERM 并改由 signalfd 接收，
+ *              需在创建任何线程之前调用，使所有线程继承该信号屏蔽字
+ */
+int event_loop_init(AppState *app) {
+    if (!app) return -1;
+
+    g_event.app = app;
+
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    if (sigprocmask(SIG_BLOCK, &mask, NULL) != 0) {
+        return -1;
+    }
+
+    g_event.signal_fd = signalfd(-1, &mask, SFD_CLOEXEC);
+    if (g_event.signal_fd < 0) {
+        perror("创建signalfd失败");
+        return -1;
+    }
+
+    g_event.timer_fd = timerfd_create(CLOCK_REALTIME, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (g_event.timer_fd < 0) {
+        perror("创建timerfd失败");
+        close(g_event.signal_fd);
+        g_event.signal_fd = -1;
+        return -1;
+    }
+
+    g_event.day_fd = timerfd_create(CLOCK_REALTIME, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (g_event.day_fd < 0) {
+        perror("创建timerfd失败");
+        close(g_event.timer_fd);
+        close(g_event.signal_fd);
+        g_event.timer_fd = -1;
+        g_event.signal_fd = -1;
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief 关闭事件循环
+ */
+void event_loop_shutdown(void) {
+    if (g_event.timer_fd >= 0) close(g_event.timer_fd);
+    if (g_event.signal_fd >= 0) close(g_event.signal_fd);
+    if (g_event.day_fd >= 0) close(g_event.day_fd);
+
+    g_event.timer_fd = -1;
+    g_event.signal_fd = -1;
+    g_event.day_fd = -1;
+    g_event.armed_at = 0;
+    g_event.armed_day = 0;
+}
+
+/**
+ * @brief 计算下一次提醒的到期时间
+ * @return 暂停时返回0
+ */
+static time_t next_reminder_time(const AppState *app) {
+    if (app->paused || g_event.first_check == 0) return 0;
+
+    if (app->last_reminder == 0) {
+        return g_event.first_check;
+    }
+
+    return app->last_reminder + (time_t)app->config.reminder_interval * 60;
+}
+
+/**
+ * @brief 按当前状态重新设置提醒定时器
+ * @description 到期时间未变化时不做系统调用；使用绝对时间并在系统时间被修改时取消，
+ *              保证睡眠时间始终对应墙上时间的到期时刻
+ */
+static void reminder_rearm(void) {
+    time_t due = next_reminder_time(g_event.app);
+    if (due == g_event.armed_at) return;
+
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    spec.it_value.tv_sec = due;
+
+    if (timerfd_settime(g_event.timer_fd, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET,
+                        &spec, NULL) == 0) {
+        g_event.armed_at = due;
+    }
+}
+
+/**
+ * @brief 按今日统计的天号设置零点定时器，到期时间为次日本地零点
+ * @description 天号未变化时不做任何计算；系统时间被修改时同样会唤醒并重新检查
+ */
+static void day_rearm(void) {
+    int today = g_event.app->today_day;
+    if (today == g_event.armed_day) return;
+
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    spec.it_value.tv_sec = day_start_time(today + 1);
+
+    if (timerfd_settime(g_event.day_fd, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET,
+                        &spec, NULL) == 0) {
+        g_event.armed_day = today;
+    }
+}
+
+/**
+ * @brief 设置提醒定时器
+ * @description 与之前每分钟检查一次的行为保持一致，从未提醒过时在一分钟后首次提醒
+ */
+void setup_reminder_timer(AppState *app) {
+    if (!app) return;
+
+    g_event.app = app;
+    g_event.first_check = time(NULL) + 60;
+    reminder_rearm();
+}
+
+/**
+ * @brief 处理提醒定时器到期
+ */
+static void handle_reminder_timer(void) {
+    uint64_t expirations;
+    ssize_t n = read(g_event.timer_fd, &expirations, sizeof(expirations));
+
+    // 系统时间被修改（ECANCELED）时只需按新的时间重新设置
+    g_event.armed_at = 0;
+    if (n < 0 && errno != ECANCELED) {
+        return;
+    }
+
+    AppState *app = g_event.app;
+    if (should_remind(app)) {
+        METRIC_DELAY(METRIC_REMINDER_JITTER, next_reminder_time(app));
+        if (app->headless) {
+            // 守护进程没有界面，只记录日志并播放音效
+            log_message("发送喝水提醒");
+            if (app->config.sound_enabled) {
+                play_sound_effect();
+            }
+        } else {
+            show_reminder_notification(app);
+            render_present();
+        }
+        app->last_reminder = time(NULL);
+    }
+}
+
+/**
+ * @brief 处理零点定时器到期：切换事件循环所服务的用户和所有已加载分片的今日统计
+ */
+static void handle_day_timer(void) {
+    uint64_t expirations;
+    ssize_t n = read(g_event.day_fd, &expirations, sizeof(expirations));
+
+    g_event.armed_day = 0;
+    if (n < 0 && errno != ECANCELED) {
+        return;
+    }
+
+    int today = today_day_number();
+    today_stats_rollover(g_event.app, today);
+    shard_day_rollover(today);
+}
+
+/**
+ * @brief 处理退出信号
+ */
+static void handle_exit_signal(void) {
+    struct signalfd_siginfo info;
+    if (read(g_event.signal_fd, &info, sizeof(info)) != (ssize_t)sizeof(info)) {
+        return;
+    }
+
+    signal_handler((int)info.ssi_signo);
+}
+
+/**
+ * @brief 请求退出程序（例如标准输入已关闭）
+ */
+void event_request_shutdown(void) {
+    signal_handler(SIGTERM);
+}
+
+/**
+ * @brief 准备事件循环自身需要监听的描述符（提醒定时器、退出信号和零点定时器）
+ * @return 填入 fds 的描述符个数 EVENT_POLL_FDS
+ */
+int event_poll_prepare(struct pollfd *fds) {
+    if (g_event.app) {
+        reminder_rearm();
+        day_rearm();
+    }
+
+    fds[0].fd = g_event.timer_fd;
+    fds[0].events = POLLIN;
+    fds[0].revents = 0;
+    fds[1].fd = g_event.signal_fd;
+    fds[1].events = POLLIN;
+    fds[1].revents = 0;
+    fds[2].fd = g_event.day_fd;
+    fds[2].events = POLLIN;
+    fds[2].revents = 0;
+    return EVENT_POLL_FDS;
+}
+
+/**
+ * @brief 处理 event_poll_prepare 准备的描述符上发生的事件
+ */
+void event_poll_dispatch(const struct pollfd *fds) {
+    if (fds[1].revents & POLLIN) {
+        handle_exit_signal();
+    }
+    if (fds[2].revents & POLLIN) {
+        handle_day_timer();
+    }
+    if (fds[0].revents & POLLIN) {
+        handle_reminder_timer();
+    }
+    animation_tick();
+}
+
+/**
+ * @brief 等待指定描述符可读，期间在主线程中处理提醒和退出信号
+ * @return 可读时返回0，出错返回-1
+ */
+int event_wait_readable(int fd) {
+    for (;;) {
+        struct pollfd fds[EVENT_POLL_FDS + 1];
+        int count = event_poll_prepare(fds);
+        fds[count].fd = fd;
+        fds[count].events = POLLIN;
+        fds[count].revents = 0;
+
+        // 有动画正在播放时只等到下一帧到期
+        int ready = poll(fds, count + 1, animation_next_timeout());
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+
+        event_poll_dispatch(fds);
+        if (fds[count].revents & (POLLIN | POLLHUP | POLLERR)) {
+            return 0;
+        }
+    }
+}
@@ -0,0 +1,332 @@
+/**
+ * @file journal.c
+ * @brief 喝水提醒终端应用 - 数据日志写入模块
+ * @author zcg
+ * @date 2024
+ * @description 数据文件本身就是只追加的预写日志：每个用户的日志文件保持打开，
+ *              新记录直接 write 追加。按用户配置的持久性级别决定何时 fsync：
+ *              不刷盘、组提交（提交窗口内的所有写入由后台线程用一次 fdatasync 提交）
+ *              或逐条刷盘。组提交模式下调用方从不等待磁盘
+ */
+
+#include "water_reminder.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+/**
+ * @brief 组提交线程状态
+ */
+static struct {
+    Journal *head;                 // 已打开的日志链表
+    int running;                   // 提交线程是否运行
+    int started;                   // 提交线程是否已启动
+    pthread_t thread;              // 后台提交线程
+    pthread_mutex_t lock;          // 保护链表和各日志的提交状态
+    pthread_cond_t wake;           // 有新的待提交写入（单调时钟）
+    pthread_cond_t idle;           // 一次提交完成
+} g_journal = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .idle = PTHREAD_COND_INITIALIZER
+};
+
+/**
+ * @brief 获取单调时钟的当前毫秒数
+ */
+static long long monotonic_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/**
+ * @brief 完整写出数据
+ */
+static int write_full(int fd, const void *data, size_t length) {
+    const char *p = data;
+    while (length > 0) {
+        ssize_t n = write(fd, p, length);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += n;
+        length -= (size_t)n;
+    }
+    return 0;
+}
+
+/**
+ * @brief 将日志内容提交到磁盘并记录耗时
+ */
+static int journal_fdatasync(int fd) {
+    METRIC_START(start);
+    int ret = fdatasync(fd);
+    METRIC_END(METRIC_JOURNAL_SYNC, start);
+    return ret;
+}
+
+/* ==================== 组提交线程 ==================== */
+
+/**
+ * @brief 后台提交线程：每个日志的第一条未提交写入到达提交窗口后执行一次 fdatasync，
+ *        窗口内的后续写入都由这一次提交覆盖
+ */
+static void *commit_thread_main(void *arg) {
+    (void)arg;
+
+    pthread_mutex_lock(&g_journal.lock);
+    while (g_journal.running) {
+        long long now = monotonic_ms();
+        long long earliest = -1;
+        Journal *due = NULL;
+
+        for (Journal *journal = g_journal.head; journal; journal = journal->next) {
+            if (!journal->dirty || journal->syncing) continue;
+            if (journal->deadline <= now) {
+                due = journal;
+                break;
+            }
+            if (earliest < 0 || journal->deadline < earliest) {
+                earliest = journal->deadline;
+            }
+        }
+
+        if (due) {
+            // 提交期间不持有锁，新的写入会重新标记为待提交
+            due->dirty = 0;
+            due->syncing = 1;
+            int fd = due->fd;
+            pthread_mutex_unlock(&g_journal.lock);
+            journal_fdatasync(fd);
+            pthread_mutex_lock(&g_journal.lock);
+            due->syncing = 0;
+            pthread_cond_broadcast(&g_journal.idle);
+        } else if (earliest < 0) {
+            pthread_cond_wait(&g_journal.wake, &g_journal.lock);
+        } else {
+            struct timespec deadline;
+            deadline.tv_sec = (time_t)(earliest / 1000);
+            deadline.tv_nsec = (long)(earliest % 1000) * 1000000;
+            pthread_cond_timedwait(&g_journal.wake, &g_journal.lock, &deadline);
+        }
+    }
+    pthread_mutex_unlock(&g_journal.lock);
+
+    return NULL;
+}
+
+/**
+ * @brief 启动组提交线程（调用方持有锁）
+ */
+static int commit_thread_start(void) {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&g_journal.wake, &attr);
+    pthread_condattr_destroy(&attr);
+
+    g_journal.running = 1;
+
+    // 后台线程屏蔽所有信号，信号始终由主线程的事件循环处理
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    int ret = pthread_create(&g_journal.thread, NULL, commit_thread_main, NULL);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    if (ret != 0) {
+        g_journal.running = 0;
+        pthread_cond_destroy(&g_journal.wake);
+        return -1;
+    }
+
+    g_journal.started = 1;
+    return 0;
+}
+
+/**
+ * @brief 停止组提交线程
+ * @description 调用前应先关闭所有日志，关闭时会同步提交尚未提交的写入
+ */
+void journal_shutdown(void) {
+    pthread_mutex_lock(&g_journal.lock);
+    if (!g_journal.started) {
+        pthread_mutex_unlock(&g_journal.lock);
+        return;
+    }
+    g_journal.running = 0;
+    pthread_cond_signal(&g_journal.wake);
+    pthread_mutex_unlock(&g_journal.lock);
+
+    pthread_join(g_journal.thread, NULL);
+    pthread_cond_destroy(&g_journal.wake);
+    g_journal.started = 0;
+}
+
+/* ==================== 日志读写函数 ==================== */
+
+/**
+ * @brief 初始化日志状态（不打开文件）
+ */
+void journal_init(Journal *journal) {
+    if (!journal) return;
+
+    memset(journal, 0, sizeof(Journal));
+    journal->fd = -1;
+}
+
+/**
+ * @brief 打开数据日志并加入组提交链表，空文件先写入文件头
+ */
+static int journal_open(AppState *app) {
+    Journal *journal = &app->journal;
+
+    int fd = open(app->data_path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        perror("打开数据日志失败");
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size == 0) {
+        RecordFileHeader header;
+        record_header_init(&header, 0);
+        if (write_full(fd, &header, sizeof(header)) != 0) {
+            perror("写入数据文件头失败");
+            close(fd);
+            return -1;
+        }
+    }
+
+    pthread_mutex_lock(&g_journal.lock);
+    if (!g_journal.started && commit_thread_start() != 0) {
+        // 没有提交线程时组提交退化为关闭时统一提交
+        log_message("组提交线程启动失败");
+    }
+    journal->fd = fd;
+    journal->dirty = 0;
+    journal->syncing = 0;
+    journal->next = g_journal.head;
+    g_journal.head = journal;
+    pthread_mutex_unlock(&g_journal.lock);
+    return 0;
+}
+
+/**
+ * @brief 追加记录到用户的数据日志
+ * @description 记录总是一次 write 写入内核；之后按 app->config.durability：
+ *              逐条刷盘时立即 fdatasync，组提交时登记提交期限后立即返回
+ */
+int journal_append(AppState *app, const WaterRecord *records, int count) {
+    if (!app || !records || count <= 0) return -1;
+
+    Journal *journal = &app->journal;
+    if (journal->fd < 0 && journal_open(app) != 0) {
+        return -1;
+    }
+
+    if (write_full(journal->fd, records, (size_t)count * sizeof(WaterRecord)) != 0) {
+        perror("追加数据日志失败");
+        return -1;
+    }
+
+    switch (app->config.durability) {
+        case DURABILITY_NONE:
+            return 0;
+        case DURABILITY_RECORD:
+            return journal_fdatasync(journal->fd) == 0 ? 0 : -1;
+        default: {
+            int window = app->config.commit_window_ms;
+            if (window < 0) window = 0;
+            if (window > JOURNAL_WINDOW_MAX) window = JOURNAL_WINDOW_MAX;
+
+            pthread_mutex_lock(&g_journal.lock);
+            if (!journal->dirty) {
+                journal->dirty = 1;
+                journal->deadline = monotonic_ms() + window;
+                pthread_cond_signal(&g_journal.wake);
+            }
+            pthread_mutex_unlock(&g_journal.lock);
+            return 0;
+        }
+    }
+}
+
+/**
+ * @brief 立即提交日志中尚未提交的写入
+ */
+int journal_sync(Journal *journal) {
+    if (!journal || journal->fd < 0) return 0;
+
+    pthread_mutex_lock(&g_journal.lock);
+    while (journal->syncing) {
+        pthread_cond_wait(&g_journal.idle, &g_journal.lock);
+    }
+    int pending = journal->dirty;
+    journal->dirty = 0;
+    journal->syncing = pending;
+    pthread_mutex_unlock(&g_journal.lock);
+
+    if (!pending) return 0;
+
+    int ret = journal_fdatasync(journal->fd);
+
+    pthread_mutex_lock(&g_journal.lock);
+    journal->syncing = 0;
+    pthread_cond_broadcast(&g_journal.idle);
+    pthread_mutex_unlock(&g_journal.lock);
+    return ret == 0 ? 0 : -1;
+}
+
+/**
+ * @brief 提交尚未提交的写入并关闭日志
+ * @description 数据文件被整体重写（重命名替换）之前必须先关闭，之后的追加会重新打开新文件
+ */
+void journal_close(Journal *journal) {
+    if (!journal || journal->fd < 0) return;
+
+    journal_sync(journal);
+
+    pthread_mutex_lock(&g_journal.lock);
+    while (journal->syncing) {
+        pthread_cond_wait(&g_journal.idle, &g_journal.lock);
+    }
+    Journal **link = &g_journal.head;
+    while (*link && *link != journal) {
+        link = &(*link)->next;
+    }
+    if (*link) {
+        *link = journal->next;
+    }
+    pthread_mutex_unlock(&g_journal.lock);
+
+    close(journal->fd);
+    journal->fd = -1;
+    journal->next = NULL;
+}
+
+/* ==================== 持久性级别 ==================== */
+
+/**
+ * @brief 持久性级别的名称（配置和守护进程协议中使用）
+ */
+const char *durability_name(int durability) {
+    switch (durability) {
+        case DURABILITY_NONE: return "none";
+        case DURABILITY_RECORD: return "record";
+        default: return "batched";
+    }
+}
+
+/**
+ * @brief 解析持久性级别名称
+ * @return 无效名称返回-1
+ */
+int durability_parse(const char *name) {
+    if (!name) return -1;
+    if (strcmp(name, "none") == 0) return DURABILITY_NONE;
+    if (strcmp(name, "batched") == 0) return DURABILITY_BATCHED;
+    if (strcmp(name, "record") == 0) return DURABILITY_RECORD;
+    return -1;
+}
@@ -0,0 +1,307 @@
+/**
+ * @file logger.c
+ * @brief 喝水提醒终端应用 - 日志模块
+ * @author zcg
+ * @date 2024
+ * @description 缓冲式异步日志：日志文件保持打开，消息先写入内存环形缓冲区，
+ *              由后台线程批量写盘，文件超过上限时按大小轮转
+ */
+
+#include "water_reminder.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/uio.h>
+
+/**
+ * @brief 日志模块状态
+ */
+static struct {
+    int fd;                        // 日志文件描述符
+    off_t file_size;               // 当前日志文件大小
+    char *ring;                    // 环形缓冲区
+    size_t head;                   // 已写入的总字节数
+    size_t tail;                   // 已落盘的总字节数
+    time_t cached_second;          // 缓存的时间戳对应的秒
+    char cached_time[32];          // 缓存的格式化时间
+    int running;                   // 后台线程是否运行
+    int initialized;               // 是否已初始化
+    int write_failed;              // 写盘失败已在标准错误上报告过（恢复写入前不再重复）
+    pthread_t thread;              // 后台写盘线程
+    pthread_mutex_t lock;          // 保护缓冲区和状态
+    pthread_mutex_t flush_lock;    // 保证同一时间只有一个写盘者
+    pthread_cond_t wake;           // 唤醒后台线程
+} g_logger = {
+    .fd = -1,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .flush_lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER
+};
+
+/**
+ * @brief 日志文件超过上限时轮转为 LOG_FILE ".1"
+ */
+static void logger_rotate(void) {
+    close(g_logger.fd);
+    rename(LOG_FILE, LOG_FILE ".1");
+
+    g_logger.fd = open(LOG_FILE, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    g_logger.file_size = 0;
+}
+
+/**
+ * @brief 将环形缓冲区中 [from, to) 的内容写入日志文件
+ * @return 实际写入的字节数，出错时返回-1
+ */
+static ssize_t logger_write_range(size_t from, size_t to) {
+    // 环形缓冲区中的数据最多分成两段，一次 writev 写出
+    size_t start = from % LOG_BUFFER_SIZE;
+    size_t length = to - from;
+    struct iovec iov[2];
+    int iov_count = 1;
+
+    iov[0].iov_base = g_logger.ring + start;
+    iov[0].iov_len = length;
+    if (start + length > LOG_BUFFER_SIZE) {
+        iov[0].iov_len = LOG_BUFFER_SIZE - start;
+        iov[1].iov_base = g_logger.ring;
+        iov[1].iov_len = length - iov[0].iov_len;
+        iov_count = 2;
+    }
+
+    ssize_t written;
+    do {
+        written = writev(g_logger.fd, iov, iov_count);
+    } while (written < 0 && errno == EINTR);
+    return written;
+}
+
+/**
+ * @brief 将缓冲区中尚未落盘的内容写入日志文件
+ * @description 写盘期间不持有缓冲区锁，生产者只会写入 [tail, head) 之外的空间；
+ *              部分写入时继续写剩余部分，每写出一段就释放对应的缓冲区空间
+ */
+static void logger_flush_pending(void) {
+    pthread_mutex_lock(&g_logger.flush_lock);
+
+    pthread_mutex_lock(&g_logger.lock);
+    size_t tail = g_logger.tail;
+    size_t head = g_logger.head;
+    pthread_mutex_unlock(&g_logger.lock);
+
+    if (head != tail) {
+        METRIC_START(flush_start);
+        if (g_logger.fd >= 0 && g_logger.file_size + (off_t)(head - tail) > LOG_MAX_SIZE) {
+            logger_rotate();
+        }
+
+        // 上次轮转时重新打开失败，再试一次
+        if (g_logger.fd < 0) {
+            g_logger.fd = open(LOG_FILE, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+            struct stat st;
+            g_logger.file_size = g_logger.fd >= 0 && fstat(g_logger.fd, &st) == 0 ? st.st_size : 0;
+        }
+
+        int error = g_logger.fd >= 0 ? 0 : errno;
+        while (tail != head && error == 0) {
+            ssize_t written = logger_write_range(tail, head);
+            if (written <= 0) {
+                error = written < 0 ? errno : EIO;
+                break;
+            }
+
+            tail += (size_t)written;
+            g_logger.file_size += written;
+            g_logger.write_failed = 0;
+            pthread_mutex_lock(&g_logger.lock);
+            g_logger.tail = tail;
+            pthread_mutex_unlock(&g_logger.lock);
+        }
+
+        // 无法写盘（磁盘已满、I/O错误等）时只能丢弃剩余内容，否则生产者会一直等待缓冲区空间
+        if (tail != head) {
+            if (!g_logger.write_failed) {
+                fprintf(stderr, "写入日志文件失败，丢弃 %zu 字节日志: %s\n",
+                        head - tail, strerror(error));
+                g_logger.write_failed = 1;
+            }
+            pthread_mutex_lock(&g_logger.lock);
+            g_logger.tail = head;
+            pthread_mutex_unlock(&g_logger.lock);
+        }
+        METRIC_END(METRIC_LOG_FLUSH, flush_start);
+    }
+
+    pthread_mutex_unlock(&g_logger.flush_lock);
+}
+
+/**
+ * @brief 后台写盘线程：定时或缓冲区过半时批量写盘
+ */
+static void *logger_thread_main(void *arg) {
+    (void)arg;
+
+    pthread_mutex_lock(&g_logger.lock);
+    while (g_logger.running) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += LOG_FLUSH_INTERVAL;
+
+        if (g_logger.head - g_logger.tail < LOG_BUFFER_SIZE / 2) {
+            pthread_cond_timedwait(&g_logger.wake, &g_logger.lock, &deadline);
+        }
+
+        if (g_logger.head != g_logger.tail) {
+            pthread_mutex_unlock(&g_logger.lock);
+            logger_flush_pending();
+            pthread_mutex_lock(&g_logger.lock);
+        }
+    }
+    pthread_mutex_unlock(&g_logger.lock);
+
+    return NULL;
+}
+
+/**
+ * @brief 初始化日志模块并启动后台写盘线程
+ */
+int logger_init(void) {
+    if (g_logger.initialized) return 0;
+
+    g_logger.ring = malloc(LOG_BUFFER_SIZE);
+    if (!g_logger.ring) return -1;
+
+    g_logger.fd = open(LOG_FILE, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if (g_logger.fd < 0) {
+        free(g_logger.ring);
+        g_logger.ring = NULL;
+        return -1;
+    }
+
+    struct stat st;
+    g_logger.file_size = fstat(g_logger.fd, &st) == 0 ? st.st_size : 0;
+    g_logger.head = 0;
+    g_logger.tail = 0;
+    g_logger.cached_second = (time_t)-1;
+    g_logger.running = 1;
+
+    // 后台线程屏蔽所有信号，信号始终由主线程的事件循环处理
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    int ret = pthread_create(&g_logger.thread, NULL, logger_thread_main, NULL);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    if (ret != 0) {
+        close(g_logger.fd);
+        g_logger.fd = -1;
+        free(g_logger.ring);
+        g_logger.ring = NULL;
+        g_logger.running = 0;
+        return -1;
+    }
+
+    g_logger.initialized = 1;
+    return 0;
+}
+
+/**
+ * @brief 立即将缓冲区中的日志写盘
+ */
+void logger_flush(void) {
+    if (!g_logger.initialized) return;
+    logger_flush_pending();
+}
+
+/**
+ * @brief 停止后台线程，写出剩余日志并关闭日志文件
+ */
+void logger_shutdown(void) {
+    if (!g_logger.initialized) return;
+
+    pthread_mutex_lock(&g_logger.lock);
+    g_logger.running = 0;
+    pthread_cond_signal(&g_logger.wake);
+    pthread_mutex_unlock(&g_logger.lock);
+    pthread_join(g_logger.thread, NULL);
+
+    logger_flush_pending();
+    close(g_logger.fd);
+    g_logger.fd = -1;
+    free(g_logger.ring);
+    g_logger.ring = NULL;
+    g_logger.initialized = 0;
+}
+
+/**
+ * @brief 日志模块未初始化时直接追加写入日志文件
+ */
+static void log_message_direct(const char *message) {
+    FILE *log_file = fopen(LOG_FILE, "a");
+    if (!log_file) return;
+
+    time_t now = time(NULL);
+    char time_str[32];
+    struct tm tm_info;
+    localtime_r(&now, &tm_info);
+    strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", &tm_info);
+
+    fprintf(log_file, "[%s] %s\n", time_str, message);
+    fclose(log_file);
+}
+
+/**
+ * @brief 记录日志消息
+ * @description 只把格式化后的消息复制进环形缓冲区；同一秒内的消息复用已格式化的时间
+ */
+void log_message(const char *message) {
+    if (!message) return;
+
+    if (!g_logger.initialized) {
+        log_message_direct(message);
+        return;
+    }
+
+    METRIC_START(write_start);
+    char line[LOG_LINE_MAX];
+    time_t now = time(NULL);
+
+    pthread_mutex_lock(&g_logger.lock);
+    if (now != g_logger.cached_second) {
+        struct tm tm_info;
+        localtime_r(&now, &tm_info);
+        strftime(g_logger.cached_time, sizeof(g_logger.cached_time),
+                 "%Y-%m-%d %H:%M:%S", &tm_info);
+        g_logger.cached_second = now;
+    }
+
+    int length = snprintf(line, sizeof(line), "[%s] %s\n", g_logger.cached_time, message);
+    if (length < 0) {
+        length = 0;
+    } else if (length >= (int)sizeof(line)) {
+        length = sizeof(line) - 1;
+        line[length - 1] = '\n';
+    }
+
+    // 缓冲区放不下时由调用方同步写盘腾出空间
+    while (LOG_BUFFER_SIZE - (g_logger.head - g_logger.tail) < (size_t)length) {
+        pthread_mutex_unlock(&g_logger.lock);
+        logger_flush_pending();
+        pthread_mutex_lock(&g_logger.lock);
+    }
+
+    size_t start = g_logger.head % LOG_BUFFER_SIZE;
+    size_t first = (size_t)length;
+    if (start + first > LOG_BUFFER_SIZE) {
+        first = LOG_BUFFER_SIZE - start;
+    }
+    memcpy(g_logger.ring + start, line, first);
+    memcpy(g_logger.ring, line + first, length - first);
+    g_logger.head += length;
+
+    if (g_logger.head - g_logger.tail >= LOG_BUFFER_SIZE / 2) {
+        pthread_cond_signal(&g_logger.wake);
+    }
+    pthread_mutex_unlock(&g_logger.lock);
+    METRIC_END(METRIC_LOG_WRITE, write_start);
+}
@@ -13,13 +13,19 @@ AppState g_app;
 
 /**
  * @brief 信号处理函数 - 优雅退出
+ * @description 信号经 signalfd 在事件循环中同步投递，这里运行在主线程的普通上下文
  */
 void signal_handler(int sig) {
     if (sig == SIGINT || sig == SIGTERM) {
-        printf("\n%s感谢使用喝水提醒应用！保持健康！%s\n", 
-               COLOR_GREEN, COLOR_RESET);
+        if (g_app.headless) {
+            daemon_shutdown();
+        } else {
+            ui_printf("\n%s感谢使用喝水提醒应用！保持健康！%s\n", 
+                   COLOR_GREEN, COLOR_RESET);
+        }
         g_app.is_running = 0;
         cleanup_app(&g_app);
+        render_present();
         exit(0);
     }
 }
@@ -33,18 +39,18 @@ void handle_add_water(AppState *app) {
     clear_screen();
     show_banner();
     
-    printf("%s╭─────────────────────────────────────╮%s\n", COLOR_CYAN, COLOR_RESET);
-    printf("%s│           添加喝水记录              │%s\n", COLOR_CYAN, COLOR_RESET);
-    printf("%s╰─────────────────────────────────────╯%s\n", COLOR_CYAN, COLOR_RESET);
-    printf("\n");
+    ui_printf("%s╭─────────────────────────────────────╮%s\n", COLOR_CYAN, COLOR_RESET);
+    ui_printf("%s│           添加喝水记录              │%s\n", COLOR_CYAN, COLOR_RESET);
+    ui_printf("%s╰─────────────────────────────────────╯%s\n", COLOR_CYAN, COLOR_RESET);
+    ui_printf("\n");
     
-    printf("%s请选择喝水量：%s\n", COLOR_YELLOW, COLOR_RESET);
-    printf("  1. 小杯 (150ml)\n");
-    printf("  2. 中杯 (250ml) %s[默认]%s\n", COLOR_DIM, COLOR_RESET);
-    printf("  3. 大杯 (350ml)\n");
-    printf("  4. 自定义\n");
-    printf("  0. 返回主菜单\n");
-    printf("\n%s请输入选择: %s", COLOR_BOLD, COLOR_RESET);
+    ui_printf("%s请选择喝水量：%s\n", COLOR_YELLOW, COLOR_RESET);
+    ui_printf("  1. 小杯 (150ml)\n");
+    ui_printf("  2. 中杯 (250ml) %s[默认]%s\n", COLOR_DIM, COLOR_RESET);
+    ui_printf("  3. 大杯 (350ml)\n");
+    ui_printf("  4. 自定义\n");
+    ui_printf("  0. 返回主菜单\n");
+    ui_printf("\n%s请输入选择: %s", COLOR_BOLD, COLOR_RESET);
     
     int choice = get_user_choice();
     
@@ -53,37 +59,36 @@ void handle_add_water(AppState *app) {
         case 2: amount = 250; break;
         case 3: amount = 350; break;
         case 4:
-            printf("请输入喝水量(ml): ");
-            scanf("%d", &amount);
-            if (amount <= 0 || amount > 2000) {
-                printf("%s❌ 无效的喝水量！%s\n", COLOR_RED, COLOR_RESET);
-                sleep(2);
+            ui_printf("请输入喝水量(ml): ");
+            amount = get_number_input();
+            if (!water_amount_valid(amount)) {
+                ui_printf("%s❌ 无效的喝水量！%s\n", COLOR_RED, COLOR_RESET);
+                ui_sleep(2);
                 return;
             }
             break;
         case 0: return;
         default:
-            printf("%s❌ 无效选择！%s\n", COLOR_RED, COLOR_RESET);
-            sleep(2);
+            ui_printf("%s❌ 无效选择！%s\n", COLOR_RED, COLOR_RESET);
+            ui_sleep(2);
             return;
     }
     
     add_water_record(app, amount);
     
     // 显示添加成功动画
-    printf("\n%s✅ 成功记录喝水 %dml！%s\n", COLOR_GREEN, amount, COLOR_RESET);
-    show_water_animation();
+    ui_printf("\n%s✅ 成功记录喝水 %dml！%s\n", COLOR_GREEN, amount, COLOR_RESET);
+    show_water_animation(app);
     
     // 检查是否达到目标
     int daily_goal_ml = app->config.daily_goal * app->config.cup_size;
     if (app->today_amount >= daily_goal_ml) {
-        printf("\n%s%s 恭喜！您今天已经达到喝水目标！ %s%s\n", 
+        ui_printf("\n%s%s 恭喜！您今天已经达到喝水目标！ %s%s\n", 
                COLOR_BOLD, TROPHY_CHAR, TROPHY_CHAR, COLOR_RESET);
     }
     
-    printf("\n按任意键继续...");
-    getchar();
-    getchar();
+    ui_printf("\n按任意键继续...");
+    wait_for_enter();
 }
 
 /**
@@ -96,16 +101,17 @@ void handle_view_stats(const AppState *app) {
         clear_screen();
         show_banner();
         
-        printf("%s╭─────────────────────────────────────╮%s\n", COLOR_MAGENTA, COLOR_RESET);
-        printf("%s│             统计信息                │%s\n", COLOR_MAGENTA, COLOR_RESET);
-        printf("%s╰─────────────────────────────────────╯%s\n", COLOR_MAGENTA, COLOR_RESET);
-        printf("\n");
+        ui_printf("%s╭─────────────────────────────────────╮%s\n", COLOR_MAGENTA, COLOR_RESET);
+        ui_printf("%s│             统计信息                │%s\n", COLOR_MAGENTA, COLOR_RESET);
+        ui_printf("%s╰─────────────────────────────────────╯%s\n", COLOR_MAGENTA, COLOR_RESET);
+        ui_printf("\n");
         
-        printf("  1. %s今日统计%s\n", COLOR_GREEN, COLOR_RESET);
-        printf("  2. %s周统计%s\n", COLOR_YELLOW, COLOR_RESET);
-        printf("  3. %s月统计%s\n", COLOR_BLUE, COLOR_RESET);
-        printf("  0. %s返回主菜单%s\n", COLOR_WHITE, COLOR_RESET);
-        printf("\n%s请输入选择: %s", COLOR_BOLD, COLOR_RESET);
+        ui_printf("  1. %s今日统计%s\n", COLOR_GREEN, COLOR_RESET);
+        ui_printf("  2. %s周统计%s\n", COLOR_YELLOW, COLOR_RESET);
+        ui_printf("  3. %s月统计%s\n", COLOR_BLUE, COLOR_RESET);
+        ui_printf("  4. %s喝水热力图%s\n", COLOR_CYAN, COLOR_RESET);
+        ui_printf("  0. %s返回主菜单%s\n", COLOR_WHITE, COLOR_RESET);
+        ui_printf("\n%s请输入选择: %s", COLOR_BOLD, COLOR_RESET);
         
         choice = get_user_choice();
         
@@ -113,30 +119,52 @@ void handle_view_stats(const AppState *app) {
             case 1:
                 clear_screen();
                 show_stats_dashboard(app);
-                printf("\n按任意键继续...");
-                getchar(); getchar();
+                ui_printf("\n按任意键继续...");
+                wait_for_enter();
                 break;
             case 2:
                 clear_screen();
                 show_weekly_stats(app);
-                printf("\n按任意键继续...");
-                getchar(); getchar();
+                ui_printf("\n按任意键继续...");
+                wait_for_enter();
                 break;
             case 3:
                 clear_screen();
                 show_monthly_stats(app);
-                printf("\n按任意键继续...");
-                getchar(); getchar();
+                ui_printf("\n按任意键继续...");
+                wait_for_enter();
+                break;
+            case 4: {
+                ui_printf("请输入统计的最近天数(直接回车为%d天): ", HEATMAP_DEFAULT_DAYS);
+                int days = get_number_input();
+                if (days <= 0) days = HEATMAP_DEFAULT_DAYS;
+                if (days > HEATMAP_MAX_DAYS) days = HEATMAP_MAX_DAYS;
+                clear_screen();
+                show_intake_heatmap(app, days);
+                ui_printf("\n按任意键继续...");
+                wait_for_enter();
                 break;
+            }
             case 0:
                 return;
             default:
-                printf("%s❌ 无效选择！%s\n", COLOR_RED, COLOR_RESET);
-                sleep(2);
+                ui_printf("%s❌ 无效选择！%s\n", COLOR_RED, COLOR_RESET);
+                ui_sleep(2);
         }
     }
 }
 
+/**
+ * @brief 持久性级别的显示名称
+ */
+static const char *durability_label(int durability) {
+    switch (durability) {
+        case DURABILITY_NONE: return "不刷盘";
+        case DURABILITY_RECORD: return "逐条刷盘";
+        default: return "组提交";
+    }
+}
+
 /**
  * @brief 处理设置的菜单选项
  */
@@ -147,80 +175,137 @@ void handle_settings(AppState *app) {
         clear_screen();
         show_banner();
         
-        printf("%s╭─────────────────────────────────────╮%s\n", COLOR_BLUE, COLOR_RESET);
-        printf("%s│               设置                  │%s\n", COLOR_BLUE, COLOR_RESET);
-        printf("%s╰─────────────────────────────────────╯%s\n", COLOR_BLUE, COLOR_RESET);
-        printf("\n");
+        ui_printf("%s╭─────────────────────────────────────╮%s\n", COLOR_BLUE, COLOR_RESET);
+        ui_printf("%s│               设置                  │%s\n", COLOR_BLUE, COLOR_RESET);
+        ui_printf("%s╰─────────────────────────────────────╯%s\n", COLOR_BLUE, COLOR_RESET);
+        ui_printf("\n");
         
-        printf("  1. 修改提醒间隔 %s(当前: %d分钟)%s\n", 
+        ui_printf("  1. 修改提醒间隔 %s(当前: %d分钟)%s\n", 
                COLOR_DIM, app->config.reminder_interval, COLOR_RESET);
-        printf("  2. 修改每日目标 %s(当前: %d杯)%s\n", 
+        ui_printf("  2. 修改每日目标 %s(当前: %d杯)%s\n", 
                COLOR_DIM, app->config.daily_goal, COLOR_RESET);
-        printf("  3. 修改杯子容量 %s(当前: %dml)%s\n", 
+        ui_printf("  3. 修改杯子容量 %s(当前: %dml)%s\n", 
                COLOR_DIM, app->config.cup_size, COLOR_RESET);
-        printf("  4. 声音提醒 %s(当前: %s)%s\n", 
+        ui_printf("  4. 声音提醒 %s(当前: %s)%s\n", 
                COLOR_DIM, app->config.sound_enabled ? "开启" : "关闭", COLOR_RESET);
-        printf("  5. 重新设置用户信息\n");
-        printf("  0. 返回主菜单\n");
-        printf("\n%s请输入选择: %s", COLOR_BOLD, COLOR_RESET);
+        ui_printf("  5. 重新设置用户信息\n");
+        ui_printf("  6. 动画效果 %s(当前: %s)%s\n", 
+               COLOR_DIM, app->config.animations_enabled ? "开启" : "关闭", COLOR_RESET);
+        ui_printf("  7. 记录写入持久性 %s(当前: %s)%s\n", 
+               COLOR_DIM, durability_label(app->config.durability), COLOR_RESET);
+        ui_printf("  8. 修改组提交窗口 %s(当前: %d毫秒)%s\n", 
+               COLOR_DIM, app->config.commit_window_ms, COLOR_RESET);
+        if (app->config.retention_days > 0) {
+            ui_printf("  9. 原始记录保留天数 %s(当前: %d天)%s\n", 
+                   COLOR_DIM, app->config.retention_days, COLOR_RESET);
+        } else {
+            ui_printf("  9. 原始记录保留天数 %s(当前: 全部保留)%s\n", COLOR_DIM, COLOR_RESET);
+        }
+        ui_printf("  0. 返回主菜单\n");
+        ui_printf("\n%s请输入选择: %s", COLOR_BOLD, COLOR_RESET);
         
         choice = get_user_choice();
         
         switch (choice) {
             case 1:
-                printf("请输入新的提醒间隔(分钟): ");
-                scanf("%d", &app->config.reminder_interval);
+                ui_printf("请输入新的提醒间隔(分钟): ");
+                app->config.reminder_interval = get_number_input();
                 if (app->config.reminder_interval < 5 || app->config.reminder_interval > 300) {
-                    printf("%s❌ 间隔应在5-300分钟之间！%s\n", COLOR_RED, COLOR_RESET);
+                    ui_printf("%s❌ 间隔应在5-300分钟之间！%s\n", COLOR_RED, COLOR_RESET);
                     app->config.reminder_interval = DEFAULT_REMINDER_INTERVAL;
                 } else {
-                    printf("%s✅ 提醒间隔已更新！%s\n", COLOR_GREEN, COLOR_RESET);
-                    save_config(&app->config);
+                    ui_printf("%s✅ 提醒间隔已更新！%s\n", COLOR_GREEN, COLOR_RESET);
+                    save_config(&app->config, app->config_path);
                 }
-                sleep(2);
+                ui_sleep(2);
                 break;
             case 2:
-                printf("请输入每日目标杯数: ");
-                scanf("%d", &app->config.daily_goal);
+                ui_printf("请输入每日目标杯数: ");
+                app->config.daily_goal = get_number_input();
                 if (app->config.daily_goal < 1 || app->config.daily_goal > 20) {
-                    printf("%s❌ 目标应在1-20杯之间！%s\n", COLOR_RED, COLOR_RESET);
+                    ui_printf("%s❌ 目标应在1-20杯之间！%s\n", COLOR_RED, COLOR_RESET);
                     app->config.daily_goal = DEFAULT_DAILY_GOAL;
                 } else {
-                    printf("%s✅ 每日目标已更新！%s\n", COLOR_GREEN, COLOR_RESET);
-                    save_config(&app->config);
+                    ui_printf("%s✅ 每日目标已更新！%s\n", COLOR_GREEN, COLOR_RESET);
+                    save_config(&app->config, app->config_path);
                 }
-                sleep(2);
+                ui_sleep(2);
                 break;
             case 3:
-                printf("请输入杯子容量(ml): ");
-                scanf("%d", &app->config.cup_size);
+                ui_printf("请输入杯子容量(ml): ");
+                app->config.cup_size = get_number_input();
                 if (app->config.cup_size < 50 || app->config.cup_size > 1000) {
-                    printf("%s❌ 容量应在50-1000ml之间！%s\n", COLOR_RED, COLOR_RESET);
+                    ui_printf("%s❌ 容量应在50-1000ml之间！%s\n", COLOR_RED, COLOR_RESET);
                     app->config.cup_size = DEFAULT_CUP_SIZE;
                 } else {
-                    printf("%s✅ 杯子容量已更新！%s\n", COLOR_GREEN, COLOR_RESET);
-                    save_config(&app->config);
+                    ui_printf("%s✅ 杯子容量已更新！%s\n", COLOR_GREEN, COLOR_RESET);
+                    save_config(&app->config, app->config_path);
                 }
-                sleep(2);
+                ui_sleep(2);
                 break;
             case 4:
                 app->config.sound_enabled = !app->config.sound_enabled;
-                printf("%s✅ 声音提醒已%s！%s\n", 
+                ui_printf("%s✅ 声音提醒已%s！%s\n", 
                        COLOR_GREEN, 
                        app->config.sound_enabled ? "开启" : "关闭", 
                        COLOR_RESET);
-                save_config(&app->config);
-                sleep(2);
+                save_config(&app->config, app->config_path);
+                ui_sleep(2);
                 break;
             case 5:
                 setup_user_config(&app->config);
-                save_config(&app->config);
+                save_config(&app->config, app->config_path);
+                break;
+            case 6:
+                app->config.animations_enabled = !app->config.animations_enabled;
+                ui_printf("%s✅ 动画效果已%s！%s\n", 
+                       COLOR_GREEN, 
+                       app->config.animations_enabled ? "开启" : "关闭", 
+                       COLOR_RESET);
+                save_config(&app->config, app->config_path);
+                ui_sleep(2);
+                break;
+            case 7:
+                // 按 不刷盘 → 组提交 → 逐条刷盘 循环切换
+                app->config.durability = (app->config.durability + 1) % (DURABILITY_RECORD + 1);
+                ui_printf("%s✅ 记录写入持久性已切换为: %s%s\n", 
+                       COLOR_GREEN, durability_label(app->config.durability), COLOR_RESET);
+                save_config(&app->config, app->config_path);
+                ui_sleep(2);
+                break;
+            case 8: {
+                ui_printf("请输入组提交窗口(毫秒): ");
+                int window = get_number_input();
+                if (window < 0 || window > JOURNAL_WINDOW_MAX) {
+                    ui_printf("%s❌ 窗口应在0-%d毫秒之间！%s\n", COLOR_RED, JOURNAL_WINDOW_MAX, COLOR_RESET);
+                } else {
+                    app->config.commit_window_ms = window;
+                    ui_printf("%s✅ 组提交窗口已更新！%s\n", COLOR_GREEN, COLOR_RESET);
+                    save_config(&app->config, app->config_path);
+                }
+                ui_sleep(2);
+                break;
+            }
+            case 9: {
+                // 更早的记录在下次启动时折叠进汇总层，统计不受影响，但不再能导出逐条记录
+                ui_printf("请输入原始记录保留天数(0表示全部保留): ");
+                int days = get_number_input();
+                if (days != 0 && (days < ROLLUP_RETENTION_MIN || days > ROLLUP_RETENTION_MAX)) {
+                    ui_printf("%s❌ 保留天数应为0或%d-%d天！%s\n", 
+                           COLOR_RED, ROLLUP_RETENTION_MIN, ROLLUP_RETENTION_MAX, COLOR_RESET);
+                } else {
+                    app->config.retention_days = days;
+                    ui_printf("%s✅ 原始记录保留天数已更新，下次启动时生效！%s\n", COLOR_GREEN, COLOR_RESET);
+                    save_config(&app->config, app->config_path);
+                }
+                ui_sleep(2);
                 break;
+            }
             case 0:
                 return;
             default:
-                printf("%s❌ 无效选择！%s\n", COLOR_RED, COLOR_RESET);
-                sleep(2);
+                ui_printf("%s❌ 无效选择！%s\n", COLOR_RED, COLOR_RESET);
+                ui_sleep(2);
         }
     }
 }
@@ -251,49 +336,119 @@ void main_loop(AppState *app) {
                 break;
             case 4:
                 app->paused = !app->paused;
-                printf("%s%s 提醒已%s！%s\n", 
+                ui_printf("%s%s 提醒已%s！%s\n", 
                        COLOR_YELLOW, 
                        app->paused ? "⏸️" : "▶️",
                        app->paused ? "暂停" : "恢复", 
                        COLOR_RESET);
-                sleep(2);
+                ui_sleep(2);
                 break;
             case 0:
-                printf("\n%s感谢使用喝水提醒应用！保持健康！%s\n", 
+                ui_printf("\n%s感谢使用喝水提醒应用！保持健康！%s\n", 
                        COLOR_GREEN, COLOR_RESET);
                 app->is_running = 0;
                 break;
             default:
-                printf("%s❌ 无效选择！请重新输入。%s\n", COLOR_RED, COLOR_RESET);
-                sleep(2);
+                ui_printf("%s❌ 无效选择！请重新输入。%s\n", COLOR_RED, COLOR_RESET);
+                ui_sleep(2);
         }
     }
 }
 
+/**
+ * @brief 显示命令行用法
+ */
+static void print_usage(const char *program) {
+    printf("用法: %s [选项]\n", program);
+    printf("      %s [选项] import <文件> [--format csv|jsonl]\n", program);
+    printf("      %s [选项] export <文件> [--format csv|jsonl]\n", program);
+    printf("\n");
+    printf("  -d, --daemon       以守护进程方式运行，通过 %s 提供接口\n", DAEMON_SOCKET_FILE);
+    printf("  -u, --user <名称>  使用指定用户的配置和记录（位于 %s/<名称>/）\n", USER_DATA_DIR);
+    printf("      --metrics      退出时将性能指标汇总输出到标准错误\n");
+    printf("  -h, --help         显示此帮助信息\n");
+    printf("\n");
+    printf("import/export 以 CSV 或 JSON Lines 格式导入导出记录，文件为 - 时使用标准输入/输出；\n");
+    printf("未指定 --format 时按扩展名判断（.jsonl/.json 为 JSON Lines，其他为 CSV）。\n");
+    printf("运行期间每 %d 秒将性能指标写入 %s。\n", METRICS_INTERVAL, METRICS_FILE);
+    printf("不带选项时启动交互式终端界面。\n");
+}
+
 /**
  * @brief 程序主入口
  */
-int main(void) {
-    // 设置信号处理
-    signal(SIGINT, signal_handler);
-    signal(SIGTERM, signal_handler);
-    signal(SIGALRM, reminder_handler);
+int main(int argc, char *argv[]) {
+    int daemon_mode = 0;
+    const char *user = NULL;
+    const char *command = NULL;
+    const char *command_file = NULL;
+    const char *format = NULL;
+    
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-d") == 0 || strcmp(argv[i], "--daemon") == 0) {
+            daemon_mode = 1;
+        } else if ((strcmp(argv[i], "-u") == 0 || strcmp(argv[i], "--user") == 0) && i + 1 < argc) {
+            user = argv[++i];
+        } else if (strcmp(argv[i], "--metrics") == 0) {
+            metrics_dump_on_exit(stderr);
+        } else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            format = argv[++i];
+        } else if ((strcmp(argv[i], "import") == 0 || strcmp(argv[i], "export") == 0) &&
+                   !command && i + 1 < argc) {
+            command = argv[i];
+            command_file = argv[++i];
+        } else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+            print_usage(argv[0]);
+            return 0;
+        } else {
+            fprintf(stderr, "未知选项: %s\n", argv[i]);
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    
+    // 导入导出子命令：不进入界面，完成后直接退出
+    if (command) {
+        if (init_app(&g_app, user, 1) != 0) {
+            fprintf(stderr, "%s❌ 应用初始化失败！%s\n", COLOR_RED, COLOR_RESET);
+            return 1;
+        }
+        int ret = strcmp(command, "import") == 0 ?
+            import_records(&g_app, command_file, format) :
+            export_records(&g_app, command_file, format);
+        cleanup_app(&g_app);
+        return ret == 0 ? 0 : 1;
+    }
+    
+    // 退出信号由事件循环在主线程中处理，需在创建任何线程之前设置
+    if (event_loop_init(&g_app) != 0) {
+        fprintf(stderr, "%s❌ 事件循环初始化失败！%s\n", COLOR_RED, COLOR_RESET);
+        return 1;
+    }
     
     // 初始化应用
-    if (init_app(&g_app) != 0) {
+    if (init_app(&g_app, user, daemon_mode) != 0) {
         fprintf(stderr, "%s❌ 应用初始化失败！%s\n", COLOR_RED, COLOR_RESET);
         return 1;
     }
     
+    // 守护进程模式：不显示界面，直到收到退出信号
+    if (daemon_mode) {
+        int ret = daemon_run(&g_app);
+        cleanup_app(&g_app);
+        event_loop_shutdown();
+        return ret == 0 ? 0 : 1;
+    }
+    
     // 显示欢迎信息
     clear_screen();
     show_banner();
-    printf("\n%s%s 欢迎使用喝水提醒应用！ %s%s\n", 
+    ui_printf("\n%s%s 欢迎使用喝水提醒应用！ %s%s\n", 
            COLOR_BOLD, DROP_CHAR, DROP_CHAR, COLOR_RESET);
-    printf("%s你好，%s！让我们一起养成健康的喝水习惯吧！%s\n", 
+    ui_printf("%s你好，%s！让我们一起养成健康的喝水习惯吧！%s\n", 
            COLOR_CYAN, g_app.config.name, COLOR_RESET);
-    printf("\n按任意键开始...");
-    getchar();
+    ui_printf("\n按任意键开始...");
+    wait_for_enter();
     
     // 设置提醒定时器
     setup_reminder_timer(&g_app);
@@ -302,6 +457,8 @@ int main(void) {
     main_loop(&g_app);
     
     // 清理并退出
+    render_present();
     cleanup_app(&g_app);
+    event_loop_shutdown();
     return 0;
 } 
\ No newline at end of file
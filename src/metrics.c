@@ -0,0 +1,343 @@
+/**
+ * @file metrics.c
+ * @brief 喝水提醒终端应用 - 性能指标模块
+ * @author zcg
+ * @date 2024
+ * @description 热点路径的调用次数和耗时直方图：直方图按 HDR 方式分桶，
+ *              每个2的幂区间再均分为 2^METRICS_SUB_BUCKET_BITS 个桶，记录一次只需几次原子加法；
+ *              后台线程定期把汇总结果写入指标文件，--metrics 在退出时输出同样的汇总。
+ *              以 -DNO_METRICS 编译时埋点宏展开为空，本模块只保留空实现
+ */
+
+#include "water_reminder.h"
+
+#ifndef NO_METRICS
+
+#include <pthread.h>
+
+/**
+ * @brief 一个指标的计数和耗时直方图（纳秒）
+ */
+typedef struct {
+    uint64_t sum;                  // 累计耗时
+    uint64_t min;                  // 最小值（0表示尚无记录）
+    uint64_t max;                  // 最大值
+    uint64_t buckets[METRICS_HISTOGRAM_BUCKETS]; // 各桶的次数
+} Histogram;
+
+static Histogram g_histograms[METRIC_COUNT];
+
+/**
+ * @brief 指标名（输出和指标文件中的标识）
+ */
+static const char *const g_metric_names[METRIC_COUNT] = {
+    "load_records",
+    "save_records",
+    "log_write",
+    "log_flush",
+    "today_stats",
+    "daily_average",
+    "streak_days",
+    "weekly_stats",
+    "monthly_stats",
+    "heatmap_stats",
+    "render_frame",
+    "journal_sync",
+    "reminder_jitter"
+};
+
+/**
+ * @brief 指标文件写出线程状态
+ */
+static struct {
+    int running;                   // 后台线程是否运行
+    int initialized;               // 是否已初始化
+    time_t started;                // 初始化时间
+    FILE *exit_dump;               // 退出时输出汇总的位置（--metrics）
+    pthread_t thread;              // 后台写出线程
+    pthread_mutex_t lock;          // 保护运行状态
+    pthread_cond_t wake;           // 唤醒后台线程
+} g_metrics = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER
+};
+
+/* ==================== 直方图函数 ==================== */
+
+/**
+ * @brief 计算数值所在的桶
+ * @description 小于 2^METRICS_SUB_BUCKET_BITS 的值每个值一个桶，
+ *              更大的值按最高位所在的2的幂区间分组，组内取最高位之后的几位细分
+ */
+static int bucket_index(uint64_t value) {
+    if (value < (1u << METRICS_SUB_BUCKET_BITS)) {
+        return (int)value;
+    }
+
+    int exponent = 63 - __builtin_clzll(value);
+    int shift = exponent - METRICS_SUB_BUCKET_BITS;
+    return ((shift + 1) << METRICS_SUB_BUCKET_BITS) +
+           (int)((value >> shift) - (1u << METRICS_SUB_BUCKET_BITS));
+}
+
+/**
+ * @brief 计算桶能表示的最大值
+ */
+static uint64_t bucket_upper(int index) {
+    if (index < (1 << METRICS_SUB_BUCKET_BITS)) {
+        return (uint64_t)index;
+    }
+
+    int shift = (index >> METRICS_SUB_BUCKET_BITS) - 1;
+    uint64_t mantissa = (uint64_t)(index & ((1 << METRICS_SUB_BUCKET_BITS) - 1)) +
+                        (1u << METRICS_SUB_BUCKET_BITS);
+    return ((mantissa + 1) << shift) - 1;
+}
+
+/**
+ * @brief 获取单调时钟的当前纳秒数
+ */
+uint64_t metrics_now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * @brief 记录一次耗时
+ * @description 只使用宽松的原子操作，可在任意线程中调用
+ */
+void metrics_record(MetricId id, uint64_t value_ns) {
+    if ((unsigned)id >= METRIC_COUNT) return;
+
+    Histogram *histogram = &g_histograms[id];
+    __atomic_fetch_add(&histogram->buckets[bucket_index(value_ns)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&histogram->sum, value_ns, __ATOMIC_RELAXED);
+
+    // 最小值用0表示尚无记录，记录值至少为1
+    uint64_t value = value_ns > 0 ? value_ns : 1;
+    uint64_t current = __atomic_load_n(&histogram->min, __ATOMIC_RELAXED);
+    while ((current == 0 || value < current) &&
+           !__atomic_compare_exchange_n(&histogram->min, &current, value, 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+
+    current = __atomic_load_n(&histogram->max, __ATOMIC_RELAXED);
+    while (value_ns > current &&
+           !__atomic_compare_exchange_n(&histogram->max, &current, value_ns, 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+/**
+ * @brief 记录计划时间到现在的延迟（提醒抖动）
+ * @param scheduled 计划时间（Unix秒），0表示没有计划
+ */
+void metrics_record_delay(MetricId id, time_t scheduled) {
+    if (scheduled <= 0) return;
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    int64_t delay = ((int64_t)now.tv_sec - (int64_t)scheduled) * 1000000000 + now.tv_nsec;
+    metrics_record(id, delay > 0 ? (uint64_t)delay : 0);
+}
+
+/* ==================== 汇总输出函数 ==================== */
+
+/**
+ * @brief 从直方图快照中计算百分位数
+ */
+static uint64_t histogram_percentile(const uint64_t *buckets, uint64_t count,
+                                     uint64_t max, double percentile) {
+    uint64_t target = (uint64_t)(percentile / 100.0 * (double)count + 0.5);
+    if (target == 0) target = 1;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < METRICS_HISTOGRAM_BUCKETS; i++) {
+        seen += buckets[i];
+        if (seen >= target) {
+            uint64_t upper = bucket_upper(i);
+            return upper < max ? upper : max;
+        }
+    }
+    return max;
+}
+
+/**
+ * @brief 输出所有指标的汇总（制表符分隔，单位为微秒）
+ */
+void metrics_dump(FILE *out) {
+    if (!out) return;
+
+    uint64_t buckets[METRICS_HISTOGRAM_BUCKETS];
+
+    fprintf(out, "# metric\tcount\tmean_us\tmin_us\tp50_us\tp90_us\tp99_us\tp999_us\tmax_us\n");
+    for (int id = 0; id < METRIC_COUNT; id++) {
+        const Histogram *histogram = &g_histograms[id];
+
+        // 记录次数即各桶次数之和；各桶单独读取，与并发记录之间的微小不一致不影响汇总
+        uint64_t count = 0;
+        for (int i = 0; i < METRICS_HISTOGRAM_BUCKETS; i++) {
+            buckets[i] = __atomic_load_n(&histogram->buckets[i], __ATOMIC_RELAXED);
+            count += buckets[i];
+        }
+        uint64_t sum = __atomic_load_n(&histogram->sum, __ATOMIC_RELAXED);
+        uint64_t min = __atomic_load_n(&histogram->min, __ATOMIC_RELAXED);
+        uint64_t max = __atomic_load_n(&histogram->max, __ATOMIC_RELAXED);
+
+        if (count == 0) {
+            fprintf(out, "%s\t0\t-\t-\t-\t-\t-\t-\t-\n", g_metric_names[id]);
+            continue;
+        }
+
+        fprintf(out, "%s\t%llu\t%.1f\t%.1f\t%.1f\t%.1f\t%.1f\t%.1f\t%.1f\n",
+                g_metric_names[id], (unsigned long long)count,
+                (double)sum / (double)count / 1000.0,
+                (double)min / 1000.0,
+                (double)histogram_percentile(buckets, count, max, 50.0) / 1000.0,
+                (double)histogram_percentile(buckets, count, max, 90.0) / 1000.0,
+                (double)histogram_percentile(buckets, count, max, 99.0) / 1000.0,
+                (double)histogram_percentile(buckets, count, max, 99.9) / 1000.0,
+                (double)max / 1000.0);
+    }
+}
+
+/**
+ * @brief 将汇总写入指标文件（先写临时文件再重命名，读取方不会看到写了一半的文件）
+ */
+static void metrics_write_file(void) {
+    FILE *file = fopen(METRICS_FILE ".tmp", "w");
+    if (!file) return;
+
+    time_t now = time(NULL);
+    char time_str[32];
+    struct tm tm_info;
+    localtime_r(&now, &tm_info);
+    strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", &tm_info);
+
+    fprintf(file, "# updated %s, uptime %lds\n", time_str, (long)(now - g_metrics.started));
+    metrics_dump(file);
+
+    if (fclose(file) == 0) {
+        rename(METRICS_FILE ".tmp", METRICS_FILE);
+    } else {
+        remove(METRICS_FILE ".tmp");
+    }
+}
+
+/**
+ * @brief 后台写出线程：每 METRICS_INTERVAL 秒写一次指标文件
+ */
+static void *metrics_thread_main(void *arg) {
+    (void)arg;
+
+    pthread_mutex_lock(&g_metrics.lock);
+    while (g_metrics.running) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += METRICS_INTERVAL;
+
+        if (pthread_cond_timedwait(&g_metrics.wake, &g_metrics.lock, &deadline) != 0 &&
+            g_metrics.running) {
+            pthread_mutex_unlock(&g_metrics.lock);
+            metrics_write_file();
+            pthread_mutex_lock(&g_metrics.lock);
+        }
+    }
+    pthread_mutex_unlock(&g_metrics.lock);
+
+    return NULL;
+}
+
+/**
+ * @brief 设置退出时输出汇总的位置，NULL表示不输出
+ */
+void metrics_dump_on_exit(FILE *out) {
+    g_metrics.exit_dump = out;
+}
+
+/**
+ * @brief 启动指标文件写出线程
+ */
+int metrics_init(void) {
+    if (g_metrics.initialized) return 0;
+
+    g_metrics.started = time(NULL);
+    g_metrics.running = 1;
+
+    // 后台线程屏蔽所有信号，信号始终由主线程的事件循环处理
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    int ret = pthread_create(&g_metrics.thread, NULL, metrics_thread_main, NULL);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    if (ret != 0) {
+        g_metrics.running = 0;
+        return -1;
+    }
+
+    g_metrics.initialized = 1;
+    return 0;
+}
+
+/**
+ * @brief 停止写出线程，写出最终的指标文件并按需输出汇总
+ */
+void metrics_shutdown(void) {
+    if (g_metrics.exit_dump) {
+        metrics_dump(g_metrics.exit_dump);
+        g_metrics.exit_dump = NULL;
+    }
+    if (!g_metrics.initialized) return;
+
+    pthread_mutex_lock(&g_metrics.lock);
+    g_metrics.running = 0;
+    pthread_cond_signal(&g_metrics.wake);
+    pthread_mutex_unlock(&g_metrics.lock);
+    pthread_join(g_metrics.thread, NULL);
+
+    metrics_write_file();
+    g_metrics.initialized = 0;
+}
+
+#else /* NO_METRICS */
+
+static FILE *g_exit_dump = NULL;
+
+int metrics_init(void) {
+    return 0;
+}
+
+void metrics_dump_on_exit(FILE *out) {
+    g_exit_dump = out;
+}
+
+void metrics_shutdown(void) {
+    if (g_exit_dump) {
+        metrics_dump(g_exit_dump);
+        g_exit_dump = NULL;
+    }
+}
+
+void metrics_dump(FILE *out) {
+    if (out) {
+        fprintf(out, "# 性能指标已在编译时禁用 (NO_METRICS)\n");
+    }
+}
+
+uint64_t metrics_now_ns(void) {
+    return 0;
+}
+
+void metrics_record(MetricId id, uint64_t value_ns) {
+    (void)id;
+    (void)value_ns;
+}
+
+void metrics_record_delay(MetricId id, time_t scheduled) {
+    (void)id;
+    (void)scheduled;
+}
+
+#endif /* NO_METRICS */
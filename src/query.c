@@ -0,0 +1,531 @@
+/**
+ * @file query.c
+ * @brief 喝水提醒终端应用 - 区间查询模块
+ * @author zcg
+ * @date 2024
+ * @description 统一的区间统计查询：把时间区间按小时、日、周或自然月划分为桶，
+ *              一次遍历得出每个桶的总量、次数、最值、平均值和百分位数以及整个区间的汇总。
+ *              桶边界由日历缓存换算，夏令时切换日同样准确；
+ *              不需要百分位数时读汇总层中与桶粒度对应的最粗一层（月桶读月层，日桶和周桶读日层，
+ *              小时桶读小时层），汇总层未就绪时按日及更粗的粒度读每日聚合索引，
+ *              否则扫描原始记录（列式历史已构建时逐桶用向量化内核聚合）。
+ *              需要百分位数时总量、次数和最值仍由汇总层得出（包含已折叠的记录），
+ *              直方图只能由原始记录得出，百分位数只反映数据日志中尚未折叠的记录。
+ *              统计视图都建立在这里，新增季度、年度等视图只需增加一种桶粒度
+ */
+
+#include "water_reminder.h"
+#include <limits.h>
+
+/* ==================== 桶边界函数 ==================== */
+
+/**
+ * @brief 计算包含指定时间的桶的起点
+ * @param day 输出桶起点所在的天号
+ */
+static time_t bucket_floor(time_t timestamp, BucketSize size, int *day) {
+    int d = timestamp_to_day(timestamp);
+    struct tm tm_info;
+
+    switch (size) {
+        case BUCKET_HOUR: {
+            time_t start = day_start_time(d);
+            *day = d;
+            return start + (timestamp - start) / 3600 * 3600;
+        }
+        case BUCKET_WEEK:
+            day_number_to_tm(d, &tm_info);
+            d -= (tm_info.tm_wday + 6) % 7; // 周一为一周的第一天
+            break;
+        case BUCKET_MONTH:
+            day_number_to_tm(d, &tm_info);
+            d -= tm_info.tm_mday - 1;
+            break;
+        default:
+            break;
+    }
+
+    *day = d;
+    return day_start_time(d);
+}
+
+/**
+ * @brief 计算下一个桶的起点
+ * @param day 输入当前桶起点所在的天号，输出下一个桶起点所在的天号
+ */
+static time_t bucket_next(time_t start, BucketSize size, int *day) {
+    struct tm tm_info;
+
+    switch (size) {
+        case BUCKET_HOUR: {
+            // 夏令时切换日的小时数不是24，跨过次日零点时以零点为界
+            time_t next_day = day_start_time(*day + 1);
+            if (start + 3600 < next_day) {
+                return start + 3600;
+            }
+            (*day)++;
+            return next_day;
+        }
+        case BUCKET_WEEK:
+            *day += 7;
+            break;
+        case BUCKET_MONTH:
+            // 月初之后第31天总在下个月内，退回到该月1日
+            day_number_to_tm(*day + 31, &tm_info);
+            *day += 31 - (tm_info.tm_mday - 1);
+            break;
+        default:
+            (*day)++;
+            break;
+    }
+    return day_start_time(*day);
+}
+
+/* ==================== 聚合辅助函数 ==================== */
+
+/**
+ * @brief 将一组数据计入桶
+ */
+static void bucket_add(QueryBucket *bucket, long long sum, int count, int min, int max) {
+    if (count <= 0) return;
+
+    if (bucket->count == 0 || min < bucket->min) bucket->min = min;
+    if (bucket->count == 0 || max > bucket->max) bucket->max = max;
+    bucket->sum += sum;
+    bucket->count += count;
+}
+
+/**
+ * @brief 喝水量所在的直方图桶
+ */
+static int histogram_bin(int amount) {
+    if (amount < 0) return 0;
+    if (amount > WATER_AMOUNT_MAX) return QUERY_HISTOGRAM_BINS - 1;
+    return amount / QUERY_HISTOGRAM_STEP;
+}
+
+/**
+ * @brief 从直方图中计算百分位数
+ * @description 取所在直方图桶的下界并限制在实际最值之间，
+ *              常见的整十毫升喝水量可以得到精确值
+ */
+static int histogram_percentile(const uint32_t *bins, long long total, const QueryBucket *bucket,
+                                double percentile) {
+    long long target = (long long)(percentile / 100.0 * total + 0.5);
+    if (target < 1) target = 1;
+
+    long long seen = 0;
+    for (int i = 0; i < QUERY_HISTOGRAM_BINS; i++) {
+        seen += bins[i];
+        if (seen >= target) {
+            int value = i * QUERY_HISTOGRAM_STEP;
+            if (value < bucket->min) value = bucket->min;
+            if (value > bucket->max) value = bucket->max;
+            return value;
+        }
+    }
+    return bucket->max;
+}
+
+/**
+ * @brief 填写桶的平均值和百分位数
+ * @description 直方图只包含未折叠的记录，桶内记录全部已折叠时百分位数保持为0
+ */
+static void bucket_finish(QueryBucket *bucket, const uint32_t *bins) {
+    bucket->mean = bucket->count > 0 ? (double)bucket->sum / bucket->count : 0.0;
+    if (!bins) return;
+
+    long long total = 0;
+    for (int i = 0; i < QUERY_HISTOGRAM_BINS; i++) {
+        total += bins[i];
+    }
+    if (total > 0) {
+        bucket->p50 = histogram_percentile(bins, total, bucket, 50.0);
+        bucket->p90 = histogram_percentile(bins, total, bucket, 90.0);
+        bucket->p99 = histogram_percentile(bins, total, bucket, 99.0);
+    }
+}
+
+/**
+ * @brief 查找时间戳所在的桶
+ * @return 不在任何桶内时返回-1
+ */
+static int bucket_find(const QueryBucket *buckets, int count, time_t timestamp) {
+    if (timestamp < buckets[0].start || timestamp >= buckets[count - 1].end) {
+        return -1;
+    }
+
+    int lo = 0, hi = count - 1;
+    while (lo < hi) {
+        int mid = lo + (hi - lo + 1) / 2;
+        if (buckets[mid].start <= timestamp) lo = mid;
+        else hi = mid - 1;
+    }
+    return lo;
+}
+
+/* ==================== 数据来源 ==================== */
+
+/**
+ * @brief 将汇总层的一个聚合计入桶
+ */
+static void bucket_add_cell(QueryBucket *bucket, const RollupCell *cell) {
+    if (cell) {
+        bucket_add(bucket, cell->sum, cell->count, cell->min, cell->max);
+    }
+}
+
+/**
+ * @brief 从汇总层填充各桶
+ * @description 桶边界与汇总层的时间段一一对齐，结果与逐条扫描完全一致
+ */
+static void fill_from_rollup(const Rollup *rollup, BucketSize size, QueryBucket *buckets, int count) {
+    for (int b = 0; b < count; b++) {
+        QueryBucket *bucket = &buckets[b];
+        switch (size) {
+            case BUCKET_HOUR:
+                bucket_add_cell(bucket, rollup_cell(rollup, ROLLUP_HOUR,
+                                                    rollup_hour_key(bucket->first_day, bucket->start)));
+                break;
+            case BUCKET_MONTH:
+                bucket_add_cell(bucket, rollup_cell(rollup, ROLLUP_MONTH,
+                                                    rollup_month_key(bucket->first_day)));
+                break;
+            default: {
+                // 只访问日层已覆盖的天，其余的天没有记录
+                const RollupTier *tier = &rollup->tiers[ROLLUP_DAY];
+                int first = bucket->first_day - tier->base;
+                int end = first + bucket->days;
+                if (first < 0) first = 0;
+                if (end > tier->count) end = tier->count;
+                for (int i = first; i < end; i++) {
+                    if (tier->cells[i].count > 0) bucket_add_cell(bucket, &tier->cells[i]);
+                }
+                break;
+            }
+        }
+    }
+}
+
+/**
+ * @brief 从每日聚合索引填充按日、周、月划分的桶
+ */
+static void fill_from_day_index(const DayIndex *index, QueryBucket *buckets, int count) {
+    for (int b = 0; b < count; b++) {
+        // 只访问索引已覆盖的天，其余的天没有记录
+        int first = buckets[b].first_day - index->base_day;
+        int end = first + buckets[b].days;
+        if (first < 0) first = 0;
+        if (end > index->day_count) end = index->day_count;
+
+        long long sum = 0;
+        int records = 0, min = INT_MAX, max = INT_MIN;
+        for (int i = first; i < end; i++) {
+            const DayAggregate *agg = &index->days[i];
+            if (agg->count == 0) continue;
+            sum += agg->total_ml;
+            records += agg->count;
+            if (agg->min_ml < min) min = agg->min_ml;
+            if (agg->max_ml > max) max = agg->max_ml;
+        }
+        bucket_add(&buckets[b], sum, records, min, max);
+    }
+}
+
+/**
+ * @brief 用列式历史逐桶聚合（列式历史与记录存储同步时使用）
+ */
+static void fill_from_columns(const RecordColumns *columns, QueryBucket *buckets, int count) {
+    for (int b = 0; b < count; b++) {
+        RangeAggregate range;
+        record_columns_aggregate(columns, buckets[b].start, buckets[b].end, &range);
+        bucket_add(&buckets[b], range.sum, range.count, range.min, range.max);
+    }
+}
+
+/**
+ * @brief 逐条扫描原始记录填充桶
+ * @param bins 每个桶一个直方图，不需要百分位数时为NULL
+ * @param totals 是否计入总量、次数和最值，为0时只填直方图（总量已由汇总层得出）
+ * @description 有序记录先二分查找区间起点，桶随时间顺序推进；
+ *              存在倒序记录时扫描全部记录并逐条二分查找所在的桶
+ */
+static void fill_from_records(const RecordStore *store, QueryBucket *buckets, int count,
+                              uint32_t *bins, int totals) {
+    time_t from = buckets[0].start;
+    time_t to = buckets[count - 1].end;
+    int begin = store->sorted ? record_store_lower_bound(store, from) : 0;
+    int b = 0;
+
+    for (int i = begin; i < store->count; i++) {
+        const WaterRecord *record = record_store_at(store, i);
+        time_t timestamp = (time_t)record->timestamp;
+
+        if (store->sorted) {
+            if (timestamp >= to) break;
+            while (timestamp >= buckets[b].end) b++;
+        } else {
+            b = bucket_find(buckets, count, timestamp);
+            if (b < 0) continue;
+        }
+
+        if (totals) {
+            bucket_add(&buckets[b], record->amount, 1, record->amount, record->amount);
+        }
+        if (bins) {
+            bins[(size_t)b * QUERY_HISTOGRAM_BINS + histogram_bin(record->amount)]++;
+        }
+    }
+}
+
+/* ==================== 查询接口 ==================== */
+
+/**
+ * @brief 执行区间查询
+ * @param buckets 输出每个桶的统计，NULL 表示只需要汇总
+ * @param capacity buckets 的容量
+ * @param summary 输出整个区间的汇总，可为NULL
+ * @return 桶数；区间无效、桶数超过容量或 QUERY_MAX_BUCKETS、内存不足时返回-1
+ */
+int range_query(const AppState *app, const RangeQuery *query,
+                QueryBucket *buckets, int capacity, QuerySummary *summary) {
+    if (!app || !query || query->from >= query->to) return -1;
+
+    // 先划分桶边界；只需要汇总时桶数组由这里临时分配
+    QueryBucket *list = buckets;
+    int limit = buckets ? capacity : 0;
+    int count = 0;
+    int day;
+    time_t start = bucket_floor(query->from, query->bucket, &day);
+
+    while (start < query->to) {
+        if (count >= limit) {
+            int new_limit = limit > 0 ? limit * 2 : 64;
+            if (new_limit > QUERY_MAX_BUCKETS) new_limit = QUERY_MAX_BUCKETS;
+            QueryBucket *grown = buckets || count >= new_limit ? NULL :
+                realloc(list, (size_t)new_limit * sizeof(QueryBucket));
+            if (!grown) {
+                if (list != buckets) free(list);
+                return -1;
+            }
+            list = grown;
+            limit = new_limit;
+        }
+        QueryBucket *bucket = &list[count++];
+        int first_day = day;
+        time_t end = bucket_next(start, query->bucket, &day);
+        QueryBucket empty = { start, end, first_day,
+                              query->bucket == BUCKET_HOUR ? 0 : day - first_day,
+                              0, 0, 0, 0, 0.0, 0, 0, 0 };
+        *bucket = empty;
+        start = end;
+    }
+
+    // 选择数据来源并填充各桶；已折叠的记录只存在于汇总层，汇总层就绪时总量总是由它得出
+    uint32_t *bins = NULL;
+    int ready = rollup_ready(&app->rollup, &app->records);
+    if (query->flags & QUERY_PERCENTILES) {
+        bins = calloc((size_t)count * QUERY_HISTOGRAM_BINS, sizeof(uint32_t));
+        if (!bins) {
+            if (list != buckets) free(list);
+            return -1;
+        }
+        if (ready) fill_from_rollup(&app->rollup, query->bucket, list, count);
+        fill_from_records(&app->records, list, count, bins, !ready);
+    } else if (ready) {
+        fill_from_rollup(&app->rollup, query->bucket, list, count);
+    } else if (query->bucket != BUCKET_HOUR &&
+               day_index_covers(&app->day_index, &app->records, list[0].first_day)) {
+        fill_from_day_index(&app->day_index, list, count);
+    } else if (app->columns.count == app->records.count && app->columns.count > 0) {
+        fill_from_columns(&app->columns, list, count);
+    } else {
+        fill_from_records(&app->records, list, count, NULL, 1);
+    }
+
+    // 汇总各桶，整体的百分位数由各桶直方图合并得出
+    uint32_t total_bins[QUERY_HISTOGRAM_BINS];
+    QuerySummary result;
+    memset(&result, 0, sizeof(result));
+    memset(total_bins, 0, sizeof(total_bins));
+    result.total.start = list[0].start;
+    result.total.end = list[count - 1].end;
+    result.total.first_day = list[0].first_day;
+
+    for (int b = 0; b < count; b++) {
+        const uint32_t *bucket_bins = bins ? bins + (size_t)b * QUERY_HISTOGRAM_BINS : NULL;
+        bucket_finish(&list[b], bucket_bins);
+        if (list[b].count == 0) continue;
+
+        bucket_add(&result.total, list[b].sum, list[b].count, list[b].min, list[b].max);
+        result.active++;
+        if (list[b].sum > result.best) result.best = list[b].sum;
+        if (bucket_bins) {
+            for (int i = 0; i < QUERY_HISTOGRAM_BINS; i++) {
+                total_bins[i] += bucket_bins[i];
+            }
+        }
+    }
+    bucket_finish(&result.total, bins ? total_bins : NULL);
+
+    free(bins);
+    if (list != buckets) free(list);
+    if (summary) *summary = result;
+    return count;
+}
+
+/**
+ * @brief 查询以今天结尾的最近若干天（按日分桶）
+ * @param days 天数，今天为最后一个桶
+ */
+int range_query_recent_days(const AppState *app, int days, int flags,
+                            QueryBucket *buckets, int capacity, QuerySummary *summary) {
+    if (days <= 0) return -1;
+
+    int today = today_day_number();
+    RangeQuery query;
+    query.from = day_start_time(today - days + 1);
+    query.to = day_start_time(today + 1);
+    query.bucket = BUCKET_DAY;
+    query.flags = flags;
+    return range_query(app, &query, buckets, capacity, summary);
+}
+
+/* ==================== 热力图 ==================== */
+
+/**
+ * @brief 天号对应的星期（周一为0）
+ */
+static int weekday_index(int day) {
+    return ((day % 7) + 10) % 7; // 1970-01-01 是星期四
+}
+
+/**
+ * @brief 小时层的键所在的天号
+ */
+static int hour_key_day(int key) {
+    return key >= 0 ? key / ROLLUP_DAY_HOURS : -((-key + ROLLUP_DAY_HOURS - 1) / ROLLUP_DAY_HOURS);
+}
+
+/**
+ * @brief 时间戳的本地钟点
+ * @description 一天正好24小时时直接由距零点的秒数得出，夏令时切换日按本地时间换算
+ */
+static int clock_hour(time_t day_start, time_t next_start, time_t timestamp) {
+    if (next_start - day_start == 86400) {
+        return (int)((timestamp - day_start) / 3600);
+    }
+
+    struct tm tm_info;
+    localtime_r(&timestamp, &tm_info);
+    return tm_info.tm_hour;
+}
+
+/**
+ * @brief 将一个时间段的数据计入热力图
+ */
+static void heatmap_add(IntakeHeatmap *map, int weekday, int hour, long long amount, int count) {
+    map->amount[weekday][hour] += amount;
+    map->count[weekday][hour] += count;
+}
+
+/**
+ * @brief 一次遍历原始记录，把 [from, to) 内的记录计入热力图
+ * @description 有序记录先二分查找起点；同一天的记录复用当天的零点
+ */
+static void heatmap_from_records(const RecordStore *store, IntakeHeatmap *map, time_t from, time_t to) {
+    int begin = store->sorted ? record_store_lower_bound(store, from) : 0;
+    int weekday = 0;
+    time_t day_start = 0, next_start = 0;
+
+    for (int i = begin; i < store->count; i++) {
+        const WaterRecord *record = record_store_at(store, i);
+        time_t timestamp = (time_t)record->timestamp;
+
+        if (timestamp < from || timestamp >= to) {
+            if (store->sorted && timestamp >= to) break;
+            continue;
+        }
+        if (next_start == 0 || timestamp < day_start || timestamp >= next_start) {
+            int day = timestamp_to_day(timestamp);
+            day_start = day_start_time(day);
+            next_start = day_start_time(day + 1);
+            weekday = weekday_index(day);
+        }
+
+        heatmap_add(map, weekday, clock_hour(day_start, next_start, timestamp), record->amount, 1);
+    }
+}
+
+/**
+ * @brief 从汇总层的小时层填充热力图
+ * @description 只访问小时层已覆盖的天，每天最多读 ROLLUP_DAY_HOURS 个聚合，与记录数无关。
+ *              夏令时只调整半小时的时区里，切换日的小时段跨两个钟点，
+ *              这一天的原始记录还在时改为逐条统计
+ */
+static void heatmap_from_rollup(const Rollup *rollup, const RecordStore *store, IntakeHeatmap *map) {
+    const RollupTier *tier = &rollup->tiers[ROLLUP_HOUR];
+    if (tier->count == 0) return;
+
+    // 小时层的键按天连续排列，向下取整得到覆盖的第一天和最后一天
+    int tier_first = hour_key_day(tier->base);
+    int tier_last = hour_key_day(tier->base + tier->count - 1);
+    int first = map->first_day > tier_first ? map->first_day : tier_first;
+    int last = map->first_day + map->days - 1 < tier_last ? map->first_day + map->days - 1 : tier_last;
+
+    time_t next_start = day_start_time(first);
+    for (int day = first; day <= last; day++) {
+        time_t day_start = next_start;
+        next_start = day_start_time(day + 1);
+        int weekday = weekday_index(day);
+
+        if ((next_start - day_start) % 3600 != 0 && store->sorted && store->count > 0 &&
+            (time_t)record_store_at(store, 0)->timestamp <= day_start) {
+            heatmap_from_records(store, map, day_start, next_start);
+            continue;
+        }
+
+        for (int slot = 0; slot < ROLLUP_DAY_HOURS; slot++) {
+            int offset = day * ROLLUP_DAY_HOURS + slot - tier->base;
+            if (offset < 0 || offset >= tier->count || tier->cells[offset].count == 0) continue;
+
+            const RollupCell *cell = &tier->cells[offset];
+            int hour = clock_hour(day_start, next_start, day_start + (time_t)slot * 3600);
+            heatmap_add(map, weekday, hour, cell->sum, cell->count);
+        }
+    }
+}
+
+/**
+ * @brief 计算按星期和钟点划分的喝水热力图
+ * @param first_day 窗口起始天号
+ * @param days 窗口天数
+ * @description 汇总层就绪时读小时层（包含已折叠的记录），否则一次遍历窗口内的原始记录
+ */
+int intake_heatmap(const AppState *app, int first_day, int days, IntakeHeatmap *out) {
+    if (!app || !out || days <= 0) return -1;
+
+    memset(out, 0, sizeof(IntakeHeatmap));
+    out->first_day = first_day;
+    out->days = days;
+
+    // 窗口内每个星期几出现的天数：每7天各一次，余下的天从起始日的星期开始依次各加一次
+    int start_weekday = weekday_index(first_day);
+    for (int w = 0; w < 7; w++) {
+        out->weekdays[w] = days / 7 + ((w - start_weekday + 7) % 7 < days % 7 ? 1 : 0);
+    }
+
+    if (rollup_ready(&app->rollup, &app->records)) {
+        heatmap_from_rollup(&app->rollup, &app->records, out);
+    } else {
+        heatmap_from_records(&app->records, out, day_start_time(first_day),
+                             day_start_time(first_day + days));
+    }
+
+    for (int w = 0; w < 7; w++) {
+        for (int h = 0; h < 24; h++) {
+            if (out->amount[w][h] > out->max_amount) out->max_amount = out->amount[w][h];
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,446 @@
+/**
+ * @file render.c
+ * @brief 喝水提醒终端应用 - 终端渲染模块
+ * @author zcg
+ * @date 2024
+ * @description 帧缓冲式终端渲染：所有界面输出先写入内存中的帧，
+ *              在等待输入或暂停前一次 write() 输出；清屏开始的新画面
+ *              与终端当前内容逐行比较，只重绘发生变化的行
+ */
+
+#include "water_reminder.h"
+#include <errno.h>
+#include <stdarg.h>
+#include <sys/ioctl.h>
+
+/**
+ * @brief 可增长的文本缓冲区
+ */
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+} TextBuffer;
+
+/**
+ * @brief 按行切分后的画面内容
+ */
+typedef struct {
+    const char *text;              // 行内容起始位置（不含换行符）
+    size_t length;                 // 行内容长度
+    char style[RENDER_STYLE_MAX];  // 行首处生效的颜色样式序列
+    size_t style_length;           // 样式序列长度
+    int width;                     // 估算的显示宽度
+} ScreenLine;
+
+/**
+ * @brief 渲染模块状态
+ */
+static struct {
+    TextBuffer frame;              // 尚未输出的帧内容
+    int frame_is_screen;           // 帧是否以清屏开始
+    TextBuffer screen;             // 终端当前显示的内容（自上次清屏起）
+    int screen_valid;              // screen 是否与终端实际内容一致
+    unsigned int generation;       // 已输出的整屏画面计数
+    TextBuffer out;                // 输出缓冲区
+    ScreenLine *old_lines;         // 行切分缓存
+    ScreenLine *new_lines;
+    int old_capacity;
+    int new_capacity;
+} g_render;
+
+/* ==================== 缓冲区工具函数 ==================== */
+
+/**
+ * @brief 确保缓冲区至少还能容纳 extra 字节
+ */
+static int buffer_reserve(TextBuffer *buffer, size_t extra) {
+    if (buffer->length + extra <= buffer->capacity) return 0;
+
+    size_t capacity = buffer->capacity > 0 ? buffer->capacity : 4096;
+    while (capacity < buffer->length + extra) {
+        capacity *= 2;
+    }
+
+    char *data = realloc(buffer->data, capacity);
+    if (!data) return -1;
+    buffer->data = data;
+    buffer->capacity = capacity;
+    return 0;
+}
+
+/**
+ * @brief 向缓冲区追加数据
+ */
+static void buffer_append(TextBuffer *buffer, const char *data, size_t length) {
+    if (length == 0 || buffer_reserve(buffer, length) != 0) return;
+
+    memcpy(buffer->data + buffer->length, data, length);
+    buffer->length += length;
+}
+
+/**
+ * @brief 向缓冲区追加光标定位序列
+ */
+static void buffer_append_goto(TextBuffer *buffer, int row) {
+    char seq[32];
+    int length = snprintf(seq, sizeof(seq), COLOR_RESET "\033[%d;1H", row);
+    buffer_append(buffer, seq, (size_t)length);
+}
+
+/**
+ * @brief 一次系统调用写出全部数据（被信号打断或部分写入时继续）
+ */
+static void write_all(const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t n = write(STDOUT_FILENO, data, length);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        data += n;
+        length -= (size_t)n;
+    }
+}
+
+/* ==================== 画面分析函数 ==================== */
+
+/**
+ * @brief 估算一个Unicode字符在终端中的显示宽度
+ */
+static int codepoint_width(unsigned int cp) {
+    if ((cp >= 0x1100 && cp <= 0x115F) || (cp >= 0x2E80 && cp <= 0xA4CF) ||
+        (cp >= 0xAC00 && cp <= 0xD7A3) || (cp >= 0xF900 && cp <= 0xFAFF) ||
+        (cp >= 0xFE30 && cp <= 0xFE4F) || (cp >= 0xFF00 && cp <= 0xFF60) ||
+        (cp >= 0xFFE0 && cp <= 0xFFE6) || cp >= 0x1F300) {
+        return 2;
+    }
+    return 1;
+}
+
+/**
+ * @brief 将画面内容按行切分，记录每行行首生效的颜色样式和显示宽度
+ * @return 行数，内存不足时返回-1
+ */
+static int split_lines(const TextBuffer *text, ScreenLine **lines, int *capacity) {
+    char style[RENDER_STYLE_MAX];
+    size_t style_length = 0;
+    int count = 0;
+    size_t pos = 0;
+
+    for (;;) {
+        if (count == *capacity) {
+            int new_capacity = *capacity > 0 ? *capacity * 2 : 64;
+            ScreenLine *grown = realloc(*lines, new_capacity * sizeof(ScreenLine));
+            if (!grown) return -1;
+            *lines = grown;
+            *capacity = new_capacity;
+        }
+
+        ScreenLine *line = &(*lines)[count++];
+        line->text = text->data ? text->data + pos : "";
+        line->style_length = style_length;
+        memcpy(line->style, style, style_length);
+        line->width = 0;
+
+        while (pos < text->length && text->data[pos] != '\n') {
+            unsigned char c = (unsigned char)text->data[pos];
+
+            if (c == '\033' && pos + 1 < text->length && text->data[pos + 1] == '[') {
+                // 记录颜色样式序列，重置序列清空已累积的样式
+                size_t end = pos + 2;
+                while (end < text->length && (text->data[end] < '@' || text->data[end] > '~')) {
+                    end++;
+                }
+                if (end < text->length && text->data[end] == 'm') {
+                    size_t seq_length = end - pos + 1;
+                    if (seq_length == 4 && text->data[pos + 2] == '0') {
+                        style_length = 0;
+                    } else if (style_length + seq_length <= sizeof(style)) {
+                        memcpy(style + style_length, text->data + pos, seq_length);
+                        style_length += seq_length;
+                    }
+                }
+                pos = end + 1;
+                continue;
+            }
+
+            if (c < 0x80) {
+                if (c >= 0x20) line->width++;
+                pos++;
+                continue;
+            }
+
+            // 解码UTF-8多字节字符
+            int extra = c >= 0xF0 ? 3 : c >= 0xE0 ? 2 : 1;
+            unsigned int cp = c & (0x3F >> extra);
+            for (int i = 1; i <= extra && pos + i < text->length; i++) {
+                cp = (cp << 6) | ((unsigned char)text->data[pos + i] & 0x3F);
+            }
+            line->width += cp == 0xFE0F ? 0 : codepoint_width(cp);
+            pos += extra + 1;
+        }
+
+        if (pos > text->length) pos = text->length;
+        line->length = text->data ? (size_t)(text->data + pos - line->text) : 0;
+
+        if (pos >= text->length) break;
+        pos++; // 跳过换行符
+    }
+
+    return count;
+}
+
+/**
+ * @brief 判断画面能否完整放入终端（不发生滚动或折行）
+ */
+static int screen_fits(const ScreenLine *lines, int count, int rows, int cols) {
+    if (count >= rows) return 0;
+
+    for (int i = 0; i < count; i++) {
+        if (lines[i].width >= cols) return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief 判断两行内容（含行首样式）是否相同
+ */
+static int lines_equal(const ScreenLine *a, const ScreenLine *b) {
+    return a->length == b->length && a->style_length == b->style_length &&
+           memcmp(a->text, b->text, a->length) == 0 &&
+           memcmp(a->style, b->style, a->style_length) == 0;
+}
+
+/**
+ * @brief 向输出缓冲区追加一整行（含行首样式并清除行尾残留）
+ */
+static void emit_line(TextBuffer *out, const ScreenLine *line) {
+    buffer_append(out, line->style, line->style_length);
+    buffer_append(out, line->text, line->length);
+    buffer_append(out, "\033[K", 3);
+}
+
+/* ==================== 渲染接口函数 ==================== */
+
+/**
+ * @brief 获取终端尺寸
+ * @return 标准输出不是终端时返回-1
+ */
+static int terminal_size(int *rows, int *cols) {
+    struct winsize ws;
+    if (!isatty(STDOUT_FILENO) || ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) != 0 ||
+        ws.ws_row == 0 || ws.ws_col == 0) {
+        return -1;
+    }
+
+    *rows = ws.ws_row;
+    *cols = ws.ws_col;
+    return 0;
+}
+
+/**
+ * @brief 清屏函数
+ * @description 开始一个新画面，之前尚未输出的内容会被丢弃
+ */
+void clear_screen(void) {
+    g_render.frame.length = 0;
+    g_render.frame_is_screen = 1;
+}
+
+/**
+ * @brief 向当前帧追加格式化输出
+ */
+void ui_printf(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+
+    TextBuffer *frame = &g_render.frame;
+    size_t available = frame->capacity - frame->length;
+    va_list copy;
+    va_copy(copy, args);
+    int length = vsnprintf(frame->data ? frame->data + frame->length : NULL,
+                           available, format, copy);
+    va_end(copy);
+
+    if (length >= 0 && (size_t)length >= available) {
+        if (buffer_reserve(frame, (size_t)length + 1) == 0) {
+            vsnprintf(frame->data + frame->length, (size_t)length + 1, format, args);
+        } else {
+            length = -1;
+        }
+    }
+    va_end(args);
+
+    if (length > 0) {
+        frame->length += (size_t)length;
+    }
+}
+
+/**
+ * @brief 计算新画面与终端当前内容的差异并写入输出缓冲区
+ * @return 无法做差异重绘（终端尺寸不足等）时返回-1
+ */
+static int render_diff(TextBuffer *out, int rows, int cols) {
+    int old_count = split_lines(&g_render.screen, &g_render.old_lines, &g_render.old_capacity);
+    int new_count = split_lines(&g_render.frame, &g_render.new_lines, &g_render.new_capacity);
+    if (old_count < 0 || new_count < 0 ||
+        !screen_fits(g_render.old_lines, old_count, rows, cols) ||
+        !screen_fits(g_render.new_lines, new_count, rows, cols)) {
+        return -1;
+    }
+
+    // 最后一行总是重写，使光标停在提示文字之后
+    for (int i = 0; i < new_count - 1; i++) {
+        if (i < old_count && lines_equal(&g_render.old_lines[i], &g_render.new_lines[i])) {
+            continue;
+        }
+        buffer_append_goto(out, i + 1);
+        emit_line(out, &g_render.new_lines[i]);
+    }
+
+    if (old_count > new_count) {
+        buffer_append_goto(out, new_count + 1);
+        buffer_append(out, "\033[J", 3);
+    }
+
+    buffer_append_goto(out, new_count);
+    emit_line(out, &g_render.new_lines[new_count - 1]);
+    return 0;
+}
+
+/**
+ * @brief 将当前帧输出到终端（一次 write）
+ */
+void render_present(void) {
+    TextBuffer *frame = &g_render.frame;
+    TextBuffer *out = &g_render.out;
+
+    if (frame->length == 0 && !g_render.frame_is_screen) return;
+
+    METRIC_START(start);
+    int rows = 0, cols = 0;
+    int is_terminal = terminal_size(&rows, &cols) == 0;
+    out->length = 0;
+
+    if (g_render.frame_is_screen) {
+        if (!is_terminal || !g_render.screen_valid || render_diff(out, rows, cols) != 0) {
+            // 整屏重绘
+            out->length = 0;
+            buffer_append(out, "\033[H\033[2J", 7);
+            buffer_append(out, frame->data, frame->length);
+        }
+
+        g_render.screen.length = 0;
+        g_render.screen_valid = is_terminal;
+        g_render.generation++;
+    } else {
+        buffer_append(out, frame->data, frame->length);
+    }
+
+    // 记录终端当前内容，供下一帧做差异比较
+    if (g_render.screen_valid) {
+        buffer_append(&g_render.screen, frame->data, frame->length);
+    }
+
+    write_all(out->data, out->length);
+
+    frame->length = 0;
+    g_render.frame_is_screen = 0;
+    METRIC_END(METRIC_RENDER_FRAME, start);
+}
+
+/**
+ * @brief 记录终端回显的用户输入，使画面模型与终端内容保持一致
+ */
+void render_note_input(const char *line) {
+    if (!line || !g_render.screen_valid || !isatty(STDIN_FILENO)) return;
+
+    buffer_append(&g_render.screen, line, strlen(line));
+    buffer_append(&g_render.screen, "\n", 1);
+}
+
+/**
+ * @brief 获取整屏画面计数，用于判断之前记下的行号是否仍然有效
+ */
+unsigned int render_generation(void) {
+    return g_render.generation;
+}
+
+/**
+ * @brief 输出当前帧并返回光标所在行号（从1开始）
+ * @return 画面模型无效或画面已超出终端时返回-1
+ */
+int render_cursor_row(void) {
+    render_present();
+
+    int rows = 0, cols = 0;
+    if (!g_render.screen_valid || terminal_size(&rows, &cols) != 0) return -1;
+
+    int count = split_lines(&g_render.screen, &g_render.old_lines, &g_render.old_capacity);
+    if (count < 0 || !screen_fits(g_render.old_lines, count, rows, cols)) {
+        return -1;
+    }
+    return count;
+}
+
+/**
+ * @brief 原地重写已显示的某一行，光标位置和当前样式保持不变
+ * @description 只输出这一行（一次 write），并同步更新画面模型；
+ *              新内容不应包含换行符，且应以 COLOR_RESET 结尾
+ * @return 该行已不在屏幕上时返回-1
+ */
+int render_update_line(int row, const char *text) {
+    TextBuffer *screen = &g_render.screen;
+    int rows = 0, cols = 0;
+    if (!text || !g_render.screen_valid || !screen->data ||
+        terminal_size(&rows, &cols) != 0) {
+        return -1;
+    }
+
+    int count = split_lines(screen, &g_render.old_lines, &g_render.old_capacity);
+    if (count < 0 || row < 1 || row > count ||
+        !screen_fits(g_render.old_lines, count, rows, cols)) {
+        return -1;
+    }
+
+    // 在画面模型中替换该行，行首先重置样式，与终端上的实际效果一致
+    size_t start = (size_t)(g_render.old_lines[row - 1].text - screen->data);
+    size_t end = start + g_render.old_lines[row - 1].length;
+    size_t reset_length = strlen(COLOR_RESET);
+    size_t text_length = strlen(text);
+    size_t new_length = reset_length + text_length;
+
+    if (new_length > end - start && buffer_reserve(screen, new_length - (end - start)) != 0) {
+        return -1;
+    }
+    memmove(screen->data + start + new_length, screen->data + end, screen->length - end);
+    memcpy(screen->data + start, COLOR_RESET, reset_length);
+    memcpy(screen->data + start + reset_length, text, text_length);
+    screen->length = screen->length - (end - start) + new_length;
+
+    // 保存光标，定位到该行重写，再恢复光标和样式
+    TextBuffer *out = &g_render.out;
+    out->length = 0;
+    buffer_append(out, "\0337", 2);
+    buffer_append_goto(out, row);
+    buffer_append(out, text, text_length);
+    buffer_append(out, "\033[K\0338", 5);
+    write_all(out->data, out->length);
+    return 0;
+}
+
+/**
+ * @brief 响一次终端铃声（不经过帧缓冲，不影响画面模型）
+ */
+void render_bell(void) {
+    write_all("\a", 1);
+}
+
+/**
+ * @brief 输出当前帧后暂停指定秒数
+ */
+void ui_sleep(unsigned int seconds) {
+    render_present();
+    sleep(seconds);
+}
@@ -0,0 +1,420 @@
+/**
+ * @file rollup.c
+ * @brief 喝水提醒终端应用 - 多粒度汇总层模块
+ * @author zcg
+ * @date 2024
+ * @description 按小时、日、自然月三种粒度汇总喝水记录（总量、次数、最值），
+ *              添加记录和加载日志时增量更新，退出时以带校验头的快照保存，
+ *              下次启动只需补上快照之后追加的记录。
+ *              区间查询按桶粒度读取最粗的一层，一年按月统计只需读12个聚合；
+ *              超出保留期的原始记录可以折叠进汇总层后从数据日志中删除
+ */
+
+#include "water_reminder.h"
+
+/**
+ * @brief 汇总层快照的数据头，之后依次是小时、日、月三层的聚合数组
+ * @description 用数据日志中最后一条已计入记录的内容校验快照与日志是否对应
+ */
+typedef struct {
+    int32_t covered;               // 已计入的数据日志记录数（含待删除的记录）
+    int32_t pending;               // 已折叠、尚待从日志开头删除的记录数
+    int64_t folded;                // 已折叠的记录数
+    uint32_t last_timestamp;       // 第 covered 条记录的时间戳
+    int32_t last_amount;           // 第 covered 条记录的喝水量
+    int32_t base[ROLLUP_LEVELS];   // 各层的起始键
+    int32_t count[ROLLUP_LEVELS];  // 各层的键数
+} RollupFileHeader;
+
+/* ==================== 汇总层管理函数 ==================== */
+
+/**
+ * @brief 初始化汇总层
+ */
+void rollup_init(Rollup *rollup) {
+    if (!rollup) return;
+
+    memset(rollup, 0, sizeof(Rollup));
+}
+
+/**
+ * @brief 释放汇总层
+ */
+void rollup_free(Rollup *rollup) {
+    if (!rollup) return;
+
+    for (int level = 0; level < ROLLUP_LEVELS; level++) {
+        free(rollup->tiers[level].cells);
+    }
+    rollup_init(rollup);
+}
+
+/**
+ * @brief 清空汇总层但保留已分配的内存
+ */
+void rollup_clear(Rollup *rollup) {
+    if (!rollup) return;
+
+    for (int level = 0; level < ROLLUP_LEVELS; level++) {
+        rollup->tiers[level].count = 0;
+    }
+    rollup->covered = 0;
+    rollup->pending = 0;
+    rollup->folded = 0;
+    rollup->dirty = 1;
+}
+
+/**
+ * @brief 判断汇总层是否包含记录存储中的全部记录
+ */
+int rollup_ready(const Rollup *rollup, const RecordStore *store) {
+    if (!rollup || !store) return 0;
+    return rollup->loaded && rollup->pending == 0 && rollup->covered == store->count;
+}
+
+/* ==================== 汇总键函数 ==================== */
+
+/**
+ * @brief 时间戳在小时层中的键
+ * @param day 时间戳所在的天号
+ * @description 按距当天零点的整小时数划分，与区间查询的小时桶一致
+ */
+int rollup_hour_key(int day, time_t timestamp) {
+    long long hour = (long long)(timestamp - day_start_time(day)) / 3600;
+    if (hour < 0) hour = 0;
+    if (hour >= ROLLUP_DAY_HOURS) hour = ROLLUP_DAY_HOURS - 1;
+    return day * ROLLUP_DAY_HOURS + (int)hour;
+}
+
+/**
+ * @brief 天号所在自然月在月层中的键
+ */
+int rollup_month_key(int day) {
+    struct tm tm_info;
+    day_number_to_tm(day, &tm_info);
+    return (tm_info.tm_year + 1900) * 12 + tm_info.tm_mon;
+}
+
+/* ==================== 聚合更新函数 ==================== */
+
+/**
+ * @brief 扩展一层使其覆盖指定键
+ */
+static int tier_cover(RollupTier *tier, int key) {
+    if (tier->count == 0) {
+        tier->base = key;
+    }
+
+    // 早于当前起始键的记录很少见（例如系统时间被回拨），整体后移即可
+    int prepend = key < tier->base ? tier->base - key : 0;
+    int needed = tier->count + prepend;
+    if (key - tier->base + 1 > needed) {
+        needed = key - tier->base + 1;
+    }
+
+    if (needed > tier->capacity) {
+        int new_capacity = tier->capacity > 0 ? tier->capacity : 64;
+        while (new_capacity < needed) {
+            new_capacity *= 2;
+        }
+
+        RollupCell *cells = realloc(tier->cells, (size_t)new_capacity * sizeof(RollupCell));
+        if (!cells) return -1;
+        tier->cells = cells;
+        tier->capacity = new_capacity;
+    }
+
+    if (prepend > 0) {
+        memmove(&tier->cells[prepend], &tier->cells[0], (size_t)tier->count * sizeof(RollupCell));
+        memset(&tier->cells[0], 0, (size_t)prepend * sizeof(RollupCell));
+        tier->base = key;
+        tier->count += prepend;
+    }
+
+    if (needed > tier->count) {
+        memset(&tier->cells[tier->count], 0, (size_t)(needed - tier->count) * sizeof(RollupCell));
+        tier->count = needed;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief 将一条记录计入一层
+ */
+static int tier_add(RollupTier *tier, int key, int amount) {
+    if ((key < tier->base || key >= tier->base + tier->count) && tier_cover(tier, key) != 0) {
+        return -1;
+    }
+
+    RollupCell *cell = &tier->cells[key - tier->base];
+    uint16_t value = (uint16_t)(amount > UINT16_MAX ? UINT16_MAX : amount);
+    if (cell->count == 0 || value < cell->min) cell->min = value;
+    if (cell->count == 0 || value > cell->max) cell->max = value;
+    cell->sum += amount;
+    cell->count++;
+    return 0;
+}
+
+/**
+ * @brief 将存储中尚未计入的记录计入汇总层
+ * @description 记录通常按时间顺序排列，同一天的记录复用当天的零点和月份，
+ *              每条记录只需一次减法和三次数组更新
+ */
+int rollup_sync(Rollup *rollup, const RecordStore *store) {
+    if (!rollup || !store) return -1;
+
+    int day = 0, month = 0;
+    time_t day_start = 0, next_start = 0;
+
+    while (rollup->covered < store->count) {
+        const WaterRecord *record = record_store_at(store, rollup->covered);
+        time_t timestamp = (time_t)record->timestamp;
+
+        if (next_start == 0 || timestamp < day_start || timestamp >= next_start) {
+            day = timestamp_to_day(timestamp);
+            day_start = day_start_time(day);
+            next_start = day_start_time(day + 1);
+            month = rollup_month_key(day);
+        }
+
+        long long hour = (long long)(timestamp - day_start) / 3600;
+        if (hour >= ROLLUP_DAY_HOURS) hour = ROLLUP_DAY_HOURS - 1;
+
+        if (tier_add(&rollup->tiers[ROLLUP_HOUR], day * ROLLUP_DAY_HOURS + (int)hour, record->amount) != 0 ||
+            tier_add(&rollup->tiers[ROLLUP_DAY], day, record->amount) != 0 ||
+            tier_add(&rollup->tiers[ROLLUP_MONTH], month, record->amount) != 0) {
+            return -1;
+        }
+        rollup->covered++;
+        rollup->dirty = 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief 查询一层中某个键的聚合
+ * @return 该时间段没有记录时返回NULL
+ */
+const RollupCell *rollup_cell(const Rollup *rollup, RollupLevel level, int key) {
+    if (!rollup || level < 0 || level >= ROLLUP_LEVELS) return NULL;
+
+    const RollupTier *tier = &rollup->tiers[level];
+    if (key < tier->base || key >= tier->base + tier->count) {
+        return NULL;
+    }
+
+    const RollupCell *cell = &tier->cells[key - tier->base];
+    return cell->count > 0 ? cell : NULL;
+}
+
+/**
+ * @brief 已折叠记录的时间上限
+ * @description 折叠按整天切分数据日志，日志中第一条记录所在日的零点之前的记录只存在于汇总层；
+ *              日志中的记录已全部折叠时取小时层最后一天的次日零点
+ * @return 没有折叠过记录时返回0
+ */
+time_t rollup_fold_horizon(const Rollup *rollup, const RecordStore *store) {
+    if (!rollup || !store || rollup->folded <= 0) return 0;
+
+    if (store->count > 0) {
+        return day_start_time(timestamp_to_day((time_t)record_store_at(store, 0)->timestamp));
+    }
+
+    const RollupTier *tier = &rollup->tiers[ROLLUP_HOUR];
+    if (tier->count == 0) return 0;
+    return day_start_time((tier->base + tier->count - 1) / ROLLUP_DAY_HOURS + 1);
+}
+
+/**
+ * @brief 判断时间戳是否切开了小时层中一个有记录的小时
+ */
+static int splits_hour(const Rollup *rollup, time_t timestamp) {
+    int day = timestamp_to_day(timestamp);
+    int key = rollup_hour_key(day, timestamp);
+    time_t hour_start = day_start_time(day) + (time_t)(key - day * ROLLUP_DAY_HOURS) * 3600;
+    return timestamp != hour_start && rollup_cell(rollup, ROLLUP_HOUR, key) != NULL;
+}
+
+/**
+ * @brief 由小时层聚合 [from, to) 时间段
+ * @description 起止时间所在的小时没有记录时不必对齐到整点
+ * @return 起止时间落在有记录的小时中间、无法精确拆分时返回-1
+ */
+int rollup_aggregate(const Rollup *rollup, time_t from, time_t to, RangeAggregate *out) {
+    if (!rollup || !out) return -1;
+
+    memset(out, 0, sizeof(RangeAggregate));
+    if (from >= to) return 0;
+    if (splits_hour(rollup, from) || splits_hour(rollup, to)) return -1;
+
+    const RollupTier *tier = &rollup->tiers[ROLLUP_HOUR];
+    int first = rollup_hour_key(timestamp_to_day(from), from) - tier->base;
+    int end = rollup_hour_key(timestamp_to_day(to), to) - tier->base;
+    if (first < 0) first = 0;
+    if (end > tier->count) end = tier->count;
+
+    for (int i = first; i < end; i++) {
+        const RollupCell *cell = &tier->cells[i];
+        if (cell->count == 0) continue;
+        if (out->count == 0 || cell->min < out->min) out->min = cell->min;
+        if (out->count == 0 || cell->max > out->max) out->max = cell->max;
+        out->sum += cell->sum;
+        out->count += cell->count;
+    }
+    return 0;
+}
+
+/* ==================== 持久化函数 ==================== */
+
+/**
+ * @brief 判断存储中第 count 条记录是否与快照记下的一致
+ */
+static int record_matches(const RecordStore *store, long long count, const RollupFileHeader *header) {
+    if (count < 0 || count > store->count) return 0;
+    if (count == 0) return 1;
+
+    const WaterRecord *record = record_store_at(store, (int)count - 1);
+    return record->timestamp == header->last_timestamp && record->amount == header->last_amount;
+}
+
+/**
+ * @brief 从快照数据恢复各层
+ */
+static int rollup_restore(Rollup *rollup, const unsigned char *payload, uint32_t size) {
+    RollupFileHeader header;
+    if (size < sizeof(header)) return -1;
+    memcpy(&header, payload, sizeof(header));
+
+    size_t offset = sizeof(header);
+    for (int level = 0; level < ROLLUP_LEVELS; level++) {
+        int count = header.count[level];
+        if (count < 0 || (size - offset) / sizeof(RollupCell) < (size_t)count) return -1;
+
+        RollupTier *tier = &rollup->tiers[level];
+        if (count > tier->capacity) {
+            RollupCell *cells = realloc(tier->cells, (size_t)count * sizeof(RollupCell));
+            if (!cells) return -1;
+            tier->cells = cells;
+            tier->capacity = count;
+        }
+        tier->base = header.base[level];
+        tier->count = count;
+        if (count > 0) {
+            memcpy(tier->cells, payload + offset, (size_t)count * sizeof(RollupCell));
+        }
+        offset += (size_t)count * sizeof(RollupCell);
+    }
+    return offset == size ? 0 : -1;
+}
+
+/**
+ * @brief 加载汇总层快照并补上快照之后追加的记录
+ * @description 快照与数据日志不对应（文件缺失、损坏或日志被替换）时由全部记录重建。
+ *              折叠过程中崩溃时按日志的实际状态完成或撤销这次折叠
+ */
+int rollup_load(Rollup *rollup, const char *path, const RecordStore *store) {
+    if (!rollup || !path || !store) return -1;
+
+    rollup_clear(rollup);
+    rollup->loaded = 1;
+
+    struct stat st;
+    int ret = SNAPSHOT_MISSING;
+    if (stat(path, &st) == 0 && st.st_size > (off_t)sizeof(SnapshotHeader) &&
+        st.st_size - (off_t)sizeof(SnapshotHeader) <= UINT32_MAX) {
+        uint32_t capacity = (uint32_t)(st.st_size - (off_t)sizeof(SnapshotHeader));
+        unsigned char *payload = malloc(capacity);
+        uint16_t version = 0;
+        uint32_t loaded = 0;
+
+        ret = payload ? snapshot_load(path, ROLLUP_FILE_MAGIC, &version, payload, capacity, &loaded)
+                      : SNAPSHOT_CORRUPT;
+        if (ret == 0 && (version != ROLLUP_FILE_VERSION || rollup_restore(rollup, payload, loaded) != 0)) {
+            ret = SNAPSHOT_CORRUPT;
+        }
+
+        if (ret == 0) {
+            RollupFileHeader header;
+            memcpy(&header, payload, sizeof(header));
+
+            if (header.covered >= header.pending && header.pending >= 0 &&
+                record_matches(store, header.covered, &header)) {
+                // 开头的记录还在日志中：折叠尚未完成，撤销这次折叠
+                rollup->covered = header.covered;
+                rollup->folded = header.folded - header.pending;
+            } else if (header.pending > 0 &&
+                       record_matches(store, (long long)header.covered - header.pending, &header)) {
+                // 日志已删除开头的记录：折叠已完成
+                rollup->covered = header.covered - header.pending;
+                rollup->folded = header.folded;
+            } else {
+                if (header.folded > 0) {
+                    log_message("汇总层与数据日志不对应，已折叠的历史汇总被丢弃");
+                }
+                ret = SNAPSHOT_FOREIGN;
+            }
+        }
+        free(payload);
+    }
+
+    if (ret != 0) {
+        if (ret == SNAPSHOT_CORRUPT) {
+            log_message("汇总层快照校验失败，由记录重建");
+        }
+        rollup_clear(rollup);
+    } else {
+        rollup->dirty = rollup->covered != store->count;
+    }
+
+    return rollup_sync(rollup, store);
+}
+
+/**
+ * @brief 保存汇总层快照
+ * @description 内容自上次保存后没有变化时不写入
+ */
+int rollup_save(Rollup *rollup, const char *path, const RecordStore *store) {
+    if (!rollup || !path || !store) return -1;
+    if (!rollup->loaded || !rollup->dirty) return 0;
+
+    RollupFileHeader header;
+    memset(&header, 0, sizeof(header));
+    header.covered = rollup->covered;
+    header.pending = rollup->pending;
+    header.folded = rollup->folded;
+    if (rollup->covered > 0 && rollup->covered <= store->count) {
+        const WaterRecord *last = record_store_at(store, rollup->covered - 1);
+        header.last_timestamp = last->timestamp;
+        header.last_amount = last->amount;
+    }
+
+    size_t size = sizeof(header);
+    for (int level = 0; level < ROLLUP_LEVELS; level++) {
+        header.base[level] = rollup->tiers[level].base;
+        header.count[level] = rollup->tiers[level].count;
+        size += (size_t)rollup->tiers[level].count * sizeof(RollupCell);
+    }
+    if (size > UINT32_MAX) return -1;
+
+    unsigned char *payload = malloc(size);
+    if (!payload) return -1;
+
+    memcpy(payload, &header, sizeof(header));
+    size_t offset = sizeof(header);
+    for (int level = 0; level < ROLLUP_LEVELS; level++) {
+        size_t bytes = (size_t)rollup->tiers[level].count * sizeof(RollupCell);
+        if (bytes > 0) {
+            memcpy(payload + offset, rollup->tiers[level].cells, bytes);
+        }
+        offset += bytes;
+    }
+
+    int ret = snapshot_save(path, ROLLUP_FILE_MAGIC, ROLLUP_FILE_VERSION, payload, (uint32_t)size);
+    free(payload);
+    if (ret == 0) {
+        rollup->dirty = 0;
+    }
+    return ret;
+}
@@ -0,0 +1,177 @@
+/**
+ * @file scheduler.c
+ * @brief 喝水提醒终端应用 - 提醒调度模块
+ * @author zcg
+ * @date 2024
+ * @description 按到期时间排列的最小堆，保存所有待触发的提醒：
+ *              调度、改期和取消都是 O(log n)，查看最早的提醒是 O(1)，
+ *              每个提醒记住自己在堆中的位置，无需查找即可改期或取消。
+ *              事件循环只需把定时器设到堆顶的到期时间，到期后依次弹出所有已到期的提醒
+ */
+
+#include "water_reminder.h"
+
+/* ==================== 堆维护函数 ==================== */
+
+/**
+ * @brief 把提醒放到堆中的指定位置并记下位置
+ */
+static void heap_place(ReminderScheduler *scheduler, int index, ReminderTimer *timer) {
+    scheduler->heap[index] = timer;
+    timer->heap_index = index;
+}
+
+/**
+ * @brief 将位置 index 上的提醒向堆顶方向调整
+ */
+static void sift_up(ReminderScheduler *scheduler, int index) {
+    ReminderTimer *timer = scheduler->heap[index];
+
+    while (index > 0) {
+        int parent = (index - 1) / 2;
+        if (scheduler->heap[parent]->due <= timer->due) break;
+        heap_place(scheduler, index, scheduler->heap[parent]);
+        index = parent;
+    }
+    heap_place(scheduler, index, timer);
+}
+
+/**
+ * @brief 将位置 index 上的提醒向堆底方向调整
+ */
+static void sift_down(ReminderScheduler *scheduler, int index) {
+    ReminderTimer *timer = scheduler->heap[index];
+
+    for (;;) {
+        int child = index * 2 + 1;
+        if (child >= scheduler->count) break;
+        if (child + 1 < scheduler->count &&
+            scheduler->heap[child + 1]->due < scheduler->heap[child]->due) {
+            child++;
+        }
+        if (timer->due <= scheduler->heap[child]->due) break;
+        heap_place(scheduler, index, scheduler->heap[child]);
+        index = child;
+    }
+    heap_place(scheduler, index, timer);
+}
+
+/**
+ * @brief 从堆中移除位置 index 上的提醒
+ */
+static void heap_remove(ReminderScheduler *scheduler, int index) {
+    ReminderTimer *removed = scheduler->heap[index];
+    ReminderTimer *last = scheduler->heap[--scheduler->count];
+    removed->heap_index = -1;
+
+    if (index == scheduler->count) return;
+
+    // 用堆尾的提醒填补空位，再按它与原位置的大小关系向上或向下调整
+    heap_place(scheduler, index, last);
+    if (index > 0 && scheduler->heap[(index - 1) / 2]->due > last->due) {
+        sift_up(scheduler, index);
+    } else {
+        sift_down(scheduler, index);
+    }
+}
+
+/* ==================== 调度接口 ==================== */
+
+/**
+ * @brief 初始化提醒（尚未调度）
+ * @param owner 提醒所属的对象，到期时由调用方取回
+ */
+void reminder_timer_init(ReminderTimer *timer, void *owner) {
+    if (!timer) return;
+
+    timer->due = 0;
+    timer->heap_index = -1;
+    timer->owner = owner;
+}
+
+/**
+ * @brief 初始化调度器
+ */
+void scheduler_init(ReminderScheduler *scheduler) {
+    if (!scheduler) return;
+
+    scheduler->heap = NULL;
+    scheduler->count = 0;
+    scheduler->capacity = 0;
+}
+
+/**
+ * @brief 释放调度器（不释放其中的提醒）
+ */
+void scheduler_free(ReminderScheduler *scheduler) {
+    if (!scheduler) return;
+
+    for (int i = 0; i < scheduler->count; i++) {
+        scheduler->heap[i]->heap_index = -1;
+    }
+    free(scheduler->heap);
+    scheduler_init(scheduler);
+}
+
+/**
+ * @brief 调度提醒在指定时间到期
+ * @description 提醒已在调度中时改期，只需沿堆向上或向下调整一次
+ * @return 内存不足时返回-1
+ */
+int scheduler_schedule(ReminderScheduler *scheduler, ReminderTimer *timer, time_t due) {
+    if (!scheduler || !timer) return -1;
+
+    if (timer->heap_index >= 0) {
+        time_t old_due = timer->due;
+        timer->due = due;
+        if (due < old_due) {
+            sift_up(scheduler, timer->heap_index);
+        } else if (due > old_due) {
+            sift_down(scheduler, timer->heap_index);
+        }
+        return 0;
+    }
+
+    if (scheduler->count == scheduler->capacity) {
+        int new_capacity = scheduler->capacity > 0 ? scheduler->capacity * 2 : SCHEDULER_INITIAL_CAPACITY;
+        ReminderTimer **heap = realloc(scheduler->heap, (size_t)new_capacity * sizeof(ReminderTimer *));
+        if (!heap) return -1;
+        scheduler->heap = heap;
+        scheduler->capacity = new_capacity;
+    }
+
+    timer->due = due;
+    heap_place(scheduler, scheduler->count++, timer);
+    sift_up(scheduler, timer->heap_index);
+    return 0;
+}
+
+/**
+ * @brief 取消提醒（未调度时什么也不做）
+ */
+void scheduler_cancel(ReminderScheduler *scheduler, ReminderTimer *timer) {
+    if (!scheduler || !timer || timer->heap_index < 0) return;
+
+    heap_remove(scheduler, timer->heap_index);
+}
+
+/**
+ * @brief 查看最早到期的提醒
+ * @return 没有待触发的提醒时返回NULL
+ */
+ReminderTimer *scheduler_peek(const ReminderScheduler *scheduler) {
+    if (!scheduler || scheduler->count == 0) return NULL;
+    return scheduler->heap[0];
+}
+
+/**
+ * @brief 弹出一个在 now 之前（含）到期的提醒
+ * @return 没有已到期的提醒时返回NULL
+ */
+ReminderTimer *scheduler_pop_due(ReminderScheduler *scheduler, time_t now) {
+    if (!scheduler || scheduler->count == 0 || scheduler->heap[0]->due > now) return NULL;
+
+    ReminderTimer *timer = scheduler->heap[0];
+    heap_remove(scheduler, 0);
+    return timer;
+}
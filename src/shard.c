@@ -0,0 +1,498 @@
+/**
+ * @file shard.c
+ * @brief 喝水提醒终端应用 - 用户分片模块
+ * @author zcg
+ * @date 2024
+ * @description 守护进程中每个用户的配置、记录和聚合数据是一个独立分片：
+ *              首次访问时才从该用户的数据文件加载，超过驻留上限时按最近最少使用淘汰，
+ *              内存开销只与活跃用户数有关。
+ *              每个用户另有一个很小的提醒调度项（上次提醒时间、间隔、暂停状态），
+ *              启动时为数据目录中的所有用户建立，分片被淘汰后仍留在调度器中，
+ *              未加载的用户到期时才加载分片；上次提醒时间随配置保存，重新加载不会重置调度。
+ *              事件循环每轮只重新计算本轮被访问过的分片，不再扫描所有分片
+ */
+
+#include "water_reminder.h"
+#include <errno.h>
+#include <dirent.h>
+#include <sys/timerfd.h>
+
+/**
+ * @brief 一个用户的提醒调度项，分片被淘汰后仍然保留
+ */
+typedef struct ReminderEntry {
+    char user[USER_NAME_MAX];      // 用户名（空字符串表示默认用户）
+    time_t last_reminder;          // 上次提醒时间（0表示从未提醒过）
+    time_t first_check;            // 建立调度项后的首次提醒时间
+    int interval;                  // 提醒间隔（分钟）
+    int paused;                    // 暂停状态
+    ReminderTimer timer;           // 下一次提醒
+    struct UserShard *shard;       // 已加载的分片，未加载时为NULL
+    struct ReminderEntry *hash_next; // 同一个桶中的下一个调度项
+} ReminderEntry;
+
+/**
+ * @brief 一个已加载的用户分片
+ */
+typedef struct UserShard {
+    AppState *state;               // 用户状态
+    ReminderEntry *entry;          // 该用户的提醒调度项
+    int pinned;                    // 常驻分片（默认用户），不会被淘汰
+    int stale;                     // 提醒时间可能已变化，等待重新调度
+    struct UserShard *stale_next;  // 等待重新调度的下一个分片
+    struct UserShard *hash_next;   // 同一个桶中的下一个分片
+    struct UserShard *lru_prev;    // 最近使用链表（表头为最近使用）
+    struct UserShard *lru_next;
+} UserShard;
+
+/**
+ * @brief 分片管理状态
+ */
+static struct {
+    UserShard *buckets[SHARD_HASH_SIZE]; // 按用户名散列的查找表
+    UserShard *lru_head;           // 最近使用的分片
+    UserShard *lru_tail;           // 最久未使用的分片
+    UserShard *default_shard;      // 默认用户的常驻分片
+    UserShard *stale_head;         // 等待重新调度的分片
+    ReminderEntry *entries[SHARD_HASH_SIZE]; // 所有用户的提醒调度项（按用户名散列）
+    ReminderScheduler scheduler;   // 所有用户的下一次提醒
+    int loaded;                    // 已加载的分片数
+    int timer_fd;                  // 提醒定时器
+    time_t armed_at;               // 定时器当前设置的到期时间（0表示未设置）
+} g_shards = { .timer_fd = -1 };
+
+/* ==================== 查找表和链表函数 ==================== */
+
+/**
+ * @brief 用户名散列（FNV-1a）
+ */
+static unsigned int shard_hash(const char *user) {
+    unsigned int hash = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *)user; *p; p++) {
+        hash = (hash ^ *p) * 16777619u;
+    }
+    return hash % SHARD_HASH_SIZE;
+}
+
+/**
+ * @brief 从最近使用链表中摘下分片
+ */
+static void lru_unlink(UserShard *shard) {
+    if (shard->lru_prev) shard->lru_prev->lru_next = shard->lru_next;
+    else g_shards.lru_head = shard->lru_next;
+    if (shard->lru_next) shard->lru_next->lru_prev = shard->lru_prev;
+    else g_shards.lru_tail = shard->lru_prev;
+    shard->lru_prev = shard->lru_next = NULL;
+}
+
+/**
+ * @brief 将分片放到最近使用链表表头
+ */
+static void lru_push_front(UserShard *shard) {
+    shard->lru_next = g_shards.lru_head;
+    if (g_shards.lru_head) g_shards.lru_head->lru_prev = shard;
+    g_shards.lru_head = shard;
+    if (!g_shards.lru_tail) g_shards.lru_tail = shard;
+}
+
+/* ==================== 提醒调度项函数 ==================== */
+
+/**
+ * @brief 查找用户的提醒调度项
+ */
+static ReminderEntry *entry_find(const char *user) {
+    for (ReminderEntry *entry = g_shards.entries[shard_hash(user)]; entry; entry = entry->hash_next) {
+        if (strcmp(entry->user, user) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief 按用户配置建立提醒调度项
+ * @return 内存不足时返回NULL
+ */
+static ReminderEntry *entry_create(const char *user, const UserConfig *config) {
+    ReminderEntry *entry = calloc(1, sizeof(ReminderEntry));
+    if (!entry) return NULL;
+
+    snprintf(entry->user, sizeof(entry->user), "%s", user);
+    entry->last_reminder = (time_t)config->last_reminder;
+    entry->first_check = time(NULL) + 60;
+    entry->interval = config->reminder_interval;
+    reminder_timer_init(&entry->timer, entry);
+
+    unsigned int bucket = shard_hash(user);
+    entry->hash_next = g_shards.entries[bucket];
+    g_shards.entries[bucket] = entry;
+    return entry;
+}
+
+/**
+ * @brief 计算调度项的下一次提醒时间
+ * @description 守护进程刚启动或刚建立调度项时不早于首次提醒时间，
+ *              停机期间错过的提醒在启动一分钟后补发一次
+ * @return 暂停时返回0
+ */
+static time_t entry_due_time(const ReminderEntry *entry) {
+    if (entry->paused) return 0;
+
+    time_t due = entry->last_reminder + (time_t)entry->interval * 60;
+    if (entry->last_reminder == 0 || due < entry->first_check) {
+        due = entry->first_check;
+    }
+    return due;
+}
+
+/**
+ * @brief 按调度项重新调度下一次提醒
+ * @return 内存不足时返回-1
+ */
+static int entry_schedule(ReminderEntry *entry) {
+    time_t due = entry_due_time(entry);
+    if (due == 0) {
+        scheduler_cancel(&g_shards.scheduler, &entry->timer);
+        return 0;
+    }
+    return scheduler_schedule(&g_shards.scheduler, &entry->timer, due);
+}
+
+/**
+ * @brief 用分片的当前状态更新调度项
+ * @description 请求可能修改了暂停状态或提醒间隔
+ */
+static void entry_update(ReminderEntry *entry, const AppState *app) {
+    entry->last_reminder = app->last_reminder;
+    entry->interval = app->config.reminder_interval;
+    entry->paused = app->paused;
+}
+
+/**
+ * @brief 为数据目录中的所有用户建立提醒调度项
+ * @description 只读取各用户的配置，分片在首次访问或提醒到期时才加载
+ */
+static void entry_scan_users(void) {
+    DIR *dir = opendir(USER_DATA_DIR);
+    if (!dir) return;
+
+    AppState *probe = malloc(sizeof(AppState));
+    struct dirent *item;
+    while (probe && (item = readdir(dir)) != NULL) {
+        const char *user = item->d_name;
+        if (!user_name_valid(user) || entry_find(user) || app_state_init(probe, user) != 0) {
+            continue;
+        }
+
+        load_config(&probe->config, probe->config_path);
+        ReminderEntry *entry = entry_create(user, &probe->config);
+        if (!entry || entry_schedule(entry) != 0) {
+            log_message("内存不足，部分用户的提醒未能调度");
+            break;
+        }
+    }
+
+    free(probe);
+    closedir(dir);
+}
+
+/* ==================== 分片加载和卸载函数 ==================== */
+
+/**
+ * @brief 标记分片的提醒时间需要重新计算
+ * @description 请求可能修改暂停状态或提醒间隔，下一轮事件循环前统一重新调度
+ */
+static void shard_mark_stale(UserShard *shard) {
+    if (shard->stale) return;
+    shard->stale = 1;
+    shard->stale_next = g_shards.stale_head;
+    g_shards.stale_head = shard;
+}
+
+/**
+ * @brief 将分片加入查找表和链表，并关联该用户的提醒调度项
+ * @description 重新加载被淘汰过的用户时沿用调度项中的上次提醒时间和暂停状态
+ * @return 内存不足时返回-1
+ */
+static int shard_insert(UserShard *shard) {
+    AppState *app = shard->state;
+    ReminderEntry *entry = entry_find(app->user);
+    if (!entry) {
+        entry = entry_create(app->user, &app->config);
+        if (!entry) return -1;
+    }
+    entry->shard = shard;
+    shard->entry = entry;
+    app->last_reminder = entry->last_reminder;
+    app->paused = entry->paused;
+
+    unsigned int bucket = shard_hash(app->user);
+    shard->hash_next = g_shards.buckets[bucket];
+    g_shards.buckets[bucket] = shard;
+    lru_push_front(shard);
+    shard_mark_stale(shard);
+    g_shards.loaded++;
+    return 0;
+}
+
+/**
+ * @brief 在查找表中查找已加载的分片
+ */
+static UserShard *shard_find(const char *user) {
+    for (UserShard *shard = g_shards.buckets[shard_hash(user)]; shard; shard = shard->hash_next) {
+        if (strcmp(shard->state->user, user) == 0) {
+            return shard;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief 保存并卸载一个分片
+ * @description 调度项和其中的提醒留在调度器中，到期时再重新加载
+ */
+static void shard_evict(UserShard *shard) {
+    UserShard **link = &g_shards.buckets[shard_hash(shard->state->user)];
+    while (*link != shard) {
+        link = &(*link)->hash_next;
+    }
+    *link = shard->hash_next;
+    lru_unlink(shard);
+
+    ReminderEntry *entry = shard->entry;
+    entry_update(entry, shard->state);
+    entry->shard = NULL;
+    if (shard->stale) {
+        UserShard **stale = &g_shards.stale_head;
+        while (*stale != shard) {
+            stale = &(*stale)->stale_next;
+        }
+        *stale = shard->stale_next;
+        if (entry_schedule(entry) != 0) {
+            log_message("内存不足，卸载用户的提醒未能重新调度");
+        }
+    }
+    g_shards.loaded--;
+
+    if (!shard->pinned) {
+        char log_msg[100];
+        snprintf(log_msg, sizeof(log_msg), "用户分片已卸载: %s", shard->state->user);
+        log_message(log_msg);
+
+        app_state_free(shard->state);
+        free(shard->state);
+    }
+    free(shard);
+}
+
+/* ==================== 分片管理接口 ==================== */
+
+/**
+ * @brief 初始化分片管理，默认用户的状态作为常驻分片
+ */
+int shard_init(AppState *default_app) {
+    if (!default_app) return -1;
+
+    g_shards.timer_fd = timerfd_create(CLOCK_REALTIME, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (g_shards.timer_fd < 0) {
+        perror("创建timerfd失败");
+        return -1;
+    }
+    scheduler_init(&g_shards.scheduler);
+
+    UserShard *shard = calloc(1, sizeof(UserShard));
+    if (!shard) return -1;
+    shard->state = default_app;
+    shard->pinned = 1;
+    if (shard_insert(shard) != 0) {
+        free(shard);
+        return -1;
+    }
+    g_shards.default_shard = shard;
+    entry_scan_users();
+    return 0;
+}
+
+/**
+ * @brief 获取用户的状态，未加载时从数据文件加载
+ * @param user 用户名，空字符串表示默认用户
+ * @return 用户名无效或加载失败时返回NULL
+ */
+AppState *shard_get(const char *user) {
+    if (!user) return NULL;
+
+    // 空用户名总是指向默认分片（以 --user 启动时默认分片也有用户名）
+    if (user[0] == '\0' && g_shards.default_shard) {
+        user = g_shards.default_shard->state->user;
+    }
+
+    UserShard *shard = shard_find(user);
+    if (shard) {
+        if (g_shards.lru_head != shard) {
+            lru_unlink(shard);
+            lru_push_front(shard);
+        }
+        shard_mark_stale(shard);
+        return shard->state;
+    }
+
+    if (!user_name_valid(user)) return NULL;
+
+    // 达到驻留上限时淘汰最久未使用的非常驻分片
+    for (UserShard *victim = g_shards.lru_tail;
+         victim && g_shards.loaded >= SHARD_MAX_LOADED; ) {
+        UserShard *prev = victim->lru_prev;
+        if (!victim->pinned) {
+            shard_evict(victim);
+        }
+        victim = prev;
+    }
+
+    shard = calloc(1, sizeof(UserShard));
+    AppState *state = malloc(sizeof(AppState));
+    if (!shard || !state || app_state_init(state, user) != 0) {
+        free(shard);
+        free(state);
+        return NULL;
+    }
+
+    state->headless = 1;
+    if (app_state_load(state) != 0) {
+        app_state_free(state);
+        free(state);
+        free(shard);
+        return NULL;
+    }
+
+    shard->state = state;
+    if (shard_insert(shard) != 0) {
+        app_state_free(state);
+        free(state);
+        free(shard);
+        return NULL;
+    }
+
+    char log_msg[100];
+    snprintf(log_msg, sizeof(log_msg), "用户分片已加载: %s (%d条记录)", user, state->records.count);
+    log_message(log_msg);
+    return state;
+}
+
+/**
+ * @brief 卸载所有分片，默认用户的状态由调用方负责释放
+ */
+void shard_shutdown(void) {
+    while (g_shards.lru_head) {
+        shard_evict(g_shards.lru_head);
+    }
+    g_shards.default_shard = NULL;
+    g_shards.stale_head = NULL;
+    scheduler_free(&g_shards.scheduler);
+    for (int bucket = 0; bucket < SHARD_HASH_SIZE; bucket++) {
+        while (g_shards.entries[bucket]) {
+            ReminderEntry *entry = g_shards.entries[bucket];
+            g_shards.entries[bucket] = entry->hash_next;
+            free(entry);
+        }
+    }
+
+    if (g_shards.timer_fd >= 0) {
+        close(g_shards.timer_fd);
+        g_shards.timer_fd = -1;
+    }
+    g_shards.armed_at = 0;
+}
+
+/**
+ * @brief 跨过零点时切换所有已加载分片的今日统计
+ */
+void shard_day_rollover(int today) {
+    for (UserShard *shard = g_shards.lru_head; shard; shard = shard->lru_next) {
+        today_stats_rollover(shard->state, today);
+    }
+}
+
+/* ==================== 提醒调度函数 ==================== */
+
+/**
+ * @brief 准备提醒定时器，到期时间为所有用户中最早的一个
+ * @description 只重新调度被标记的分片，最早的提醒直接取调度器堆顶
+ * @return 填入 fd 的描述符个数（1）
+ */
+int shard_poll_prepare(struct pollfd *fd) {
+    while (g_shards.stale_head) {
+        UserShard *shard = g_shards.stale_head;
+        g_shards.stale_head = shard->stale_next;
+        shard->stale_next = NULL;
+        shard->stale = 0;
+
+        entry_update(shard->entry, shard->state);
+        if (entry_schedule(shard->entry) != 0) {
+            // 内存不足时留到下一轮再试，最多推迟一个事件循环周期
+            shard_mark_stale(shard);
+            break;
+        }
+    }
+
+    const ReminderTimer *next = scheduler_peek(&g_shards.scheduler);
+    time_t earliest = next ? next->due : 0;
+
+    if (earliest != g_shards.armed_at) {
+        struct itimerspec spec;
+        memset(&spec, 0, sizeof(spec));
+        spec.it_value.tv_sec = earliest;
+        if (timerfd_settime(g_shards.timer_fd, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET,
+                            &spec, NULL) == 0) {
+            g_shards.armed_at = earliest;
+        }
+    }
+
+    fd->fd = g_shards.timer_fd;
+    fd->events = POLLIN;
+    fd->revents = 0;
+    return 1;
+}
+
+/**
+ * @brief 为所有到期的用户发送提醒
+ * @description 依次弹出已到期的提醒，未加载的用户此时才加载分片，发送后的分片在下一轮重新调度
+ */
+void shard_poll_dispatch(const struct pollfd *fd) {
+    if (!(fd->revents & POLLIN)) return;
+
+    uint64_t expirations;
+    if (read(g_shards.timer_fd, &expirations, sizeof(expirations)) < 0 && errno != ECANCELED) {
+        return;
+    }
+    g_shards.armed_at = 0;
+
+    time_t now = time(NULL);
+    ReminderTimer *timer;
+    while ((timer = scheduler_pop_due(&g_shards.scheduler, now)) != NULL) {
+        ReminderEntry *entry = timer->owner;
+        if (!entry->shard && !shard_get(entry->user)) {
+            // 加载失败时一分钟后再试
+            char log_msg[100];
+            snprintf(log_msg, sizeof(log_msg), "加载用户分片失败，推迟提醒: %s", entry->user);
+            log_message(log_msg);
+            scheduler_schedule(&g_shards.scheduler, &entry->timer, now + 60);
+            continue;
+        }
+
+        UserShard *shard = entry->shard;
+        AppState *app = shard->state;
+        shard_mark_stale(shard);
+        if (!should_remind(app)) continue;
+        METRIC_DELAY(METRIC_REMINDER_JITTER, timer->due);
+
+        char log_msg[100];
+        snprintf(log_msg, sizeof(log_msg), "发送喝水提醒: %s",
+                 app->user[0] ? app->user : "默认用户");
+        log_message(log_msg);
+        if (app->config.sound_enabled) {
+            play_sound_effect();
+        }
+        app->last_reminder = now;
+        app->config.last_reminder = (int64_t)now;
+    }
+}
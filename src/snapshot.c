@@ -0,0 +1,232 @@
+/**
+ * @file snapshot.c
+ * @brief 喝水提醒终端应用 - 原子快照写入模块
+ * @author zcg
+ * @date 2024
+ * @description 整体重写的文件（配置、数据日志压缩）都经过这里：先写临时文件并 fsync，
+ *              再用 rename 原子替换并 fsync 所在目录，任何时刻崩溃或收到信号，
+ *              磁盘上的文件要么是旧内容要么是完整的新内容。
+ *              带校验头的快照在内容未变化时完全跳过写入
+ */
+
+#include "water_reminder.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+static uint32_t g_crc_table[8][256];
+static pthread_once_t g_crc_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief 生成 CRC-32（IEEE 802.3）查找表
+ * @description g_crc_table[k][b] 是字节 b 之后再经过 k 个零字节的余数，
+ *              8张表可以一次查表处理8个字节
+ */
+static void crc32_init_table(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+        }
+        g_crc_table[0][i] = crc;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        for (int k = 1; k < 8; k++) {
+            uint32_t prev = g_crc_table[k - 1][i];
+            g_crc_table[k][i] = g_crc_table[0][prev & 0xFF] ^ (prev >> 8);
+        }
+    }
+}
+
+/**
+ * @brief 计算数据的 CRC-32 校验值
+ * @description 每次处理8个字节（slicing-by-8），汇总层等较大的快照在启动时校验更快；
+ *              逐字节组合成整数，结果与字节序无关
+ */
+uint32_t snapshot_checksum(const void *data, size_t size) {
+    pthread_once(&g_crc_once, crc32_init_table);
+
+    const unsigned char *p = data;
+    uint32_t crc = 0xFFFFFFFFu;
+    while (size >= 8) {
+        uint32_t low = crc ^ ((uint32_t)p[0] | (uint32_t)p[1] << 8 |
+                              (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24);
+        crc = g_crc_table[7][low & 0xFF] ^ g_crc_table[6][(low >> 8) & 0xFF] ^
+              g_crc_table[5][(low >> 16) & 0xFF] ^ g_crc_table[4][low >> 24] ^
+              g_crc_table[3][p[4]] ^ g_crc_table[2][p[5]] ^
+              g_crc_table[1][p[6]] ^ g_crc_table[0][p[7]];
+        p += 8;
+        size -= 8;
+    }
+    while (size-- > 0) {
+        crc = g_crc_table[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+/**
+ * @brief 同步文件所在目录，使 rename 本身落盘
+ */
+static void sync_parent_directory(const char *path) {
+    char dir[APP_PATH_MAX];
+    const char *slash = strrchr(path, '/');
+
+    if (!slash) {
+        strcpy(dir, ".");
+    } else if ((size_t)(slash - path) < sizeof(dir)) {
+        memcpy(dir, path, (size_t)(slash - path));
+        dir[slash - path] = '\0';
+    } else {
+        return;
+    }
+
+    int fd = open(dir[0] ? dir : "/", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+/**
+ * @brief 原子替换文件内容
+ * @param write_fn 向临时文件写入完整内容的回调，成功返回0
+ * @description 临时文件写完并 fsync 后才重命名为目标文件；任何一步失败都删除临时文件，
+ *              原文件保持不变
+ */
+int snapshot_replace(const char *path, int (*write_fn)(FILE *file, const void *ctx), const void *ctx) {
+    if (!path || !write_fn) return -1;
+
+    char tmp_path[APP_PATH_MAX + 8];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+    FILE *file = fopen(tmp_path, "wb");
+    if (!file) {
+        perror("创建临时文件失败");
+        return -1;
+    }
+
+    int ret = write_fn(file, ctx);
+    if (fflush(file) != 0 || fsync(fileno(file)) != 0) {
+        ret = -1;
+    }
+    if (fclose(file) != 0) {
+        ret = -1;
+    }
+    if (ret != 0) {
+        remove(tmp_path);
+        return -1;
+    }
+
+    if (rename(tmp_path, path) != 0) {
+        perror("替换文件失败");
+        remove(tmp_path);
+        return -1;
+    }
+
+    sync_parent_directory(path);
+    return 0;
+}
+
+/* ==================== 带校验头的快照 ==================== */
+
+/**
+ * @brief 快照内容（文件头和数据）
+ */
+typedef struct {
+    const SnapshotHeader *header;
+    const void *payload;
+} SnapshotContent;
+
+/**
+ * @brief 写入快照文件头和数据
+ */
+static int write_snapshot_content(FILE *file, const void *ctx) {
+    const SnapshotContent *content = ctx;
+
+    if (fwrite(content->header, sizeof(SnapshotHeader), 1, file) != 1) return -1;
+    if (content->header->payload_size > 0 &&
+        fwrite(content->payload, content->header->payload_size, 1, file) != 1) {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 读取并校验已有快照的文件头
+ * @return 是指定类型的快照时返回0
+ */
+static int read_snapshot_header(FILE *file, const char *magic, SnapshotHeader *header) {
+    if (fread(header, sizeof(SnapshotHeader), 1, file) != 1 ||
+        memcmp(header->magic, magic, sizeof(header->magic)) != 0 ||
+        header->header_size != sizeof(SnapshotHeader)) {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 以带校验头的快照格式原子保存数据
+ * @param magic 4字节的文件类型标识
+ * @description 已有文件的文件头与新内容的版本、长度和校验值都相同时不做任何写入
+ */
+int snapshot_save(const char *path, const char *magic, uint16_t version,
+                  const void *payload, uint32_t size) {
+    if (!path || !magic || (!payload && size > 0)) return -1;
+
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, magic, sizeof(header.magic));
+    header.version = version;
+    header.header_size = sizeof(SnapshotHeader);
+    header.payload_size = size;
+    header.checksum = snapshot_checksum(payload, size);
+
+    FILE *existing = fopen(path, "rb");
+    if (existing) {
+        SnapshotHeader old;
+        int unchanged = read_snapshot_header(existing, magic, &old) == 0 &&
+                        old.version == header.version &&
+                        old.payload_size == header.payload_size &&
+                        old.checksum == header.checksum;
+        fclose(existing);
+        if (unchanged) return 0;
+    }
+
+    SnapshotContent content = { &header, payload };
+    return snapshot_replace(path, write_snapshot_content, &content);
+}
+
+/**
+ * @brief 读取并校验带校验头的快照
+ * @param capacity 数据缓冲区大小，数据比缓冲区长时视为损坏
+ * @param loaded 输出实际读取的数据长度（旧版本的数据可能更短）
+ * @return 0 成功；SNAPSHOT_MISSING 文件不存在；SNAPSHOT_FOREIGN 不是该类型的快照；
+ *         SNAPSHOT_CORRUPT 长度或校验值不符
+ */
+int snapshot_load(const char *path, const char *magic, uint16_t *version,
+                  void *payload, uint32_t capacity, uint32_t *loaded) {
+    if (!path || !magic || !payload) return SNAPSHOT_CORRUPT;
+
+    FILE *file = fopen(path, "rb");
+    if (!file) return SNAPSHOT_MISSING;
+
+    SnapshotHeader header;
+    if (read_snapshot_header(file, magic, &header) != 0) {
+        fclose(file);
+        return SNAPSHOT_FOREIGN;
+    }
+
+    int ret = 0;
+    if (header.payload_size > capacity ||
+        fread(payload, 1, header.payload_size, file) != header.payload_size ||
+        snapshot_checksum(payload, header.payload_size) != header.checksum) {
+        ret = SNAPSHOT_CORRUPT;
+    }
+    fclose(file);
+
+    if (ret == 0) {
+        if (version) *version = header.version;
+        if (loaded) *loaded = header.payload_size;
+    }
+    return ret;
+}
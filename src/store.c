@@ -0,0 +1,216 @@
+/**
+ * @file store.c
+ * @brief 喝水提醒终端应用 - 记录存储模块
+ * @author zcg
+ * @date 2024
+ * @description 分块增长的喝水记录存储：数据文件中已有的记录通过 mmap 原地只读访问，
+ *              之后追加的记录按固定大小的分块存放，追加时从不移动已有记录，
+ *              历史长度只受磁盘和内存限制
+ */
+
+#include "water_reminder.h"
+#include <sys/mman.h>
+
+/**
+ * @brief 初始化记录存储
+ */
+void record_store_init(RecordStore *store) {
+    if (!store) return;
+
+    store->mapped = NULL;
+    store->mapped_count = 0;
+    store->map_base = NULL;
+    store->map_size = 0;
+    store->chunks = NULL;
+    store->chunk_count = 0;
+    store->chunk_capacity = 0;
+    store->count = 0;
+    store->sorted = 1;
+}
+
+/**
+ * @brief 解除数据文件映射
+ */
+static void record_store_unmap(RecordStore *store) {
+    if (store->map_base) {
+        munmap(store->map_base, store->map_size);
+    }
+
+    store->mapped = NULL;
+    store->mapped_count = 0;
+    store->map_base = NULL;
+    store->map_size = 0;
+}
+
+/**
+ * @brief 释放记录存储占用的内存
+ */
+void record_store_free(RecordStore *store) {
+    if (!store) return;
+
+    record_store_unmap(store);
+    for (int i = 0; i < store->chunk_count; i++) {
+        free(store->chunks[i]);
+    }
+    free(store->chunks);
+    record_store_init(store);
+}
+
+/**
+ * @brief 清空记录但保留已分配的分块
+ */
+void record_store_clear(RecordStore *store) {
+    if (!store) return;
+
+    record_store_unmap(store);
+    store->count = 0;
+    store->sorted = 1;
+}
+
+/**
+ * @brief 以只读方式映射数据文件中的记录区
+ * @description 只建立映射不读取数据，页面在首次访问时才由内核按需载入，
+ *              只能在存储为空时调用
+ * @param offset 记录区在文件中的偏移（需与记录大小对齐）
+ */
+int record_store_map(RecordStore *store, int fd, size_t offset, int count) {
+    if (!store || store->count != 0 || count <= 0) return -1;
+
+    size_t map_size = offset + (size_t)count * sizeof(WaterRecord);
+    void *base = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (base == MAP_FAILED) {
+        return -1;
+    }
+
+    store->map_base = base;
+    store->map_size = map_size;
+    store->mapped = (const WaterRecord *)((const char *)base + offset);
+    store->mapped_count = count;
+    store->count = count;
+    return 0;
+}
+
+/**
+ * @brief 确保存储中有可写入的下一个分块
+ */
+static int record_store_reserve_chunk(RecordStore *store) {
+    int chunk = (store->count - store->mapped_count) >> RECORD_CHUNK_SHIFT;
+    if (chunk < store->chunk_count) {
+        return 0;
+    }
+
+    // 分块指针数组按倍数增长，每 RECORD_CHUNK_SIZE 条记录才复制一个指针
+    if (store->chunk_count == store->chunk_capacity) {
+        int new_capacity = store->chunk_capacity > 0 ? store->chunk_capacity * 2 : 16;
+        WaterRecord **chunks = realloc(store->chunks, new_capacity * sizeof(WaterRecord *));
+        if (!chunks) return -1;
+        store->chunks = chunks;
+        store->chunk_capacity = new_capacity;
+    }
+
+    WaterRecord *block = malloc(RECORD_CHUNK_SIZE * sizeof(WaterRecord));
+    if (!block) return -1;
+
+    store->chunks[store->chunk_count++] = block;
+    return 0;
+}
+
+/**
+ * @brief 在存储末尾分配一条记录
+ * @return 新记录的指针，内存不足时返回NULL
+ */
+WaterRecord *record_store_append(RecordStore *store) {
+    if (!store) return NULL;
+
+    if (record_store_reserve_chunk(store) != 0) {
+        return NULL;
+    }
+
+    int slot = store->count - store->mapped_count;
+    WaterRecord *record = &store->chunks[slot >> RECORD_CHUNK_SHIFT]
+                                        [slot & (RECORD_CHUNK_SIZE - 1)];
+    store->count++;
+    return record;
+}
+
+/**
+ * @brief 从文件中批量读取记录追加到存储末尾
+ * @return 读取的记录数
+ */
+int record_store_read(RecordStore *store, FILE *file, int max_count) {
+    if (!store || !file) return 0;
+
+    int total = 0;
+    while (total < max_count) {
+        if (record_store_reserve_chunk(store) != 0) {
+            break;
+        }
+
+        // 每次直接读入当前分块的剩余空间
+        int slot = store->count - store->mapped_count;
+        int offset = slot & (RECORD_CHUNK_SIZE - 1);
+        int want = RECORD_CHUNK_SIZE - offset;
+        if (want > max_count - total) {
+            want = max_count - total;
+        }
+
+        WaterRecord *dest = &store->chunks[slot >> RECORD_CHUNK_SHIFT][offset];
+        int got = (int)fread(dest, sizeof(WaterRecord), want, file);
+        store->count += got;
+        total += got;
+
+        if (got < want) {
+            break;
+        }
+    }
+
+    return total;
+}
+
+/**
+ * @brief 将存储中的全部记录写入文件
+ * @return 成功写入的记录数
+ */
+int record_store_write(const RecordStore *store, FILE *file) {
+    if (!store || !file) return 0;
+
+    int written = 0;
+    if (store->mapped_count > 0) {
+        written = (int)fwrite(store->mapped, sizeof(WaterRecord), store->mapped_count, file);
+        if (written < store->mapped_count) {
+            return written;
+        }
+    }
+
+    for (int i = 0; i < store->chunk_count && written < store->count; i++) {
+        int want = store->count - written;
+        if (want > RECORD_CHUNK_SIZE) {
+            want = RECORD_CHUNK_SIZE;
+        }
+
+        int got = (int)fwrite(store->chunks[i], sizeof(WaterRecord), want, file);
+        written += got;
+
+        if (got < want) {
+            break;
+        }
+    }
+
+    return written;
+}
+
+/**
+ * @brief 查找第一条时间戳不早于 timestamp 的记录（要求记录有序）
+ * @return 记录下标，所有记录都更早时返回记录总数
+ */
+int record_store_lower_bound(const RecordStore *store, time_t timestamp) {
+    if (!store) return 0;
+
+    int lo = 0, hi = store->count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if ((time_t)record_store_at(store, mid)->timestamp < timestamp) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
@@ -0,0 +1,312 @@
+/**
+ * @file transfer.c
+ * @brief 喝水提醒终端应用 - 数据导入导出模块
+ * @author zcg
+ * @date 2024
+ * @description 以 CSV 或 JSON Lines 格式流式导入导出喝水记录：
+ *              导入逐行解析并按批追加到数据日志，每批只写入一次，按用户的持久性级别提交，
+ *              内存占用只有一个批次，与文件行数无关；导出按顺序逐条格式化输出
+ */
+
+#include "water_reminder.h"
+#include <errno.h>
+
+/**
+ * @brief 导入导出文件格式
+ */
+typedef enum {
+    TRANSFER_CSV,
+    TRANSFER_JSONL
+} TransferFormat;
+
+/**
+ * @brief 确定文件格式：优先使用显式指定的格式，否则按扩展名判断，默认CSV
+ * @return 不支持的格式返回-1
+ */
+static int resolve_format(const char *path, const char *format) {
+    if (format) {
+        if (strcmp(format, "csv") == 0) return TRANSFER_CSV;
+        if (strcmp(format, "jsonl") == 0 || strcmp(format, "json") == 0) return TRANSFER_JSONL;
+        return -1;
+    }
+
+    const char *ext = strrchr(path, '.');
+    if (ext && (strcmp(ext, ".jsonl") == 0 || strcmp(ext, ".json") == 0)) {
+        return TRANSFER_JSONL;
+    }
+    return TRANSFER_CSV;
+}
+
+/**
+ * @brief 获取单调时钟的当前秒数
+ */
+static double monotonic_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/* ==================== 导入函数 ==================== */
+
+/**
+ * @brief 解析一个整数字段
+ * @return 解析后的位置，字段不是整数时返回NULL
+ */
+static const char *parse_field(const char *p, long long *value) {
+    while (*p == ' ' || *p == '\t') p++;
+
+    char *end;
+    errno = 0;
+    *value = strtoll(p, &end, 10);
+    if (end == p || errno != 0) return NULL;
+
+    while (*end == ' ' || *end == '\t') end++;
+    return end;
+}
+
+/**
+ * @brief 解析一行 CSV：timestamp,amount[,其他列]
+ */
+static int parse_csv_line(const char *line, long long *timestamp, long long *amount) {
+    const char *p = parse_field(line, timestamp);
+    if (!p || *p != ',') return -1;
+
+    p = parse_field(p + 1, amount);
+    if (!p || (*p != ',' && *p != '\0' && *p != '\r' && *p != '\n')) return -1;
+    return 0;
+}
+
+/**
+ * @brief 在一行 JSON 对象中查找整数字段
+ */
+static int json_int_field(const char *line, const char *key, long long *value) {
+    const char *p = strstr(line, key);
+    if (!p) return -1;
+
+    p += strlen(key);
+    while (*p == ' ' || *p == '\t') p++;
+    if (*p != ':') return -1;
+
+    p = parse_field(p + 1, value);
+    return p && (*p == ',' || *p == '}') ? 0 : -1;
+}
+
+/**
+ * @brief 解析一行 JSON Lines：{"timestamp":...,"amount":...}
+ */
+static int parse_jsonl_line(const char *line, long long *timestamp, long long *amount) {
+    if (json_int_field(line, "\"timestamp\"", timestamp) != 0 ||
+        json_int_field(line, "\"amount\"", amount) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 从 CSV 或 JSON Lines 文件导入记录
+ * @param path 输入文件路径，"-" 表示标准输入
+ * @param format "csv"、"jsonl" 或 NULL（按扩展名判断）
+ * @description 记录直接按批追加到数据日志，不在内存中保留；
+ *              喝水量使用与界面输入相同的校验规则，无效行跳过并报告行号
+ */
+int import_records(AppState *app, const char *path, const char *format) {
+    if (!app || !path) return -1;
+
+    int kind = resolve_format(path, format);
+    if (kind < 0) {
+        fprintf(stderr, "不支持的格式: %s\n", format);
+        return -1;
+    }
+
+    FILE *input = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    if (!input) {
+        perror("打开导入文件失败");
+        return -1;
+    }
+    setvbuf(input, NULL, _IOFBF, 64 * 1024);
+
+    WaterRecord *batch = malloc(TRANSFER_BATCH_SIZE * sizeof(WaterRecord));
+    if (!batch) {
+        if (input != stdin) fclose(input);
+        return -1;
+    }
+
+    // 导入的记录早于日志中已有的记录时，需要在文件头中标记倒序
+    uint32_t last_timestamp = app->records.count > 0 ?
+        record_store_at(&app->records, app->records.count - 1)->timestamp : 0;
+    int sorted = app->records.sorted;
+
+    char line[TRANSFER_LINE_MAX];
+    long line_number = 0;
+    long imported = 0;
+    long skipped = 0;
+    int batch_count = 0;
+    int ret = 0;
+    double start = monotonic_seconds();
+
+    while (fgets(line, sizeof(line), input)) {
+        line_number++;
+
+        // 超长的行整行跳过
+        size_t length = strlen(line);
+        if (length == sizeof(line) - 1 && line[length - 1] != '\n') {
+            int c;
+            while ((c = fgetc(input)) != EOF && c != '\n') {}
+            skipped++;
+            continue;
+        }
+
+        const char *p = line;
+        while (*p == ' ' || *p == '\t') p++;
+        if (*p == '\0' || *p == '\n' || *p == '\r') continue;
+
+        // CSV 首行为表头时跳过
+        if (kind == TRANSFER_CSV && line_number == 1 && !(*p >= '0' && *p <= '9')) {
+            continue;
+        }
+
+        long long timestamp = 0, amount = 0;
+        int parsed = kind == TRANSFER_CSV ? parse_csv_line(p, &timestamp, &amount)
+                                          : parse_jsonl_line(p, &timestamp, &amount);
+        if (parsed != 0 || timestamp <= 0 || timestamp > UINT32_MAX ||
+            amount < 0 || amount > WATER_AMOUNT_MAX || !water_amount_valid((int)amount)) {
+            if (skipped < 10) {
+                fprintf(stderr, "第%ld行无效，已跳过\n", line_number);
+            }
+            skipped++;
+            continue;
+        }
+
+        WaterRecord *record = &batch[batch_count++];
+        record->timestamp = (uint32_t)timestamp;
+        record->amount = (int32_t)amount;
+        if (record->timestamp < last_timestamp) {
+            sorted = 0;
+        }
+        last_timestamp = record->timestamp;
+
+        if (batch_count == TRANSFER_BATCH_SIZE) {
+            if (journal_append(app, batch, batch_count) != 0) {
+                ret = -1;
+                break;
+            }
+            imported += batch_count;
+            batch_count = 0;
+        }
+    }
+
+    if (ret == 0 && batch_count > 0) {
+        if (journal_append(app, batch, batch_count) == 0) {
+            imported += batch_count;
+        } else {
+            ret = -1;
+        }
+    }
+    if (ferror(input)) {
+        perror("读取导入文件失败");
+        ret = -1;
+    }
+
+    free(batch);
+    if (input != stdin) fclose(input);
+
+    if (imported > 0 && !sorted && app->records.sorted) {
+        mark_records_unsorted(app->data_path);
+    }
+
+    double elapsed = monotonic_seconds() - start;
+    printf("导入%s: %ld条记录，跳过%ld行，用时%.2f秒（%.0f条/秒）\n",
+           ret == 0 ? "完成" : "中断", imported, skipped, elapsed,
+           elapsed > 0 ? imported / elapsed : 0.0);
+
+    char log_msg[100];
+    snprintf(log_msg, sizeof(log_msg), "导入喝水记录: %ld条，跳过%ld行", imported, skipped);
+    log_message(log_msg);
+
+    // 内存中的状态按新的数据文件重新加载（只映射文件，不复制记录）
+    if (imported > 0 && load_records(app) == 0) {
+        calculate_today_stats(app);
+    }
+    return ret;
+}
+
+/* ==================== 导出函数 ==================== */
+
+/**
+ * @brief 格式化本地时间，缓存当前小时的日期前缀
+ * @description 按时间顺序导出时同一小时内的记录只需拼接分秒，
+ *              时区偏移的变化发生在整点，不会落在缓存的小时内部
+ */
+static const char *format_local_time(time_t timestamp, char *buffer, size_t size,
+                                     time_t *hour_start, char *hour_prefix, size_t prefix_size) {
+    if (timestamp < *hour_start || timestamp >= *hour_start + 3600) {
+        struct tm tm_info;
+        localtime_r(&timestamp, &tm_info);
+        strftime(hour_prefix, prefix_size, "%Y-%m-%d %H:", &tm_info);
+        *hour_start = timestamp - tm_info.tm_min * 60 - tm_info.tm_sec;
+    }
+
+    int offset = (int)(timestamp - *hour_start);
+    snprintf(buffer, size, "%s%02d:%02d", hour_prefix, offset / 60, offset % 60);
+    return buffer;
+}
+
+/**
+ * @brief 将全部记录导出为 CSV 或 JSON Lines 文件
+ * @param path 输出文件路径，"-" 表示标准输出
+ * @param format "csv"、"jsonl" 或 NULL（按扩展名判断）
+ */
+int export_records(const AppState *app, const char *path, const char *format) {
+    if (!app || !path) return -1;
+
+    int kind = resolve_format(path, format);
+    if (kind < 0) {
+        fprintf(stderr, "不支持的格式: %s\n", format);
+        return -1;
+    }
+
+    int to_stdout = strcmp(path, "-") == 0;
+    FILE *output = to_stdout ? stdout : fopen(path, "w");
+    if (!output) {
+        perror("创建导出文件失败");
+        return -1;
+    }
+    setvbuf(output, NULL, _IOFBF, 64 * 1024);
+
+    double start = monotonic_seconds();
+    time_t hour_start = 0;
+    char hour_prefix[32] = "";
+    char time_str[40];
+
+    if (kind == TRANSFER_CSV) {
+        fputs("timestamp,amount,time\n", output);
+    }
+
+    for (int i = 0; i < app->records.count; i++) {
+        const WaterRecord *record = record_store_at(&app->records, i);
+        format_local_time((time_t)record->timestamp, time_str, sizeof(time_str),
+                          &hour_start, hour_prefix, sizeof(hour_prefix));
+
+        if (kind == TRANSFER_CSV) {
+            fprintf(output, "%u,%d,%s\n", (unsigned)record->timestamp, (int)record->amount, time_str);
+        } else {
+            fprintf(output, "{\"timestamp\":%u,\"amount\":%d,\"time\":\"%s\"}\n",
+                    (unsigned)record->timestamp, (int)record->amount, time_str);
+        }
+    }
+
+    int ret = fflush(output) == 0 && !ferror(output) ? 0 : -1;
+    if (!to_stdout && fclose(output) != 0) {
+        ret = -1;
+    }
+    if (ret != 0) {
+        perror("写入导出文件失败");
+    }
+
+    // 导出到标准输出时报告写到标准错误，不混入数据
+    double elapsed = monotonic_seconds() - start;
+    fprintf(to_stdout ? stderr : stdout, "导出%s: %d条记录，用时%.2f秒（%.0f条/秒）\n",
+            ret == 0 ? "完成" : "失败", app->records.count, elapsed,
+            elapsed > 0 ? app->records.count / elapsed : 0.0);
+    return ret;
+}
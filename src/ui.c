@@ -7,52 +7,47 @@
  */
 
 #include "water_reminder.h"
+#include <errno.h>
+#include <limits.h>
 
 /* ==================== 基础UI函数 ==================== */
 
-/**
- * @brief 清屏函数
- */
-void clear_screen(void) {
-    system("clear");
-}
-
 /**
  * @brief 显示应用横幅
  */
 void show_banner(void) {
-    printf("%s%s", COLOR_BOLD, COLOR_CYAN);
-    printf("╔══════════════════════════════════════════════════════════════╗\n");
-    printf("║                                                              ║\n");
-    printf("║    %s💧 喝水提醒应用 - Water Reminder v1.0 💧%s%s              ║\n", 
+    ui_printf("%s%s", COLOR_BOLD, COLOR_CYAN);
+    ui_printf("╔══════════════════════════════════════════════════════════════╗\n");
+    ui_printf("║                                                              ║\n");
+    ui_printf("║    %s💧 喝水提醒应用 - Water Reminder v1.0 💧%s%s              ║\n", 
            COLOR_BLUE, COLOR_CYAN, COLOR_BOLD);
-    printf("║                                                              ║\n");
-    printf("║                   %s作者: zcg%s%s                             ║\n", 
+    ui_printf("║                                                              ║\n");
+    ui_printf("║                   %s作者: zcg%s%s                             ║\n", 
            COLOR_YELLOW, COLOR_CYAN, COLOR_BOLD);
-    printf("║                                                              ║\n");
-    printf("║            %s🌊 健康生活，从每一滴水开始 🌊%s%s              ║\n", 
+    ui_printf("║                                                              ║\n");
+    ui_printf("║            %s🌊 健康生活，从每一滴水开始 🌊%s%s              ║\n", 
            COLOR_GREEN, COLOR_CYAN, COLOR_BOLD);
-    printf("║                                                              ║\n");
-    printf("╚══════════════════════════════════════════════════════════════╝\n");
-    printf("%s", COLOR_RESET);
+    ui_printf("║                                                              ║\n");
+    ui_printf("╚══════════════════════════════════════════════════════════════╝\n");
+    ui_printf("%s", COLOR_RESET);
 }
 
 /**
  * @brief 显示主菜单
  */
 void show_main_menu(void) {
-    printf("\n");
-    printf("%s╭─────────────────────────────────────╮%s\n", COLOR_WHITE, COLOR_RESET);
-    printf("%s│               主菜单                │%s\n", COLOR_WHITE, COLOR_RESET);
-    printf("%s╰─────────────────────────────────────╯%s\n", COLOR_WHITE, COLOR_RESET);
-    printf("\n");
-    
-    printf("  %s1.%s %s💧 记录喝水%s\n", COLOR_BOLD, COLOR_RESET, COLOR_BLUE, COLOR_RESET);
-    printf("  %s2.%s %s📊 查看统计%s\n", COLOR_BOLD, COLOR_RESET, COLOR_MAGENTA, COLOR_RESET);
-    printf("  %s3.%s %s⚙️  设置%s\n", COLOR_BOLD, COLOR_RESET, COLOR_YELLOW, COLOR_RESET);
-    printf("  %s4.%s %s⏸️  暂停/恢复提醒%s\n", COLOR_BOLD, COLOR_RESET, COLOR_CYAN, COLOR_RESET);
-    printf("  %s0.%s %s❌ 退出%s\n", COLOR_BOLD, COLOR_RESET, COLOR_RED, COLOR_RESET);
-    printf("\n%s请选择操作: %s", COLOR_BOLD, COLOR_RESET);
+    ui_printf("\n");
+    ui_printf("%s╭─────────────────────────────────────╮%s\n", COLOR_WHITE, COLOR_RESET);
+    ui_printf("%s│               主菜单                │%s\n", COLOR_WHITE, COLOR_RESET);
+    ui_printf("%s╰─────────────────────────────────────╯%s\n", COLOR_WHITE, COLOR_RESET);
+    ui_printf("\n");
+    
+    ui_printf("  %s1.%s %s💧 记录喝水%s\n", COLOR_BOLD, COLOR_RESET, COLOR_BLUE, COLOR_RESET);
+    ui_printf("  %s2.%s %s📊 查看统计%s\n", COLOR_BOLD, COLOR_RESET, COLOR_MAGENTA, COLOR_RESET);
+    ui_printf("  %s3.%s %s⚙️  设置%s\n", COLOR_BOLD, COLOR_RESET, COLOR_YELLOW, COLOR_RESET);
+    ui_printf("  %s4.%s %s⏸️  暂停/恢复提醒%s\n", COLOR_BOLD, COLOR_RESET, COLOR_CYAN, COLOR_RESET);
+    ui_printf("  %s0.%s %s❌ 退出%s\n", COLOR_BOLD, COLOR_RESET, COLOR_RED, COLOR_RESET);
+    ui_printf("\n%s请选择操作: %s", COLOR_BOLD, COLOR_RESET);
 }
 
 /**
@@ -61,11 +56,11 @@ void show_main_menu(void) {
 void show_stats_dashboard(const AppState *app) {
     if (!app) return;
     
-    printf("\n");
-    printf("%s╭─────────────────────────────────────╮%s\n", COLOR_GREEN, COLOR_RESET);
-    printf("%s│            今日统计数据             │%s\n", COLOR_GREEN, COLOR_RESET);
-    printf("%s╰─────────────────────────────────────╯%s\n", COLOR_GREEN, COLOR_RESET);
-    printf("\n");
+    ui_printf("\n");
+    ui_printf("%s╭─────────────────────────────────────╮%s\n", COLOR_GREEN, COLOR_RESET);
+    ui_printf("%s│            今日统计数据             │%s\n", COLOR_GREEN, COLOR_RESET);
+    ui_printf("%s╰─────────────────────────────────────╯%s\n", COLOR_GREEN, COLOR_RESET);
+    ui_printf("\n");
     
     // 计算目标完成度
     int daily_goal_ml = app->config.daily_goal * app->config.cup_size;
@@ -75,55 +70,55 @@ void show_stats_dashboard(const AppState *app) {
     if (progress_percent > 100) progress_percent = 100;
     
     // 显示用户信息
-    printf("  %s👤 用户:%s %s%s\n", 
+    ui_printf("  %s👤 用户:%s %s%s\n", 
            COLOR_CYAN, COLOR_RESET, app->config.name, COLOR_RESET);
     
     // 显示今日喝水量
-    printf("  %s🥤 今日喝水:%s %s%d次 / %dml%s\n", 
+    ui_printf("  %s🥤 今日喝水:%s %s%d次 / %dml%s\n", 
            COLOR_BLUE, COLOR_RESET, COLOR_BOLD, 
            app->today_count, app->today_amount, COLOR_RESET);
     
     // 显示每日目标
-    printf("  %s🎯 每日目标:%s %s%d杯 (%dml)%s\n", 
+    ui_printf("  %s🎯 每日目标:%s %s%d杯 (%dml)%s\n", 
            COLOR_YELLOW, COLOR_RESET, COLOR_BOLD,
            app->config.daily_goal, daily_goal_ml, COLOR_RESET);
     
     // 显示进度条
-    printf("  %s📈 完成度:%s %.1f%%\n", COLOR_MAGENTA, COLOR_RESET, progress_percent);
+    ui_printf("  %s📈 完成度:%s %.1f%%\n", COLOR_MAGENTA, COLOR_RESET, progress_percent);
     show_progress_bar(app->today_amount, daily_goal_ml, "喝水进度");
     
     // 显示提醒状态
-    printf("  %s⏰ 提醒间隔:%s %s%d分钟%s", 
+    ui_printf("  %s⏰ 提醒间隔:%s %s%d分钟%s", 
            COLOR_CYAN, COLOR_RESET, COLOR_BOLD,
            app->config.reminder_interval, COLOR_RESET);
     
     if (app->paused) {
-        printf(" %s[已暂停]%s", COLOR_RED, COLOR_RESET);
+        ui_printf(" %s[已暂停]%s", COLOR_RED, COLOR_RESET);
     } else {
-        printf(" %s[运行中]%s", COLOR_GREEN, COLOR_RESET);
+        ui_printf(" %s[运行中]%s", COLOR_GREEN, COLOR_RESET);
     }
-    printf("\n");
+    ui_printf("\n");
     
     // 显示连续天数
     int streak = get_streak_days(app);
     if (streak > 0) {
-        printf("  %s🔥 连续喝水:%s %s%d天%s\n", 
+        ui_printf("  %s🔥 连续喝水:%s %s%d天%s\n", 
                COLOR_RED, COLOR_RESET, COLOR_BOLD, streak, COLOR_RESET);
     }
     
     // 显示鼓励信息
     if (progress_percent >= 100) {
-        printf("\n  %s%s 太棒了！今天的目标已完成！ %s%s\n", 
+        ui_printf("\n  %s%s 太棒了！今天的目标已完成！ %s%s\n", 
                COLOR_BOLD, TROPHY_CHAR, TROPHY_CHAR, COLOR_RESET);
     } else if (progress_percent >= 75) {
-        printf("\n  %s%s 加油！距离目标只差一点点了！ %s%s\n", 
+        ui_printf("\n  %s%s 加油！距离目标只差一点点了！ %s%s\n", 
                COLOR_YELLOW, STAR_CHAR, STAR_CHAR, COLOR_RESET);
     } else if (progress_percent >= 50) {
-        printf("\n  %s💪 不错！已经完成一半目标了！\n", COLOR_GREEN);
+        ui_printf("\n  %s💪 不错！已经完成一半目标了！\n", COLOR_GREEN);
     } else if (app->today_count > 0) {
-        printf("\n  %s☕ 好的开始！继续保持下去！\n", COLOR_BLUE);
+        ui_printf("\n  %s☕ 好的开始！继续保持下去！\n", COLOR_BLUE);
     } else {
-        printf("\n  %s💧 新的一天开始了，记得多喝水哦！\n", COLOR_CYAN);
+        ui_printf("\n  %s💧 新的一天开始了，记得多喝水哦！\n", COLOR_CYAN);
     }
 }
 
@@ -139,49 +134,50 @@ void show_progress_bar(int current, int goal, const char *label) {
     
     int filled = (int)(percentage * bar_width);
     
-    printf("     %s[", COLOR_WHITE);
+    // 已完成部分颜色相同，只需设置一次颜色
+    const char *fill_color = percentage >= 1.0 ? COLOR_GREEN :
+                             percentage >= 0.75 ? COLOR_YELLOW :
+                             percentage >= 0.5 ? COLOR_BLUE : COLOR_CYAN;
+    char bar[256];
+    size_t length = 0;
     
-    // 绘制进度条
     for (int i = 0; i < bar_width; i++) {
-        if (i < filled) {
-            if (percentage >= 1.0) {
-                printf("%s█%s", COLOR_GREEN, COLOR_WHITE);
-            } else if (percentage >= 0.75) {
-                printf("%s█%s", COLOR_YELLOW, COLOR_WHITE);
-            } else if (percentage >= 0.5) {
-                printf("%s█%s", COLOR_BLUE, COLOR_WHITE);
-            } else {
-                printf("%s█%s", COLOR_CYAN, COLOR_WHITE);
-            }
-        } else {
-            printf("░");
-        }
+        const char *cell = i < filled ? "█" : "░";
+        memcpy(bar + length, cell, 3);
+        length += 3;
     }
+    bar[length] = '\0';
+    
+    // 绘制进度条
+    ui_printf("     %s[%s%.*s%s%s", COLOR_WHITE, fill_color, filled * 3, bar,
+              COLOR_WHITE, bar + filled * 3);
     
-    printf("]%s %.1f%%\n", COLOR_RESET, percentage * 100);
+    ui_printf("]%s %.1f%%\n", COLOR_RESET, percentage * 100);
 }
 
 /**
  * @brief 显示喝水动画
  */
-void show_water_animation(void) {
-    const char* frames[] = {
-        "💧    ",
-        " 💧   ",
-        "  💧  ",
-        "   💧 ",
-        "    💧",
-        "   🥤 "
+void show_water_animation(const AppState *app) {
+    static const char *const frames[] = {
+        "  " COLOR_CYAN "喝水中... 💧    " COLOR_RESET,
+        "  " COLOR_CYAN "喝水中...  💧   " COLOR_RESET,
+        "  " COLOR_CYAN "喝水中...   💧  " COLOR_RESET,
+        "  " COLOR_CYAN "喝水中...    💧 " COLOR_RESET,
+        "  " COLOR_CYAN "喝水中...     💧" COLOR_RESET,
+        "  " COLOR_CYAN "喝水中...    🥤 " COLOR_RESET,
+        "  " COLOR_CYAN "喝水中...    🥤 " COLOR_GREEN " ✨ 完成！" COLOR_RESET
     };
+    int frame_count = sizeof(frames) / sizeof(frames[0]);
     
-    printf("\n%s", COLOR_BLUE);
-    for (int i = 0; i < 6; i++) {
-        printf("\r  %s喝水中... %s", COLOR_CYAN, frames[i]);
-        fflush(stdout);
-        usleep(200000); // 200ms延迟
+    ui_printf("\n");
+    if (!app || !app->config.animations_enabled) {
+        ui_printf("%s\n", frames[frame_count - 1]);
+        return;
     }
-    printf("%s ✨ 完成！\n", COLOR_GREEN);
-    printf("%s", COLOR_RESET);
+    
+    // 每帧200ms，由事件循环在等待输入时逐帧播放
+    animation_play_line(frames, frame_count, 200);
 }
 
 /**
@@ -191,28 +187,24 @@ void show_reminder_notification(const AppState *app) {
     if (!app) return;
     
     // 保存当前屏幕内容并显示提醒
-    printf("\n%s", COLOR_BOLD);
-    printf("╔══════════════════════════════════════╗\n");
-    printf("║                                      ║\n");
-    printf("║     %s💧 喝水提醒 💧%s%s               ║\n", COLOR_BLUE, COLOR_BOLD, COLOR_WHITE);
-    printf("║                                      ║\n");
-    printf("║   %s是时候喝水啦！%s%s                  ║\n", COLOR_YELLOW, COLOR_BOLD, COLOR_WHITE);
-    printf("║                                      ║\n");
-    printf("║   %s保持健康，记得补充水分 🌊%s%s        ║\n", COLOR_GREEN, COLOR_BOLD, COLOR_WHITE);
-    printf("║                                      ║\n");
-    printf("╚══════════════════════════════════════╝%s\n", COLOR_RESET);
+    ui_printf("\n%s", COLOR_BOLD);
+    ui_printf("╔══════════════════════════════════════╗\n");
+    ui_printf("║                                      ║\n");
+    ui_printf("║     %s💧 喝水提醒 💧%s%s               ║\n", COLOR_BLUE, COLOR_BOLD, COLOR_WHITE);
+    ui_printf("║                                      ║\n");
+    ui_printf("║   %s是时候喝水啦！%s%s                  ║\n", COLOR_YELLOW, COLOR_BOLD, COLOR_WHITE);
+    ui_printf("║                                      ║\n");
+    ui_printf("║   %s保持健康，记得补充水分 🌊%s%s        ║\n", COLOR_GREEN, COLOR_BOLD, COLOR_WHITE);
+    ui_printf("║                                      ║\n");
+    ui_printf("╚══════════════════════════════════════╝%s\n", COLOR_RESET);
     
     // 播放音效（如果启用）
     if (app->config.sound_enabled) {
         play_sound_effect();
     }
     
-    // 闪烁效果
-    for (int i = 0; i < 3; i++) {
-        printf("\a"); // 系统铃声
-        fflush(stdout);
-        usleep(300000);
-    }
+    // 闪烁效果：铃声间隔300ms，关闭动画时只响一次
+    animation_play_bell(app->config.animations_enabled ? 3 : 1, 300);
 }
 
 /* ==================== 统计显示函数 ==================== */
@@ -223,46 +215,33 @@ void show_reminder_notification(const AppState *app) {
 void show_weekly_stats(const AppState *app) {
     if (!app) return;
     
-    printf("%s╭─────────────────────────────────────╮%s\n", COLOR_YELLOW, COLOR_RESET);
-    printf("%s│             近7天统计               │%s\n", COLOR_YELLOW, COLOR_RESET);
-    printf("%s╰─────────────────────────────────────╯%s\n", COLOR_YELLOW, COLOR_RESET);
-    printf("\n");
-    
-    time_t now = time(NULL);
-    struct tm *tm_info = localtime(&now);
-    
-    int weekly_total = 0;
-    int weekly_days = 0;
+    METRIC_START(start);
+    ui_printf("%s╭─────────────────────────────────────╮%s\n", COLOR_YELLOW, COLOR_RESET);
+    ui_printf("%s│             近7天统计               │%s\n", COLOR_YELLOW, COLOR_RESET);
+    ui_printf("%s╰─────────────────────────────────────╯%s\n", COLOR_YELLOW, COLOR_RESET);
+    ui_printf("\n");
+    
+    QueryBucket days[7];
+    QuerySummary summary;
+    int count = range_query_recent_days(app, 7, 0, days, 7, &summary);
+    if (count < 0) {
+        count = 0;
+        memset(&summary, 0, sizeof(summary));
+    }
     
     // 显示最近7天的数据
-    for (int day = 6; day >= 0; day--) {
-        time_t target_time = now - (day * 24 * 60 * 60);
-        struct tm *target_tm = localtime(&target_time);
-        
-        char date_str[11];
-        strftime(date_str, sizeof(date_str), "%Y-%m-%d", target_tm);
+    for (int i = 0; i < count; i++) {
+        int day = count - 1 - i; // 距今天数
+        struct tm target_tm;
+        day_number_to_tm(days[i].first_day, &target_tm);
         
         char weekday[10];
-        strftime(weekday, sizeof(weekday), "%a", target_tm);
-        
-        // 计算这一天的喝水量
-        int daily_amount = 0;
-        int daily_count = 0;
-        
-        for (int i = 0; i < app->record_count; i++) {
-            if (is_same_date(app->records[i].date_str, date_str)) {
-                daily_amount += app->records[i].amount;
-                daily_count++;
-            }
-        }
+        strftime(weekday, sizeof(weekday), "%a", &target_tm);
         
-        if (daily_amount > 0) {
-            weekly_total += daily_amount;
-            weekly_days++;
-        }
+        int daily_amount = (int)days[i].sum;
         
         // 显示这一天的数据
-        printf("  %s %s:%s %s%4dml%s", 
+        ui_printf("  %s %s:%s %s%4dml%s", 
                day == 0 ? COLOR_GREEN : COLOR_WHITE,
                weekday, COLOR_RESET,
                daily_amount > 0 ? COLOR_BOLD : COLOR_DIM,
@@ -274,36 +253,37 @@ void show_weekly_stats(const AppState *app) {
             int progress = (daily_amount * 10) / goal_ml;
             if (progress > 10) progress = 10;
             
-            printf(" [");
+            ui_printf(" [");
             for (int j = 0; j < 10; j++) {
                 if (j < progress) {
-                    printf("%s█%s", daily_amount >= goal_ml ? COLOR_GREEN : COLOR_BLUE, COLOR_RESET);
+                    ui_printf("%s█%s", daily_amount >= goal_ml ? COLOR_GREEN : COLOR_BLUE, COLOR_RESET);
                 } else {
-                    printf("░");
+                    ui_printf("░");
                 }
             }
-            printf("]");
+            ui_printf("]");
         }
         
         if (day == 0) {
-            printf(" %s← 今天%s", COLOR_GREEN, COLOR_RESET);
+            ui_printf(" %s← 今天%s", COLOR_GREEN, COLOR_RESET);
         }
-        printf("\n");
+        ui_printf("\n");
     }
     
-    printf("\n");
-    if (weekly_days > 0) {
-        float daily_avg = (float)weekly_total / weekly_days;
-        printf("  %s📊 周平均:%s %s%.0fml/天%s\n", 
+    ui_printf("\n");
+    if (summary.active > 0) {
+        float daily_avg = (float)summary.total.sum / summary.active;
+        ui_printf("  %s📊 周平均:%s %s%.0fml/天%s\n", 
                COLOR_MAGENTA, COLOR_RESET, COLOR_BOLD, daily_avg, COLOR_RESET);
-        printf("  %s📈 周总量:%s %s%dml%s\n", 
-               COLOR_BLUE, COLOR_RESET, COLOR_BOLD, weekly_total, COLOR_RESET);
-        printf("  %s✅ 有记录天数:%s %s%d天%s\n", 
-               COLOR_GREEN, COLOR_RESET, COLOR_BOLD, weekly_days, COLOR_RESET);
+        ui_printf("  %s📈 周总量:%s %s%lldml%s\n", 
+               COLOR_BLUE, COLOR_RESET, COLOR_BOLD, summary.total.sum, COLOR_RESET);
+        ui_printf("  %s✅ 有记录天数:%s %s%d天%s\n", 
+               COLOR_GREEN, COLOR_RESET, COLOR_BOLD, summary.active, COLOR_RESET);
     } else {
-        printf("  %s📝 本周还没有喝水记录，开始记录吧！%s\n", 
+        ui_printf("  %s📝 本周还没有喝水记录，开始记录吧！%s\n", 
                COLOR_YELLOW, COLOR_RESET);
     }
+    METRIC_END(METRIC_WEEKLY_STATS, start);
 }
 
 /**
@@ -312,96 +292,292 @@ void show_weekly_stats(const AppState *app) {
 void show_monthly_stats(const AppState *app) {
     if (!app) return;
     
-    printf("%s╭─────────────────────────────────────╮%s\n", COLOR_BLUE, COLOR_RESET);
-    printf("%s│             近30天统计              │%s\n", COLOR_BLUE, COLOR_RESET);
-    printf("%s╰─────────────────────────────────────╯%s\n", COLOR_BLUE, COLOR_RESET);
-    printf("\n");
+    METRIC_START(start);
+    ui_printf("%s╭─────────────────────────────────────╮%s\n", COLOR_BLUE, COLOR_RESET);
+    ui_printf("%s│             近30天统计              │%s\n", COLOR_BLUE, COLOR_RESET);
+    ui_printf("%s╰─────────────────────────────────────╯%s\n", COLOR_BLUE, COLOR_RESET);
+    ui_printf("\n");
+    
+    QueryBucket days[30];
+    QuerySummary summary;
+    int count = range_query_recent_days(app, 30, 0, days, 30, &summary);
+    if (count < 0) {
+        count = 0;
+        memset(&summary, 0, sizeof(summary));
+    }
     
-    time_t now = time(NULL);
-    int monthly_total = 0;
-    int monthly_days = 0;
-    int best_day = 0;
+    int monthly_days = summary.active;
+    int best_day = (int)summary.best;
     int goal_achieved_days = 0;
-    
-    // 统计最近30天的数据
-    for (int day = 29; day >= 0; day--) {
-        time_t target_time = now - (day * 24 * 60 * 60);
-        struct tm *target_tm = localtime(&target_time);
-        
-        char date_str[11];
-        strftime(date_str, sizeof(date_str), "%Y-%m-%d", target_tm);
-        
-        int daily_amount = 0;
-        for (int i = 0; i < app->record_count; i++) {
-            if (is_same_date(app->records[i].date_str, date_str)) {
-                daily_amount += app->records[i].amount;
-            }
-        }
-        
-        if (daily_amount > 0) {
-            monthly_total += daily_amount;
-            monthly_days++;
-            
-            if (daily_amount > best_day) {
-                best_day = daily_amount;
-            }
-            
-            int goal_ml = app->config.daily_goal * app->config.cup_size;
-            if (daily_amount >= goal_ml) {
-                goal_achieved_days++;
-            }
+    int goal_ml = app->config.daily_goal * app->config.cup_size;
+    for (int i = 0; i < count; i++) {
+        if (days[i].count > 0 && days[i].sum >= goal_ml) {
+            goal_achieved_days++;
         }
     }
     
     if (monthly_days > 0) {
-        float daily_avg = (float)monthly_total / monthly_days;
+        float daily_avg = (float)summary.total.sum / monthly_days;
         float goal_rate = (float)goal_achieved_days / monthly_days * 100;
         
-        printf("  %s📊 月平均:%s %s%.0fml/天%s\n", 
+        ui_printf("  %s📊 月平均:%s %s%.0fml/天%s\n", 
                COLOR_MAGENTA, COLOR_RESET, COLOR_BOLD, daily_avg, COLOR_RESET);
-        printf("  %s📈 月总量:%s %s%.1fL%s\n", 
-               COLOR_BLUE, COLOR_RESET, COLOR_BOLD, (float)monthly_total/1000, COLOR_RESET);
-        printf("  %s🏆 最佳单日:%s %s%dml%s\n", 
+        ui_printf("  %s📈 月总量:%s %s%.1fL%s\n", 
+               COLOR_BLUE, COLOR_RESET, COLOR_BOLD, (float)summary.total.sum/1000, COLOR_RESET);
+        ui_printf("  %s🏆 最佳单日:%s %s%dml%s\n", 
                COLOR_YELLOW, COLOR_RESET, COLOR_BOLD, best_day, COLOR_RESET);
-        printf("  %s✅ 有记录天数:%s %s%d天%s\n", 
+        ui_printf("  %s✅ 有记录天数:%s %s%d天%s\n", 
                COLOR_GREEN, COLOR_RESET, COLOR_BOLD, monthly_days, COLOR_RESET);
-        printf("  %s🎯 目标达成率:%s %s%.1f%% (%d/%d天)%s\n", 
+        ui_printf("  %s🎯 目标达成率:%s %s%.1f%% (%d/%d天)%s\n", 
                COLOR_CYAN, COLOR_RESET, COLOR_BOLD, goal_rate, 
                goal_achieved_days, monthly_days, COLOR_RESET);
         
         // 显示评价
-        printf("\n");
+        ui_printf("\n");
         if (goal_rate >= 80) {
-            printf("  %s%s 太棒了！你是喝水达人！ %s%s\n", 
+            ui_printf("  %s%s 太棒了！你是喝水达人！ %s%s\n", 
                    COLOR_BOLD, TROPHY_CHAR, TROPHY_CHAR, COLOR_RESET);
         } else if (goal_rate >= 60) {
-            printf("  %s%s 表现不错！继续保持！ %s%s\n", 
+            ui_printf("  %s%s 表现不错！继续保持！ %s%s\n", 
                    COLOR_GREEN, STAR_CHAR, STAR_CHAR, COLOR_RESET);
         } else if (goal_rate >= 40) {
-            printf("  %s💪 还有提升空间，加油！%s\n", COLOR_YELLOW, COLOR_RESET);
+            ui_printf("  %s💪 还有提升空间，加油！%s\n", COLOR_YELLOW, COLOR_RESET);
         } else {
-            printf("  %s💧 记得多喝水，健康最重要！%s\n", COLOR_BLUE, COLOR_RESET);
+            ui_printf("  %s💧 记得多喝水，健康最重要！%s\n", COLOR_BLUE, COLOR_RESET);
         }
     } else {
-        printf("  %s📝 近30天还没有喝水记录，开始记录吧！%s\n", 
+        ui_printf("  %s📝 近30天还没有喝水记录，开始记录吧！%s\n", 
                COLOR_YELLOW, COLOR_RESET);
     }
+    METRIC_END(METRIC_MONTHLY_STATS, start);
+}
+
+/**
+ * @brief 热力图一格的颜色等级（0表示没有记录，1-4 依次增多）
+ */
+static int heatmap_level(long long amount, long long max) {
+    if (amount <= 0 || max <= 0) return 0;
+    int level = (int)((amount * 4 + max - 1) / max);
+    return level > 4 ? 4 : level;
+}
+
+/**
+ * @brief 生成热力图的一行（24个钟点，每格一个字符）
+ * @description 与进度条相同的方块字符，颜色只在等级变化时切换
+ */
+static void heatmap_row(char *row, size_t size, const long long *amounts, long long max) {
+    static const char *const colors[] = { COLOR_WHITE, COLOR_CYAN, COLOR_BLUE, COLOR_YELLOW, COLOR_GREEN };
+    size_t length = 0;
+    int current = -1;
+    
+    for (int h = 0; h < 24 && length + 16 < size; h++) {
+        int level = heatmap_level(amounts[h], max);
+        if (level != current) {
+            length += snprintf(row + length, size - length, "%s", colors[level]);
+            current = level;
+        }
+        memcpy(row + length, level > 0 ? "█" : "░", 3);
+        length += 3;
+    }
+    snprintf(row + length, size - length, "%s", COLOR_RESET);
+}
+
+/**
+ * @brief 显示按星期和钟点划分的喝水热力图
+ * @param days 统计以今天结尾的最近天数
+ */
+void show_intake_heatmap(const AppState *app, int days) {
+    if (!app || days <= 0) return;
+    
+    METRIC_START(start);
+    static const char *const weekday_names[] = { "周一", "周二", "周三", "周四", "周五", "周六", "周日" };
+    
+    ui_printf("%s╭─────────────────────────────────────╮%s\n", COLOR_CYAN, COLOR_RESET);
+    ui_printf("%s│             喝水热力图              │%s\n", COLOR_CYAN, COLOR_RESET);
+    ui_printf("%s╰─────────────────────────────────────╯%s\n", COLOR_CYAN, COLOR_RESET);
+    ui_printf("\n");
+    
+    IntakeHeatmap map;
+    int today = today_day_number();
+    if (intake_heatmap(app, today - days + 1, days, &map) != 0) {
+        METRIC_END(METRIC_HEATMAP_STATS, start);
+        return;
+    }
+    
+    struct tm first_tm, last_tm;
+    char first_date[16], last_date[16];
+    day_number_to_tm(map.first_day, &first_tm);
+    day_number_to_tm(today, &last_tm);
+    strftime(first_date, sizeof(first_date), "%Y-%m-%d", &first_tm);
+    strftime(last_date, sizeof(last_date), "%Y-%m-%d", &last_tm);
+    ui_printf("  %s近%d天（%s ~ %s）%s\n\n", COLOR_DIM, days, first_date, last_date, COLOR_RESET);
+    
+    // 各钟点合计和总量
+    long long hour_totals[24] = {0};
+    long long total = 0, max_hour = 0;
+    for (int w = 0; w < 7; w++) {
+        for (int h = 0; h < 24; h++) {
+            hour_totals[h] += map.amount[w][h];
+        }
+    }
+    int peak_hour = 0;
+    for (int h = 0; h < 24; h++) {
+        total += hour_totals[h];
+        if (hour_totals[h] > max_hour) {
+            max_hour = hour_totals[h];
+            peak_hour = h;
+        }
+    }
+    
+    if (total == 0) {
+        ui_printf("  %s📝 这段时间还没有喝水记录，开始记录吧！%s\n", COLOR_YELLOW, COLOR_RESET);
+        METRIC_END(METRIC_HEATMAP_STATS, start);
+        return;
+    }
+    
+    // 星期 × 钟点热力图
+    char row[512];
+    ui_printf("        %s0     6     12    18  23%s\n", COLOR_DIM, COLOR_RESET);
+    for (int w = 0; w < 7; w++) {
+        heatmap_row(row, sizeof(row), map.amount[w], map.max_amount);
+        ui_printf("  %s  %s\n", weekday_names[w], row);
+    }
+    heatmap_row(row, sizeof(row), hour_totals, max_hour);
+    ui_printf("  合计  %s\n", row);
+    ui_printf("\n  %s░ 无记录  %s█%s█%s█%s█%s 由少到多%s\n", COLOR_DIM,
+              COLOR_CYAN, COLOR_BLUE, COLOR_YELLOW, COLOR_GREEN, COLOR_DIM, COLOR_RESET);
+    
+    // 各星期的日均喝水量
+    ui_printf("\n");
+    int goal_ml = app->config.daily_goal * app->config.cup_size;
+    int best_weekday = 0;
+    long long best_average = -1;
+    for (int w = 0; w < 7; w++) {
+        long long sum = 0;
+        for (int h = 0; h < 24; h++) {
+            sum += map.amount[w][h];
+        }
+        long long average = map.weekdays[w] > 0 ? sum / map.weekdays[w] : 0;
+        if (average > best_average) {
+            best_average = average;
+            best_weekday = w;
+        }
+        
+        int progress = goal_ml > 0 ? (int)(average * 10 / goal_ml) : 0;
+        if (progress > 10) progress = 10;
+        char bar[64];
+        size_t length = 0;
+        for (int j = 0; j < 10; j++) {
+            memcpy(bar + length, j < progress ? "█" : "░", 3);
+            length += 3;
+        }
+        bar[length] = '\0';
+        ui_printf("  %s %s[%s%.*s%s%s]%s %s%4lldml/天%s\n", weekday_names[w], COLOR_WHITE,
+                  average >= goal_ml ? COLOR_GREEN : COLOR_BLUE, progress * 3, bar,
+                  COLOR_WHITE, bar + progress * 3, COLOR_RESET,
+                  average > 0 ? COLOR_BOLD : COLOR_DIM, average, COLOR_RESET);
+    }
+    
+    ui_printf("\n  %s⏰ 高峰时段:%s %s%02d:00-%02d:00%s (占 %.1f%%)\n",
+              COLOR_YELLOW, COLOR_RESET, COLOR_BOLD, peak_hour, (peak_hour + 1) % 24, COLOR_RESET,
+              (double)max_hour * 100.0 / (double)total);
+    ui_printf("  %s📅 喝得最多:%s %s%s%s (日均 %lldml)\n",
+              COLOR_GREEN, COLOR_RESET, COLOR_BOLD, weekday_names[best_weekday], COLOR_RESET,
+              best_average);
+    METRIC_END(METRIC_HEATMAP_STATS, start);
 }
 
 /* ==================== 用户交互函数 ==================== */
 
+/* 标准输入行缓冲区：所有输入都经由事件循环读取，不再混用 stdio 的输入缓冲 */
+static char g_input_buffer[INPUT_BUFFER_SIZE];
+static size_t g_input_length = 0;
+
 /**
- * @brief 获取用户选择
+ * @brief 读取一行输入（不含换行符）
+ * @description 等待输入期间事件循环照常处理提醒和退出信号；标准输入关闭时请求退出
+ * @return 读取的字符数，出错时返回-1
  */
-int get_user_choice(void) {
-    int choice;
-    if (scanf("%d", &choice) != 1) {
-        // 清理输入缓冲区
-        int c;
-        while ((c = getchar()) != '\n' && c != EOF);
+int read_input_line(char *line, size_t size) {
+    if (!line || size == 0) return -1;
+    
+    render_present();
+    
+    for (;;) {
+        char *newline = memchr(g_input_buffer, '\n', g_input_length);
+        size_t line_length = newline ? (size_t)(newline - g_input_buffer) : g_input_length;
+        
+        // 缓冲区已满仍无换行时整块作为一行返回
+        if (newline || g_input_length == sizeof(g_input_buffer)) {
+            size_t copy = line_length < size - 1 ? line_length : size - 1;
+            memcpy(line, g_input_buffer, copy);
+            line[copy] = '\0';
+            render_note_input(line);
+            
+            size_t consumed = newline ? line_length + 1 : line_length;
+            memmove(g_input_buffer, g_input_buffer + consumed, g_input_length - consumed);
+            g_input_length -= consumed;
+            return (int)copy;
+        }
+        
+        if (event_wait_readable(STDIN_FILENO) != 0) {
+            return -1;
+        }
+        
+        ssize_t n = read(STDIN_FILENO, g_input_buffer + g_input_length,
+                         sizeof(g_input_buffer) - g_input_length);
+        if (n < 0) {
+            if (errno == EINTR || errno == EAGAIN) continue;
+            return -1;
+        }
+        
+        if (n == 0) {
+            // 最后一行没有换行符时补上换行再返回
+            if (g_input_length > 0) {
+                g_input_buffer[g_input_length++] = '\n';
+                continue;
+            }
+            event_request_shutdown();
+            return -1;
+        }
+        
+        g_input_length += n;
+    }
+}
+
+/**
+ * @brief 读取一个整数输入
+ * @return 输入不是整数时返回-1
+ */
+int get_number_input(void) {
+    char line[64];
+    if (read_input_line(line, sizeof(line)) < 0) {
+        return -1;
+    }
+    
+    char *end;
+    long value = strtol(line, &end, 10);
+    while (*end == ' ' || *end == '\t' || *end == '\r') end++;
+    
+    if (end == line || *end != '\0' || value < INT_MIN || value > INT_MAX) {
         return -1;
     }
-    return choice;
+    return (int)value;
+}
+
+/**
+ * @brief 获取用户选择
+ */
+int get_user_choice(void) {
+    return get_number_input();
+}
+
+/**
+ * @brief 等待用户按下回车
+ */
+void wait_for_enter(void) {
+    char line[INPUT_BUFFER_SIZE];
+    read_input_line(line, sizeof(line));
 }
 
 /**
@@ -409,7 +585,16 @@ int get_user_choice(void) {
  */
 char get_key_input(void) {
     struct termios old_tio, new_tio;
-    char c;
+    char c = 0;
+    
+    // 行缓冲区中已有输入时直接取用
+    if (g_input_length > 0) {
+        c = g_input_buffer[0];
+        memmove(g_input_buffer, g_input_buffer + 1, --g_input_length);
+        return c;
+    }
+    
+    render_present();
     
     // 获取当前终端设置
     tcgetattr(STDIN_FILENO, &old_tio);
@@ -420,7 +605,9 @@ char get_key_input(void) {
     tcsetattr(STDIN_FILENO, TCSANOW, &new_tio);
     
     // 读取字符
-    c = getchar();
+    if (event_wait_readable(STDIN_FILENO) == 0 && read(STDIN_FILENO, &c, 1) != 1) {
+        c = 0;
+    }
     
     // 恢复终端设置
     tcsetattr(STDIN_FILENO, TCSANOW, &old_tio);
@@ -436,31 +623,17 @@ char get_key_input(void) {
 float calculate_daily_average(const AppState *app, int days) {
     if (!app || days <= 0) return 0.0;
     
-    time_t now = time(NULL);
-    int total_amount = 0;
-    int valid_days = 0;
-    
-    for (int day = 0; day < days; day++) {
-        time_t target_time = now - (day * 24 * 60 * 60);
-        struct tm *target_tm = localtime(&target_time);
-        
-        char date_str[11];
-        strftime(date_str, sizeof(date_str), "%Y-%m-%d", target_tm);
-        
-        int daily_amount = 0;
-        for (int i = 0; i < app->record_count; i++) {
-            if (is_same_date(app->records[i].date_str, date_str)) {
-                daily_amount += app->records[i].amount;
-            }
-        }
-        
-        if (daily_amount > 0) {
-            total_amount += daily_amount;
-            valid_days++;
-        }
+    METRIC_START(start);
+    // 常用的周、月范围直接使用栈上的桶数组
+    QueryBucket buckets[31];
+    QuerySummary summary;
+    if (range_query_recent_days(app, days, 0, days <= 31 ? buckets : NULL,
+                                days <= 31 ? days : 0, &summary) < 0) {
+        summary.active = 0;
     }
     
-    return valid_days > 0 ? (float)total_amount / valid_days : 0.0;
+    METRIC_END(METRIC_DAILY_AVERAGE, start);
+    return summary.active > 0 ? (float)summary.total.sum / summary.active : 0.0;
 }
 
 /**
@@ -469,31 +642,33 @@ float calculate_daily_average(const AppState *app, int days) {
 int get_streak_days(const AppState *app) {
     if (!app) return 0;
     
-    time_t now = time(NULL);
+    METRIC_START(start);
     int streak = 0;
     int goal_ml = app->config.daily_goal * app->config.cup_size;
     
-    // 从今天开始往前检查
-    for (int day = 0; day < 365; day++) { // 最多检查一年
-        time_t target_time = now - (day * 24 * 60 * 60);
-        struct tm *target_tm = localtime(&target_time);
+    // 从今天开始往前按月分段查询，最多检查一年，遇到中断即停止
+    QueryBucket days[31];
+    int today = today_day_number();
+    int broken = 0;
+    for (int checked = 0; checked < 365 && !broken; checked += 31) {
+        int span = 365 - checked < 31 ? 365 - checked : 31;
+        RangeQuery query;
+        query.from = day_start_time(today - checked - span + 1);
+        query.to = day_start_time(today - checked + 1);
+        query.bucket = BUCKET_DAY;
+        query.flags = 0;
         
-        char date_str[11];
-        strftime(date_str, sizeof(date_str), "%Y-%m-%d", target_tm);
-        
-        int daily_amount = 0;
-        for (int i = 0; i < app->record_count; i++) {
-            if (is_same_date(app->records[i].date_str, date_str)) {
-                daily_amount += app->records[i].amount;
+        int count = range_query(app, &query, days, span, NULL);
+        for (int i = count - 1; i >= 0 && !broken; i--) {
+            if (days[i].sum >= goal_ml) {
+                streak++;
+            } else {
+                broken = 1; // 连续记录中断
             }
         }
-        
-        if (daily_amount >= goal_ml) {
-            streak++;
-        } else {
-            break; // 连续记录中断
-        }
+        if (count < 0) break;
     }
     
+    METRIC_END(METRIC_STREAK_DAYS, start);
     return streak;
 } 
\ No newline at end of file
@@ -15,23 +15,118 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include <time.h>
 #include <unistd.h>
 #include <signal.h>
 #include <sys/stat.h>
 #include <termios.h>
+#include <poll.h>
 
 /* ==================== 常量定义 ==================== */
 #define MAX_NAME_LEN 50
-#define MAX_RECORDS 1000
+#define RECORD_CHUNK_SHIFT 10      // 记录分块大小的位数
+#define RECORD_CHUNK_SIZE (1 << RECORD_CHUNK_SHIFT) // 每个分块的记录数
 #define CONFIG_FILE "config/user_config.dat"
 #define DATA_FILE "data/water_records.dat"
 #define LOG_FILE "logs/app.log"
+#define USER_DATA_DIR "data/users"        // 非默认用户的数据目录
+#define USER_NAME_MAX 32                  // 用户名最大长度（含结尾空字符）
+#define APP_PATH_MAX 128                  // 配置和数据文件路径最大长度
+
+/* 日志设置 */
+#define LOG_BUFFER_SIZE (64 * 1024)       // 日志环形缓冲区大小（字节）
+#define LOG_LINE_MAX 512                  // 单条日志最大长度
+#define LOG_FLUSH_INTERVAL 1              // 后台写盘间隔（秒）
+#define LOG_MAX_SIZE (1024 * 1024)        // 日志文件轮转上限（字节）
+
+/* 音效设置 */
+#define SOUND_SAMPLE_FILE "/usr/share/sounds/alsa/Front_Left.wav" // 提示音文件
+#define SOUND_SAMPLE_MAX (4 * 1024 * 1024) // 提示音文件大小上限（字节）
+#define SOUND_QUEUE_MAX 2                 // 等待播放的请求数上限
+
+/* 渲染设置 */
+#define RENDER_STYLE_MAX 64               // 行首颜色样式序列的最大长度
+
+/* 导入导出设置 */
+#define TRANSFER_BATCH_SIZE 8192          // 导入时每批写盘的记录数
+#define TRANSFER_LINE_MAX 512             // 导入文件单行最大长度
+
+/* 数据日志写入设置 */
+#define JOURNAL_DEFAULT_WINDOW 100        // 默认组提交窗口（毫秒）
+#define JOURNAL_WINDOW_MAX 10000          // 组提交窗口上限（毫秒）
+
+/* 守护进程设置 */
+#define DAEMON_SOCKET_FILE "data/water_reminder.sock" // 守护进程监听的套接字
+#define DAEMON_MAX_CLIENTS 64             // 同时连接的客户端数上限
+#define DAEMON_LINE_MAX 256               // 单条请求的最大长度
+#define DAEMON_OUTPUT_MAX (64 * 1024)     // 单个客户端待发送响应的上限（字节）
+
+/* 用户分片设置 */
+#define SHARD_MAX_LOADED 64               // 同时驻留内存的用户数上限
+#define SHARD_HASH_SIZE 256               // 用户查找表的桶数
+
+/* 提醒调度设置 */
+#define SCHEDULER_INITIAL_CAPACITY 64     // 调度堆的初始容量
+
+/* 事件循环设置 */
+#define EVENT_POLL_FDS 3                  // 事件循环自身监听的描述符数
+
+/* 动画设置 */
+#define ANIMATION_MAX 4                   // 同时播放的动画数上限
+
+/* 性能指标设置 */
+#define METRICS_FILE "logs/metrics.txt"   // 定期写出的指标文件
+#define METRICS_INTERVAL 60               // 指标文件写出间隔（秒）
+#define METRICS_SUB_BUCKET_BITS 4         // 直方图每个2的幂区间的细分位数（相对误差约6%）
+#define METRICS_HISTOGRAM_BUCKETS ((64 - METRICS_SUB_BUCKET_BITS + 1) << METRICS_SUB_BUCKET_BITS)
+
+/* 输入设置 */
+#define INPUT_BUFFER_SIZE 256             // 标准输入行缓冲区大小
+
+/* 数据文件格式 */
+#define DATA_FILE_MAGIC "WRLG"            // 数据文件魔数
+#define DATA_FILE_VERSION 1               // 数据文件格式版本
+#define DATA_FILE_ENDIAN_TAG 0x01020304u  // 字节序标记
+#define DATA_FLAG_UNSORTED 0x1u           // 日志中存在时间戳倒序的记录
+#define DAY_INDEX_WARM_DAYS 366           // 启动时索引覆盖的最近天数
+#define DAY_INDEX_FILE "data/day_index.dat" // 默认用户的每日聚合快照
+#define DAY_INDEX_FILE_MAGIC "WRDI"       // 每日聚合快照魔数
+#define DAY_INDEX_FILE_VERSION 1          // 每日聚合快照格式版本
+
+/* 区间查询设置 */
+#define QUERY_PERCENTILES 0x1             // 计算单次喝水量的百分位数（需要逐条扫描记录）
+#define QUERY_MAX_BUCKETS 100000          // 单次查询的最大桶数
+#define QUERY_HISTOGRAM_STEP 10           // 百分位数直方图的桶宽（毫升）
+#define QUERY_HISTOGRAM_BINS (WATER_AMOUNT_MAX / QUERY_HISTOGRAM_STEP + 1)
+#define HEATMAP_DEFAULT_DAYS 90           // 热力图默认统计的最近天数
+#define HEATMAP_MAX_DAYS 36500            // 热力图最多统计的天数
+
+/* 汇总层设置 */
+#define ROLLUP_FILE "data/rollup.dat"     // 默认用户的汇总层快照
+#define ROLLUP_FILE_MAGIC "WRRU"          // 汇总层快照魔数
+#define ROLLUP_FILE_VERSION 1             // 汇总层快照格式版本
+#define ROLLUP_DAY_HOURS 25               // 小时层每天的槽数（夏令时切换日最多25小时）
+#define ROLLUP_RETENTION_MIN 31           // 折叠旧记录时至少保留的原始记录天数
+#define ROLLUP_RETENTION_MAX 36500        // 原始记录保留天数上限
+#define ROLLUP_FOLD_BATCH_DAYS 7          // 最早的记录超出保留期这么多天后才折叠，避免每次启动都重写日志
+
+/* 日历缓存设置 */
+#define CALENDAR_GROW_DAYS 366            // 缓存每次向外扩展的天数
+#define CALENDAR_MAX_DAYS 36525           // 缓存覆盖的最大天数（约100年）
+#define CONFIG_FILE_MAGIC "WRCF"          // 配置快照魔数
+#define CONFIG_FILE_VERSION 1             // 配置快照格式版本
+
+/* 快照读取结果 */
+#define SNAPSHOT_MISSING (-1)             // 文件不存在
+#define SNAPSHOT_FOREIGN (-2)             // 不是该类型的快照（例如旧格式文件）
+#define SNAPSHOT_CORRUPT (-3)             // 长度或校验值不符
 
 /* 默认设置 */
 #define DEFAULT_REMINDER_INTERVAL 60  // 默认提醒间隔（分钟）
 #define DEFAULT_DAILY_GOAL 8         // 默认每日目标（杯）
 #define DEFAULT_CUP_SIZE 250         // 默认杯子容量（毫升）
+#define WATER_AMOUNT_MAX 2000        // 单次喝水量上限（毫升）
 
 /* 颜色定义 */
 #define COLOR_RESET     "\033[0m"
@@ -64,80 +159,514 @@ typedef struct {
     int cup_size;                  // 杯子容量（毫升）
     int sound_enabled;             // 是否启用声音提醒
     int notification_style;        // 通知样式（0-2）
+    int animations_enabled;        // 是否播放动画效果
+    int durability;                // 记录写入的持久性级别 DurabilityLevel
+    int commit_window_ms;          // 组提交窗口（毫秒）
+    int retention_days;            // 原始记录保留天数（0表示全部保留，更早的记录折叠进汇总层）
+    int64_t last_reminder;         // 守护进程上次发出提醒的时间（重启后据此继续调度）
 } UserConfig;
 
 /**
- * @brief 喝水记录结构体
+ * @brief 记录写入的持久性级别
+ */
+typedef enum {
+    DURABILITY_NONE,               // 只写入内核，由系统决定何时落盘
+    DURABILITY_BATCHED,            // 组提交：提交窗口内的写入共用一次 fdatasync
+    DURABILITY_RECORD              // 每次写入后立即 fdatasync
+} DurabilityLevel;
+
+/**
+ * @brief 喝水记录结构体（同时也是数据文件中的记录格式，8字节）
  */
 typedef struct {
-    time_t timestamp;              // 记录时间戳
-    int amount;                    // 喝水量（毫升）
-    char date_str[11];            // 日期字符串 YYYY-MM-DD
+    uint32_t timestamp;            // 记录时间戳（Unix秒）
+    int32_t amount;                // 喝水量（毫升）
 } WaterRecord;
 
+/**
+ * @brief 数据文件头结构体
+ */
+typedef struct {
+    char magic[4];                 // 魔数 DATA_FILE_MAGIC
+    uint16_t version;              // 格式版本
+    uint16_t record_size;          // 单条记录字节数
+    uint32_t endian_tag;           // 字节序标记，按写入机器的字节序存放
+    uint32_t flags;                // 文件标志 DATA_FLAG_*
+} RecordFileHeader;
+
+/**
+ * @brief 快照文件头结构体（配置等整体重写的小文件）
+ */
+typedef struct {
+    char magic[4];                 // 文件类型标识
+    uint16_t version;              // 内容格式版本
+    uint16_t header_size;          // 文件头字节数
+    uint32_t payload_size;         // 数据字节数
+    uint32_t checksum;             // 数据的 CRC-32
+} SnapshotHeader;
+
+/**
+ * @brief 分块记录存储结构体
+ * @description 下标 [0, mapped_count) 的记录位于数据文件的只读映射中，
+ *              之后的记录位于分块中
+ */
+typedef struct {
+    const WaterRecord *mapped;     // 映射的数据文件记录区
+    int mapped_count;              // 映射区中的记录数
+    void *map_base;                // 映射起始地址
+    size_t map_size;               // 映射长度
+    WaterRecord **chunks;          // 分块指针数组
+    int chunk_count;               // 已分配的分块数
+    int chunk_capacity;            // 分块指针数组容量
+    int count;                     // 记录总数
+    int sorted;                    // 记录是否按时间戳非递减排列
+} RecordStore;
+
+/**
+ * @brief 每日聚合数据结构体
+ */
+typedef struct {
+    int total_ml;                  // 当日喝水总量（毫升）
+    int count;                     // 当日喝水次数
+    time_t first_time;             // 当日第一条记录时间
+    time_t last_time;              // 当日最后一条记录时间
+    int min_ml;                    // 当日单次最小量
+    int max_ml;                    // 当日单次最大量
+} DayAggregate;
+
+/**
+ * @brief 每日聚合索引结构体（按天号连续存放）
+ */
+typedef struct {
+    DayAggregate *days;            // 聚合数组，days[0] 对应 base_day
+    int base_day;                  // 起始天号
+    int day_count;                 // 已覆盖的天数
+    int capacity;                  // 数组容量
+    int indexed_from;              // 存储中 [indexed_from, count) 的记录已计入索引
+} DayIndex;
+
+/**
+ * @brief 列式历史结构体（时间戳和喝水量分列连续存放，供区间聚合使用）
+ */
+typedef struct {
+    uint32_t *timestamps;          // 时间戳列
+    int32_t *amounts;              // 喝水量列
+    int count;                     // 已同步的记录数
+    int capacity;                  // 列容量
+    int sorted;                    // 时间戳是否非递减
+} RecordColumns;
+
+/**
+ * @brief 区间聚合结果
+ */
+typedef struct {
+    long long sum;                 // 喝水总量
+    int count;                     // 记录数
+    int min;                       // 单次最小量（无记录时为0）
+    int max;                       // 单次最大量（无记录时为0）
+} RangeAggregate;
+
+/**
+ * @brief 区间查询的分桶粒度
+ */
+typedef enum {
+    BUCKET_HOUR,                   // 按本地小时
+    BUCKET_DAY,                    // 按本地日期
+    BUCKET_WEEK,                   // 按周（周一开始）
+    BUCKET_MONTH                   // 按自然月
+} BucketSize;
+
+/**
+ * @brief 区间查询条件
+ */
+typedef struct {
+    time_t from;                   // 起始时间，向下对齐到所在桶的起点
+    time_t to;                     // 结束时间（不含），最后一个桶覆盖到该时间
+    BucketSize bucket;             // 分桶粒度
+    int flags;                     // QUERY_* 标志
+} RangeQuery;
+
+/**
+ * @brief 区间查询中一个桶（或整个区间）的统计结果
+ */
+typedef struct {
+    time_t start;                  // 桶起始时间
+    time_t end;                    // 桶结束时间（不含）
+    int first_day;                 // 桶起始日期的天号
+    int days;                      // 桶覆盖的天数（按小时分桶时为0）
+    long long sum;                 // 喝水总量
+    int count;                     // 记录数
+    int min;                       // 单次最小量（无记录时为0）
+    int max;                       // 单次最大量（无记录时为0）
+    double mean;                   // 单次平均量
+    int p50;                       // 单次喝水量的百分位数（需 QUERY_PERCENTILES）
+    int p90;
+    int p99;
+} QueryBucket;
+
+/**
+ * @brief 区间查询的整体汇总
+ */
+typedef struct {
+    QueryBucket total;             // 整个区间的统计
+    int active;                    // 有记录的桶数
+    long long best;                // 总量最大的桶的总量
+} QuerySummary;
+
+/**
+ * @brief 按星期和钟点划分的喝水热力图
+ */
+typedef struct {
+    long long amount[7][24];       // 各星期（周一为0）各钟点的喝水总量
+    int count[7][24];              // 各格的记录数
+    int weekdays[7];               // 窗口内每个星期几出现的天数
+    long long max_amount;          // 单格最大总量
+    int first_day;                 // 窗口起始天号
+    int days;                      // 窗口天数
+} IntakeHeatmap;
+
+/**
+ * @brief 汇总层的粒度
+ */
+typedef enum {
+    ROLLUP_HOUR,                   // 小时层，键为 天号*ROLLUP_DAY_HOURS+当天第几小时
+    ROLLUP_DAY,                    // 日层，键为天号
+    ROLLUP_MONTH,                  // 月层，键为 年*12+月（0-11）
+    ROLLUP_LEVELS
+} RollupLevel;
+
+/**
+ * @brief 汇总层中一个时间段的聚合数据（按固定布局持久化）
+ */
+typedef struct {
+    int32_t sum;                   // 喝水总量
+    int32_t count;                 // 记录数
+    uint16_t min;                  // 单次最小量（不超过 WATER_AMOUNT_MAX）
+    uint16_t max;                  // 单次最大量
+} RollupCell;
+
+/**
+ * @brief 一个粒度的汇总层（按键连续存放）
+ */
+typedef struct {
+    RollupCell *cells;             // 聚合数组，cells[0] 对应 base
+    int base;                      // 起始键
+    int count;                     // 已覆盖的键数
+    int capacity;                  // 数组容量
+} RollupTier;
+
+/**
+ * @brief 多粒度汇总层
+ * @description 随记录增量维护并持久化；折叠掉的旧记录只存在于汇总层中
+ */
+typedef struct {
+    RollupTier tiers[ROLLUP_LEVELS]; // 小时、日、月三层
+    int covered;                   // 记录存储中 [0, covered) 的记录已计入
+    int pending;                   // 已计入折叠数、尚待从数据日志删除的开头记录数
+    long long folded;              // 已折叠（不在数据日志中）的记录数
+    int loaded;                    // 是否已从快照加载或由记录重建
+    int dirty;                     // 自上次保存后是否有变化
+} Rollup;
+
+/**
+ * @brief 一个待触发的提醒
+ */
+typedef struct {
+    time_t due;                    // 到期时间
+    int heap_index;                // 在调度堆中的位置（-1表示未调度）
+    void *owner;                   // 提醒所属的对象
+} ReminderTimer;
+
+/**
+ * @brief 提醒调度器（按到期时间排列的最小堆）
+ */
+typedef struct {
+    ReminderTimer **heap;          // 堆数组，堆顶为最早到期的提醒
+    int count;                     // 待触发的提醒数
+    int capacity;                  // 堆数组容量
+} ReminderScheduler;
+
+/**
+ * @brief 数据日志写入状态
+ */
+typedef struct Journal {
+    int fd;                        // 数据文件描述符（-1表示未打开）
+    int dirty;                     // 有已写入但尚未提交的记录
+    int syncing;                   // 正在执行 fdatasync
+    long long deadline;            // 待提交写入的提交期限（单调时钟毫秒）
+    struct Journal *next;          // 组提交线程管理的下一个日志
+} Journal;
+
 /**
  * @brief 应用状态结构体
  */
 typedef struct {
+    char user[USER_NAME_MAX];      // 用户名（空字符串表示默认用户）
+    char config_path[APP_PATH_MAX]; // 配置文件路径
+    char data_path[APP_PATH_MAX];  // 数据文件路径
+    char rollup_path[APP_PATH_MAX]; // 汇总层快照路径
+    char day_index_path[APP_PATH_MAX]; // 每日聚合快照路径
     UserConfig config;             // 用户配置
-    WaterRecord records[MAX_RECORDS]; // 喝水记录数组
-    int record_count;             // 记录总数
+    RecordStore records;           // 喝水记录存储
+    DayIndex day_index;            // 每日聚合索引
+    RecordColumns columns;         // 列式历史（首次区间查询时构建）
+    Rollup rollup;                 // 小时/日/月汇总层
+    Journal journal;               // 数据日志写入状态
+    int log_count;                // 数据日志中的记录数
     int today_count;              // 今日喝水次数
     int today_amount;             // 今日喝水总量
+    int today_day;                // 今日统计对应的天号
     time_t last_reminder;         // 上次提醒时间
     int is_running;               // 程序运行状态
     int paused;                   // 暂停状态
+    int headless;                 // 是否以无界面的守护进程方式运行
 } AppState;
 
+/**
+ * @brief 性能指标编号
+ */
+typedef enum {
+    METRIC_LOAD_RECORDS,           // 加载喝水记录
+    METRIC_SAVE_RECORDS,           // 保存喝水记录
+    METRIC_LOG_WRITE,              // 写入一条日志（进入缓冲区）
+    METRIC_LOG_FLUSH,              // 日志缓冲区写盘
+    METRIC_TODAY_STATS,            // 今日统计
+    METRIC_DAILY_AVERAGE,          // 每日平均值
+    METRIC_STREAK_DAYS,            // 连续天数
+    METRIC_WEEKLY_STATS,           // 本周统计页面
+    METRIC_MONTHLY_STATS,          // 本月统计页面
+    METRIC_HEATMAP_STATS,          // 喝水热力图页面
+    METRIC_RENDER_FRAME,           // 输出一帧画面
+    METRIC_JOURNAL_SYNC,           // 数据日志提交（fdatasync）
+    METRIC_REMINDER_JITTER,        // 提醒实际发出时间与计划时间的偏差
+    METRIC_COUNT
+} MetricId;
+
 /* ==================== 函数声明 ==================== */
 
 /* 初始化和清理函数 */
-int  init_app(AppState *app);
+int  init_app(AppState *app, const char *user, int headless);
 void cleanup_app(AppState *app);
 int  create_directories(void);
+void signal_handler(int sig);
+
+/* 用户状态函数 */
+int  user_name_valid(const char *user);
+int  app_state_init(AppState *app, const char *user);
+int  app_state_load(AppState *app);
+void app_state_free(AppState *app);
+
+/* 用户分片函数 */
+int  shard_init(AppState *default_app);
+AppState *shard_get(const char *user);
+int  shard_poll_prepare(struct pollfd *fd);
+void shard_poll_dispatch(const struct pollfd *fd);
+void shard_day_rollover(int today);
+void shard_shutdown(void);
+
+/* 提醒调度函数 */
+void reminder_timer_init(ReminderTimer *timer, void *owner);
+void scheduler_init(ReminderScheduler *scheduler);
+void scheduler_free(ReminderScheduler *scheduler);
+int  scheduler_schedule(ReminderScheduler *scheduler, ReminderTimer *timer, time_t due);
+void scheduler_cancel(ReminderScheduler *scheduler, ReminderTimer *timer);
+ReminderTimer *scheduler_peek(const ReminderScheduler *scheduler);
+ReminderTimer *scheduler_pop_due(ReminderScheduler *scheduler, time_t now);
 
 /* 配置管理函数 */
-int  load_config(UserConfig *config);
-int  save_config(const UserConfig *config);
+int  load_config(UserConfig *config, const char *path);
+int  save_config(const UserConfig *config, const char *path);
 void set_default_config(UserConfig *config);
 void setup_user_config(UserConfig *config);
 
 /* 数据管理函数 */
 int  load_records(AppState *app);
 int  save_records(const AppState *app);
+int  save_day_index(const AppState *app);
+int  append_record(const char *path, const WaterRecord *record);
+int  append_records(const char *path, const WaterRecord *records, int count);
+int  mark_records_unsorted(const char *path);
+int  water_amount_valid(int amount);
+void record_header_init(RecordFileHeader *header, uint32_t flags);
+int  compact_records(AppState *app);
+int  fold_records(AppState *app);
 void add_water_record(AppState *app, int amount);
 void calculate_today_stats(AppState *app);
+void today_stats_rollover(AppState *app, int today);
 
-/* UI显示函数 */
+/* 数据日志写入函数 */
+void journal_init(Journal *journal);
+int  journal_append(AppState *app, const WaterRecord *records, int count);
+int  journal_sync(Journal *journal);
+void journal_close(Journal *journal);
+void journal_shutdown(void);
+const char *durability_name(int durability);
+int  durability_parse(const char *name);
+
+/* 原子快照函数 */
+uint32_t snapshot_checksum(const void *data, size_t size);
+int  snapshot_replace(const char *path, int (*write_fn)(FILE *file, const void *ctx), const void *ctx);
+int  snapshot_save(const char *path, const char *magic, uint16_t version,
+                   const void *payload, uint32_t size);
+int  snapshot_load(const char *path, const char *magic, uint16_t *version,
+                   void *payload, uint32_t capacity, uint32_t *loaded);
+
+/* 记录存储函数 */
+void record_store_init(RecordStore *store);
+void record_store_free(RecordStore *store);
+void record_store_clear(RecordStore *store);
+int  record_store_map(RecordStore *store, int fd, size_t offset, int count);
+WaterRecord *record_store_append(RecordStore *store);
+int  record_store_read(RecordStore *store, FILE *file, int max_count);
+int  record_store_write(const RecordStore *store, FILE *file);
+int  record_store_lower_bound(const RecordStore *store, time_t timestamp);
+
+/**
+ * @brief 按下标访问记录（调用方保证下标有效）
+ */
+static inline const WaterRecord *record_store_at(const RecordStore *store, int index) {
+    if (index < store->mapped_count) {
+        return &store->mapped[index];
+    }
+    index -= store->mapped_count;
+    return &store->chunks[index >> RECORD_CHUNK_SHIFT][index & (RECORD_CHUNK_SIZE - 1)];
+}
+
+/* 每日聚合索引函数 */
+void day_index_init(DayIndex *index);
+void day_index_free(DayIndex *index);
+void day_index_clear(DayIndex *index);
+void day_index_reset(DayIndex *index, const RecordStore *store);
+int  day_index_add(DayIndex *index, int day, int amount, time_t timestamp);
+int  day_index_ensure(DayIndex *index, const RecordStore *store, int from_day);
+int  day_index_build(DayIndex *index, const RecordStore *store);
+const DayAggregate *day_index_get(const DayIndex *index, int day);
+int  day_index_amount(const DayIndex *index, int day);
+int  day_index_covers(const DayIndex *index, const RecordStore *store, int day);
+int  day_index_load(DayIndex *index, const char *path, const RecordStore *store);
+int  day_index_save(const DayIndex *index, const char *path, const RecordStore *store, int from_day);
+
+/* 列式历史函数 */
+void record_columns_init(RecordColumns *columns);
+void record_columns_free(RecordColumns *columns);
+void record_columns_clear(RecordColumns *columns);
+int  record_columns_sync(RecordColumns *columns, const RecordStore *store);
+void record_columns_aggregate(const RecordColumns *columns, time_t from, time_t to,
+                              RangeAggregate *out);
+const char *range_kernel_name(void);
+int  range_kernel_select(const char *name);
+int  range_aggregate(AppState *app, time_t from, time_t to, RangeAggregate *out);
+
+/* 汇总层函数 */
+void rollup_init(Rollup *rollup);
+void rollup_free(Rollup *rollup);
+void rollup_clear(Rollup *rollup);
+int  rollup_sync(Rollup *rollup, const RecordStore *store);
+int  rollup_load(Rollup *rollup, const char *path, const RecordStore *store);
+int  rollup_save(Rollup *rollup, const char *path, const RecordStore *store);
+int  rollup_ready(const Rollup *rollup, const RecordStore *store);
+int  rollup_hour_key(int day, time_t timestamp);
+int  rollup_month_key(int day);
+const RollupCell *rollup_cell(const Rollup *rollup, RollupLevel level, int key);
+time_t rollup_fold_horizon(const Rollup *rollup, const RecordStore *store);
+int  rollup_aggregate(const Rollup *rollup, time_t from, time_t to, RangeAggregate *out);
+
+/* 区间查询函数 */
+int  range_query(const AppState *app, const RangeQuery *query,
+                 QueryBucket *buckets, int capacity, QuerySummary *summary);
+int  range_query_recent_days(const AppState *app, int days, int flags,
+                             QueryBucket *buckets, int capacity, QuerySummary *summary);
+int  intake_heatmap(const AppState *app, int first_day, int days, IntakeHeatmap *out);
+
+/* 终端渲染函数 */
 void clear_screen(void);
+void ui_printf(const char *format, ...);
+void render_present(void);
+void render_note_input(const char *line);
+void ui_sleep(unsigned int seconds);
+int  render_cursor_row(void);
+int  render_update_line(int row, const char *text);
+unsigned int render_generation(void);
+void render_bell(void);
+
+/* 动画函数 */
+void animation_play_line(const char *const *frames, int frame_count, int interval_ms);
+void animation_play_bell(int count, int interval_ms);
+int  animation_next_timeout(void);
+void animation_tick(void);
+
+/* UI显示函数 */
 void show_banner(void);
 void show_main_menu(void);
 void show_stats_dashboard(const AppState *app);
 void show_progress_bar(int current, int goal, const char *label);
-void show_water_animation(void);
+void show_water_animation(const AppState *app);
 void show_reminder_notification(const AppState *app);
 
 /* 用户交互函数 */
+int  read_input_line(char *line, size_t size);
+int  get_number_input(void);
 int  get_user_choice(void);
+void wait_for_enter(void);
 char get_key_input(void);
 void pause_program(void);
 void resume_program(void);
 
-/* 提醒系统函数 */
+/* 提醒系统与事件循环函数 */
+int  event_loop_init(AppState *app);
+void event_loop_shutdown(void);
+int  event_wait_readable(int fd);
+int  event_poll_prepare(struct pollfd *fds);
+void event_poll_dispatch(const struct pollfd *fds);
+void event_request_shutdown(void);
 void setup_reminder_timer(AppState *app);
-void reminder_handler(int sig);
 int  should_remind(const AppState *app);
 
+/* 导入导出函数 */
+int  import_records(AppState *app, const char *path, const char *format);
+int  export_records(const AppState *app, const char *path, const char *format);
+
+/* 守护进程函数 */
+int  daemon_run(AppState *app);
+void daemon_shutdown(void);
+
 /* 统计分析函数 */
 void show_weekly_stats(const AppState *app);
 void show_monthly_stats(const AppState *app);
+void show_intake_heatmap(const AppState *app, int days);
 float calculate_daily_average(const AppState *app, int days);
 int  get_streak_days(const AppState *app);
 
+/* 性能指标函数（以 -DNO_METRICS 编译时埋点宏展开为空） */
+int  metrics_init(void);
+void metrics_shutdown(void);
+void metrics_dump(FILE *out);
+void metrics_dump_on_exit(FILE *out);
+uint64_t metrics_now_ns(void);
+void metrics_record(MetricId id, uint64_t value_ns);
+void metrics_record_delay(MetricId id, time_t scheduled);
+
+#ifndef NO_METRICS
+#define METRIC_START(var) uint64_t var = metrics_now_ns()
+#define METRIC_END(id, var) metrics_record((id), metrics_now_ns() - (var))
+#define METRIC_DELAY(id, scheduled) metrics_record_delay((id), (scheduled))
+#else
+#define METRIC_START(var) ((void)0)
+#define METRIC_END(id, var) ((void)0)
+#define METRIC_DELAY(id, scheduled) ((void)0)
+#endif
+
 /* 工具函数 */
-void get_current_date_str(char *date_str);
-int  is_same_date(const char *date1, const char *date2);
+int  timestamp_to_day(time_t timestamp);
+int  today_day_number(void);
+time_t day_start_time(int day);
+void day_number_to_tm(int day, struct tm *out);
+void calendar_shutdown(void);
 void log_message(const char *message);
+int  logger_init(void);
+void logger_flush(void);
+void logger_shutdown(void);
 void play_sound_effect(void);
+void audio_shutdown(void);
 
 #endif /* WATER_REMINDER_H */ 
\ No newline at end of file